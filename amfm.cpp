@@ -4,7 +4,12 @@
 extern "C" {
 #endif
 
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
 #include "amfm.h"
+#include "sample.h"
 #include "tonewheel_osc.h"
 
 float remap_i16(int16_t v, int16_t oldmin, int16_t oldmax, int16_t newmin, int16_t newmax) {
@@ -27,6 +32,30 @@ void fill_sinemod(int16_t ret[256], int16_t min, int16_t max, int32_t phase) {
     }
 }
 
+// amfm_delay_at interpolates the Q8.8 readOffset table to a Q16.16
+// delay in samples.
+static inline int32_t amfm_delay_at(int16_t *readOffset, uint8_t index, uint16_t scale) {
+    int32_t a = readOffset[index];
+    int32_t b = readOffset[index + 1];
+    return (a << 8) + (int32_t)(((int64_t)(b - a) * scale) >> 8);
+}
+
+// fill_directivity fills a 256 element table of one-pole lowpass
+// coefficients (Q15) for a rotor's brightness at each angle. The
+// cutoff is _max_hz_ on axis, at the same angle as the peak of a
+// fill_sinemod table with phase 0, and falls to _min_hz_ facing away.
+// The cutoff follows the square of the sinemod's shape, so the rotor
+// is dull most of the way round, like a horn. This runs at setup time, in floating point.
+void fill_directivity(int16_t ret[256], float min_hz, float max_hz, float sample_rate) {
+    for (int i = 0; i < 256; i++) {
+        float beam = 0.5f * (1.0f + sinf(2.0f * (float)M_PI * i / 256.0f));
+        float hz = min_hz + (max_hz - min_hz) * beam * beam;
+        float k = 1.0f - expf(-2.0f * (float)M_PI * hz / sample_rate);
+        int32_t coef = (int32_t)(k * 32768.0f + 0.5f);
+        ret[i] = coef > 32767 ? 32767 : (coef < 0 ? 0 : coef);
+    }
+}
+
 void amfm_update(int16_t *dst, int16_t *src, int dstsrc_len, int16_t *ringbuf, int ringbuf_len, uint32_t *ringbuf_wp, int16_t *readVolume, int16_t *readOffset, uint32_t phaseIncr, uint32_t *phase_out) {
     uint32_t wp = *ringbuf_wp;
     uint32_t phase = *phase_out;
@@ -45,17 +74,16 @@ void amfm_update(int16_t *dst, int16_t *src, int dstsrc_len, int16_t *ringbuf, i
 
         int16_t volume = lerp_i16(readVolume[index], readVolume[index + 1], scale);
 
-        // The read offset has been encoded as a Q8.8 number; strip
-        // out the top 8 bits for offset and the bottom 8 for scale,
-        // but map scale into 0..0xFFFF as lerp expects.
-        int16_t offset = readOffset[index] >> 8;
-        scale = (readOffset[index] & 0xFF) << 8;
+        // The read offset has been encoded as a Q8.8 number of
+        // samples. Interpolate it between table entries, then read
+        // that far behind the write head: between the samples offset
+        // (a) and offset + 1 (b) back.
+        int32_t delay = amfm_delay_at(readOffset, index, scale);
+        uint32_t rp = wp - (delay >> 16);
+        scale = delay & 0xFFFF;
 
-        int rp0 = wp - offset - 1;
-        int rp1 = wp - offset;
-
-        int16_t a = ringbuf[rp0 % ringbuf_len];
-        int16_t b = ringbuf[rp1 % ringbuf_len];
+        int16_t a = ringbuf[rp % ringbuf_len];
+        int16_t b = ringbuf[(rp - 1) % ringbuf_len];
 
         int16_t sample = lerp_i16(a, b, scale);
         dst[i] = (sample * volume) >> 15;
@@ -69,6 +97,364 @@ void amfm_update(int16_t *dst, int16_t *src, int dstsrc_len, int16_t *ringbuf, i
     *phase_out = phase;
 }
 
+// amfm_ctl_at looks up the gain (Q15, in the top of a Q16.16) and
+// delay (Q16.16 samples) at _phase_.
+static inline void amfm_ctl_at(int16_t *readVolume, int16_t *readOffset, uint32_t phase, int32_t *gain, int32_t *delay) {
+    uint8_t index = phase >> 24;
+    uint16_t scale = (phase >> 8) & 0xFFFF;
+
+    *gain = (int32_t)lerp_i16(readVolume[index], readVolume[index + 1], scale) << 16;
+    *delay = amfm_delay_at(readOffset, index, scale);
+}
+
+// amfm_coef_at looks up the one-pole coefficient (Q15, in the top of
+// a Q16.16) at _phase_.
+static inline int32_t amfm_coef_at(int16_t *readCoef, uint32_t phase) {
+    uint8_t index = phase >> 24;
+    uint16_t scale = (phase >> 8) & 0xFFFF;
+    return (int32_t)lerp_i16(readCoef[index], readCoef[index + 1], scale) << 16;
+}
+
+// amfm_ctl_kernel is the control rate loop shared by amfm_update_ctl,
+// amfm_update_dir and the kernels from amfm_select, for either sample
+// type. It's inlined into each, so any of the AMFM_* _parts_ that are
+// off cost nothing: without AMFM_VIBRATO the ring isn't touched.
+extern "C++" {
+template <typename S>
+static inline void amfm_ctl_kernel(S *dst, S *src, int dstsrc_len, S *ringbuf, int ringbuf_len, uint32_t *ringbuf_wp, int16_t *readVolume, int16_t *readOffset, uint32_t phaseIncr, uint32_t *phase_out, int ctl_shift, int16_t *readCoef, typename sample_traits<S>::acc *lp_out, const int parts) {
+    typedef sample_traits<S> T;
+    typedef typename T::acc acc;
+
+    const int tremolo = parts & AMFM_TREMOLO;
+    const int vibrato = parts & AMFM_VIBRATO;
+    const int filter = parts & AMFM_DIRECTIVITY;
+
+    uint32_t wp = *ringbuf_wp;
+    uint32_t phase = *phase_out;
+    uint32_t mask = ringbuf_len - 1;
+
+    int32_t gain, delay, coef = 0;
+    acc lp = 0;
+    amfm_ctl_at(readVolume, readOffset, phase, &gain, &delay);
+    if (filter) {
+        coef = amfm_coef_at(readCoef, phase);
+        lp = *lp_out;
+    }
+
+    for (int i = 0; i < dstsrc_len;) {
+        int n = 1 << ctl_shift;
+        if (n > dstsrc_len - i) {
+            n = dstsrc_len - i;
+        }
+
+        // Ramp to the values at the start of the next segment.
+        phase += phaseIncr * n;
+        int32_t gain_end, delay_end, coef_end = 0;
+        amfm_ctl_at(readVolume, readOffset, phase, &gain_end, &delay_end);
+
+        // Whole segments divide by shifting; a short one at the end
+        // of a block pays for a divide.
+        int32_t gain_incr, delay_incr, coef_incr = 0;
+        if (filter) {
+            coef_end = amfm_coef_at(readCoef, phase);
+        }
+        if (n == 1 << ctl_shift) {
+            gain_incr = (gain_end - gain) >> ctl_shift;
+            delay_incr = (delay_end - delay) >> ctl_shift;
+            coef_incr = (coef_end - coef) >> ctl_shift;
+        } else {
+            gain_incr = (gain_end - gain) / n;
+            delay_incr = (delay_end - delay) / n;
+            coef_incr = (coef_end - coef) / n;
+        }
+
+        for (int end = i + n; i < end; i++) {
+            acc sample = src[i];
+            if (vibrato) {
+                ringbuf[wp & mask] = src[i];
+
+                uint32_t rp = wp - (delay >> 16);
+                uint16_t scale = delay & 0xFFFF;
+                sample = T::lerp(ringbuf[rp & mask], ringbuf[(rp - 1) & mask], scale);
+                delay += delay_incr;
+                wp++;
+            }
+
+            if (filter) {
+                lp += T::gain(sample - lp, coef >> 16);
+                sample = lp;
+                coef += coef_incr;
+            }
+
+            if (tremolo) {
+                sample = T::gain(sample, gain >> 16);
+                gain += gain_incr;
+            }
+
+            dst[i] = sample;
+        }
+
+        gain = gain_end;
+        delay = delay_end;
+        coef = coef_end;
+    }
+
+    *ringbuf_wp = wp;
+    *phase_out = phase;
+    if (filter) {
+        *lp_out = lp;
+    }
+}
+
+template <int parts>
+static void amfm_part_kernel(int16_t *dst, int16_t *src, int dstsrc_len, int16_t *ringbuf, int ringbuf_len, uint32_t *ringbuf_wp, int16_t *readVolume, int16_t *readOffset, int16_t *readCoef, int32_t *lp, uint32_t phaseIncr, uint32_t *phase_out, int ctl_shift) {
+    amfm_ctl_kernel(dst, src, dstsrc_len, ringbuf, ringbuf_len, ringbuf_wp, readVolume, readOffset, phaseIncr, phase_out, ctl_shift, readCoef, lp, parts);
+}
+
+// amfm_stopped_kernel is amfm_part_kernel for a rotor that isn't
+// turning. The gain, delay and coefficient are looked up once and
+// held, so there's no control rate work. A whole sample delay is read
+// straight from the ring; a fractional one still interpolates, at a
+// fixed scale, so the output matches amfm_part_kernel's exactly.
+template <int parts>
+static void amfm_stopped_kernel(int16_t *dst, int16_t *src, int dstsrc_len, int16_t *ringbuf, int ringbuf_len, uint32_t *ringbuf_wp, int16_t *readVolume, int16_t *readOffset, int16_t *readCoef, int32_t *lp_out, uint32_t, uint32_t *phase_out, int) {
+    typedef sample_traits<int16_t> T;
+
+    const int tremolo = parts & AMFM_TREMOLO;
+    const int vibrato = parts & AMFM_VIBRATO;
+    const int filter = parts & AMFM_DIRECTIVITY;
+
+    uint32_t wp = *ringbuf_wp;
+    uint32_t mask = ringbuf_len - 1;
+
+    int32_t gain, delay, coef = 0;
+    int32_t lp = 0;
+    amfm_ctl_at(readVolume, readOffset, *phase_out, &gain, &delay);
+    if (filter) {
+        coef = amfm_coef_at(readCoef, *phase_out) >> 16;
+        lp = *lp_out;
+    }
+    gain >>= 16;
+
+    uint32_t lag = delay >> 16;
+    uint16_t scale = delay & 0xFFFF;
+
+    for (int i = 0; i < dstsrc_len; i++) {
+        int32_t sample = src[i];
+        if (vibrato) {
+            ringbuf[wp & mask] = src[i];
+
+            uint32_t rp = wp - lag;
+            if (scale == 0) {
+                sample = ringbuf[rp & mask];
+            } else {
+                sample = T::lerp(ringbuf[rp & mask], ringbuf[(rp - 1) & mask], scale);
+            }
+            wp++;
+        }
+
+        if (filter) {
+            lp += T::gain(sample - lp, coef);
+            sample = lp;
+        }
+
+        if (tremolo) {
+            sample = T::gain(sample, gain);
+        }
+
+        dst[i] = sample;
+    }
+
+    *ringbuf_wp = wp;
+    if (filter) {
+        *lp_out = lp;
+    }
+}
+}
+
+// amfm_kernels holds a kernel for each set of AMFM_* parts. With none
+// of them, the effect is a bypass.
+static const amfm_fn amfm_kernels[8] = {
+    NULL,
+    amfm_part_kernel<1>,
+    amfm_part_kernel<2>,
+    amfm_part_kernel<3>,
+    amfm_part_kernel<4>,
+    amfm_part_kernel<5>,
+    amfm_part_kernel<6>,
+    amfm_part_kernel<7>,
+};
+
+amfm_fn amfm_select(int parts) {
+    return amfm_kernels[parts & (AMFM_TREMOLO | AMFM_VIBRATO | AMFM_DIRECTIVITY)];
+}
+
+// amfm_stopped_kernels holds amfm_stopped_kernel for each set of
+// AMFM_* parts, like amfm_kernels.
+static const amfm_fn amfm_stopped_kernels[8] = {
+    NULL,
+    amfm_stopped_kernel<1>,
+    amfm_stopped_kernel<2>,
+    amfm_stopped_kernel<3>,
+    amfm_stopped_kernel<4>,
+    amfm_stopped_kernel<5>,
+    amfm_stopped_kernel<6>,
+    amfm_stopped_kernel<7>,
+};
+
+amfm_fn amfm_select_stopped(int parts) {
+    return amfm_stopped_kernels[parts & (AMFM_TREMOLO | AMFM_VIBRATO | AMFM_DIRECTIVITY)];
+}
+
+void amfm_rotor_init(amfm_rotor *r, int rate_shift) {
+    memset(r, 0, sizeof(amfm_rotor));
+    r->rate_shift = rate_shift;
+    amfm_rotor_set_delay_depth(r, 0);
+    amfm_rotor_set_tremolo_depth(r, 0);
+    amfm_rotor_set_rotation_rate(r, 0);
+}
+
+// amfm_rotor_ring_len is the part of its ring _r_ uses at its rate.
+static inline int amfm_rotor_ring_len(const amfm_rotor *r) {
+    return AMFM_RINGBUF_LEN >> r->rate_shift;
+}
+
+// amfm_rotor_set_delay_depth sets the depth of the vibrato effect.
+// This is provided in milliseconds. The Leslie treble horn rotates
+// through 0.04064m of delay (the horn length is 8"). Assuming the
+// speed of sound is 344 m/s (sea level) this means a Leslie induces
+// 1.18ms of delay at its maximum.
+//
+// At 44.1kHz the ring buffer holds 128 * (1/44100) = 2.9ms, less the
+// two samples the read interpolates between.
+void amfm_rotor_set_delay_depth(amfm_rotor *r, float ms) {
+    // Our readOffset starts from 0 (no delay) and increases from
+    // there, so it's always subtracted from the ring buffer write
+    // index. It's Q8.8, so it's computed in float and clamped to the
+    // ring before it's narrowed.
+    float khz = 44.1f / (1 << r->rate_shift);
+    float delay = khz * ms * 256; // *256 for a <<8
+    float limit = (float)((amfm_rotor_ring_len(r) - 2) << 8);
+    int16_t maxDelay = (int16_t)(delay < 0 ? 0 : (delay > limit ? limit : delay));
+
+    fill_sinemod(r->readOffset, 0, maxDelay, 0);
+    r->readOffset[256] = r->readOffset[0];
+    r->delayed = maxDelay > 0;
+}
+
+// amfm_rotor_set_tremolo_depth sets the depth of the tremolo effect,
+// 0..1 (inclusive). 0 means no effect, 1 means the signal is
+// attenuated all the way to 0 once per cycle.
+void amfm_rotor_set_tremolo_depth(amfm_rotor *r, float depth) {
+    int16_t maxVolume = 32767;
+    int16_t minVolume = (uint16_t)((float)maxVolume * (1.0 - depth));
+
+    if (minVolume < 0) {
+        minVolume = 0;
+    } else if (minVolume > maxVolume) {
+        minVolume = maxVolume;
+    }
+
+    fill_sinemod(r->readVolume, minVolume, maxVolume, 0);
+    r->readVolume[256] = r->readVolume[0];
+    r->tremolo = minVolume < maxVolume;
+}
+
+// amfm_rotor_set_directivity sets the rotor's lowpass. A rotor at a
+// lower rate takes the full rate's coefficients, converted to keep
+// their lag: a one-pole with coefficient k delays low frequencies by
+// (1 - k) / k samples, so k becomes n k / (1 + (n - 1) k) at 1/n the
+// rate. Designing at the low rate instead would lag less, and the
+// drums wouldn't line up with the horns.
+void amfm_rotor_set_directivity(amfm_rotor *r, float min_hz, float max_hz, float sample_rate) {
+    fill_directivity(r->readCoef, min_hz, max_hz, sample_rate);
+
+    float n = (float)(1 << r->rate_shift);
+    for (int i = 0; i < 256 && n > 1; i++) {
+        float k = r->readCoef[i] / 32768.0f;
+        int32_t coef = (int32_t)(n * k / (1.0f + (n - 1.0f) * k) * 32768.0f + 0.5f);
+        r->readCoef[i] = coef > 32767 ? 32767 : coef;
+    }
+    r->readCoef[256] = r->readCoef[0];
+    r->directivity = 1;
+}
+
+// amfm_rotor_set_rotation_rate sets the rate of rotation of the effect
+// (in cycles per second).
+void amfm_rotor_set_rotation_rate(amfm_rotor *r, float hz) {
+    // 1<<32 / 44100 = 97391.55
+    r->phaseIncr = (uint32_t)(hz * 97391.55 * (1 << r->rate_shift) + 0.5);
+}
+
+void amfm_rotor_set_phase(amfm_rotor *r, float norm) {
+    r->phase = (uint32_t)((float)(0xFFFFFFFF) * norm);
+}
+
+// amfm_rotor_select picks the kernel for the parts of _r_ that do
+// something, and the stopped one if _r_ isn't turning.
+static amfm_fn amfm_rotor_select(const amfm_rotor *r) {
+    int parts = 0;
+    if (r->tremolo) {
+        parts |= AMFM_TREMOLO;
+    }
+    if (r->delayed) {
+        parts |= AMFM_VIBRATO;
+    }
+    if (r->directivity) {
+        parts |= AMFM_DIRECTIVITY;
+    }
+    if (r->phaseIncr == 0) {
+        return amfm_select_stopped(parts);
+    }
+    return amfm_select(parts);
+}
+
+int amfm_rotor_bypassed(const amfm_rotor *r) {
+    return amfm_rotor_select(r) == NULL;
+}
+
+int amfm_rotor_process(amfm_rotor *r, int16_t *block, int len) {
+    amfm_fn fn = amfm_rotor_select(r);
+    if (fn == NULL) {
+        return 0;
+    }
+
+    // Gain and delay are updated at control rate, every 16 samples
+    // at 44.1kHz; see amfm_update_ctl. A rotor at a lower rate
+    // updates every 8 of its samples at least, or the updates would
+    // cost more than the samples between them.
+    int ctl_shift = AMFM_CTL_SHIFT - r->rate_shift;
+    ctl_shift = ctl_shift < 3 ? 3 : ctl_shift;
+
+    fn(block, block, len, r->ringbuf, amfm_rotor_ring_len(r), &r->wp, r->readVolume, r->readOffset, r->readCoef, &r->lp, r->phaseIncr, &r->phase, ctl_shift);
+    return 1;
+}
+
+void amfm_rotor_skip(amfm_rotor *r, int len) {
+    r->phase += r->phaseIncr * (uint32_t)len;
+}
+
+void amfm_rotor_clear(amfm_rotor *r) {
+    memset(r->ringbuf, 0, sizeof(r->ringbuf));
+    r->lp = 0;
+}
+
+void amfm_update_ctl(int16_t *dst, int16_t *src, int dstsrc_len, int16_t *ringbuf, int ringbuf_len, uint32_t *ringbuf_wp, int16_t *readVolume, int16_t *readOffset, uint32_t phaseIncr, uint32_t *phase_out, int ctl_shift) {
+    amfm_ctl_kernel(dst, src, dstsrc_len, ringbuf, ringbuf_len, ringbuf_wp, readVolume, readOffset, phaseIncr, phase_out, ctl_shift, NULL, NULL, AMFM_TREMOLO | AMFM_VIBRATO);
+}
+
+void amfm_update_dir(int16_t *dst, int16_t *src, int dstsrc_len, int16_t *ringbuf, int ringbuf_len, uint32_t *ringbuf_wp, int16_t *readVolume, int16_t *readOffset, int16_t *readCoef, int32_t *lp, uint32_t phaseIncr, uint32_t *phase_out, int ctl_shift) {
+    amfm_ctl_kernel(dst, src, dstsrc_len, ringbuf, ringbuf_len, ringbuf_wp, readVolume, readOffset, phaseIncr, phase_out, ctl_shift, readCoef, lp, AMFM_TREMOLO | AMFM_VIBRATO | AMFM_DIRECTIVITY);
+}
+
+void amfm_update_ctl_f32(float *dst, float *src, int dstsrc_len, float *ringbuf, int ringbuf_len, uint32_t *ringbuf_wp, int16_t *readVolume, int16_t *readOffset, uint32_t phaseIncr, uint32_t *phase_out, int ctl_shift) {
+    amfm_ctl_kernel(dst, src, dstsrc_len, ringbuf, ringbuf_len, ringbuf_wp, readVolume, readOffset, phaseIncr, phase_out, ctl_shift, NULL, NULL, AMFM_TREMOLO | AMFM_VIBRATO);
+}
+
+void amfm_update_dir_f32(float *dst, float *src, int dstsrc_len, float *ringbuf, int ringbuf_len, uint32_t *ringbuf_wp, int16_t *readVolume, int16_t *readOffset, int16_t *readCoef, float *lp, uint32_t phaseIncr, uint32_t *phase_out, int ctl_shift) {
+    amfm_ctl_kernel(dst, src, dstsrc_len, ringbuf, ringbuf_len, ringbuf_wp, readVolume, readOffset, phaseIncr, phase_out, ctl_shift, readCoef, lp, AMFM_TREMOLO | AMFM_VIBRATO | AMFM_DIRECTIVITY);
+}
+
 #if defined(__cplusplus)
 }
 #endif
@@ -29,6 +29,124 @@ void fill_sinemod(int16_t ret[256], int16_t min, int16_t max, int32_t phase);
 
 void amfm_update(int16_t *dst, int16_t *src, int dstsrc_len, int16_t *ringbuf, int ringbuf_len, uint32_t *ringbuf_wp, int16_t *readVolume, int16_t *readOffset, uint32_t phaseIncr, uint32_t *phase_out);
 
+// AMFM_CTL_SHIFT sets the control rate of amfm_update_ctl: gain and
+// delay are looked up every 1 << AMFM_CTL_SHIFT samples.
+#define AMFM_CTL_SHIFT (4)
+
+// amfm_update_ctl is amfm_update at control rate. The gain and delay
+// are looked up every 1 << _ctl_shift_ samples and ramped linearly in
+// between, which leaves a ring write, a fractional read and a
+// multiply per sample. _ringbuf_len_ must be a power of two.
+void amfm_update_ctl(int16_t *dst, int16_t *src, int dstsrc_len, int16_t *ringbuf, int ringbuf_len, uint32_t *ringbuf_wp, int16_t *readVolume, int16_t *readOffset, uint32_t phaseIncr, uint32_t *phase_out, int ctl_shift);
+
+// fill_directivity fills ret with one-pole lowpass coefficients (Q15)
+// for a rotor that's brightest at the peak of a phase 0 sinemod
+// (_max_hz_) and dullest facing away (_min_hz_).
+void fill_directivity(int16_t ret[256], float min_hz, float max_hz, float sample_rate);
+
+// amfm_update_dir is amfm_update_ctl with directivity: after the
+// delay, the signal goes through a one-pole lowpass whose coefficient
+// is read from the angle-indexed _readCoef_ table (see
+// fill_directivity) at control rate, and ramped like the gain. _lp_
+// holds the filter's state between blocks.
+void amfm_update_dir(int16_t *dst, int16_t *src, int dstsrc_len, int16_t *ringbuf, int ringbuf_len, uint32_t *ringbuf_wp, int16_t *readVolume, int16_t *readOffset, int16_t *readCoef, int32_t *lp, uint32_t phaseIncr, uint32_t *phase_out, int ctl_shift);
+
+// AMFM_TREMOLO, AMFM_VIBRATO and AMFM_DIRECTIVITY are the parts of
+// amfm_update_dir: the gain, the delay and the lowpass.
+#define AMFM_TREMOLO (1 << 0)
+#define AMFM_VIBRATO (1 << 1)
+#define AMFM_DIRECTIVITY (1 << 2)
+
+// amfm_fn has the arguments of amfm_update_dir.
+typedef void (*amfm_fn)(int16_t *dst, int16_t *src, int dstsrc_len, int16_t *ringbuf, int ringbuf_len, uint32_t *ringbuf_wp, int16_t *readVolume, int16_t *readOffset, int16_t *readCoef, int32_t *lp, uint32_t phaseIncr, uint32_t *phase_out, int ctl_shift);
+
+// amfm_select returns amfm_update_dir specialized to run only the
+// given AMFM_* _parts_, or NULL if there are none and the output is
+// the input. Without AMFM_VIBRATO the ring buffer isn't written, and
+// readCoef and lp are only used with AMFM_DIRECTIVITY.
+amfm_fn amfm_select(int parts);
+
+// amfm_select_stopped is amfm_select for a phaseIncr of 0: the
+// kernels hold the gain, delay and coefficient at *phase_out for the
+// whole block instead of ramping them at control rate, and match
+// amfm_select's kernels otherwise.
+amfm_fn amfm_select_stopped(int parts);
+
+// The ring buffer length of an amfm_rotor at 44.1kHz; it must be a
+// power of two. A rotor at a lower rate uses the part of it that
+// holds as much time, 2.9ms.
+#define AMFM_RINGBUF_LEN (128)
+
+// amfm_rotor is one rotating speaker: its ring buffer, its rotation
+// and its modulation tables. See amfm_audio.h for how the tables are
+// set.
+typedef struct _amfm_rotor {
+    // Ring buffer & its write position.
+    int16_t ringbuf[AMFM_RINGBUF_LEN];
+    uint32_t wp;
+
+    // Phase increment & current angle for speaker rotation.
+    uint32_t phaseIncr;
+    uint32_t phase;
+
+    // Modulation amounts for the read head & volume. This is a 256
+    // value array with the first item duplicated at the end, so we
+    // can index blindly off the end.
+    int16_t readOffset[257];
+    int16_t readVolume[257];
+
+    // Directivity lowpass coefficients, laid out like readVolume, and
+    // the filter's state.
+    int16_t readCoef[257];
+    int32_t lp;
+
+    // Whether the delay, gain and lowpass are used at all.
+    uint8_t delayed;
+    uint8_t tremolo;
+    uint8_t directivity;
+
+    // The rotor runs at 44.1kHz >> rate_shift.
+    uint8_t rate_shift;
+} amfm_rotor;
+
+// amfm_rotor_init stops _r_ with no delay, tremolo or directivity.
+// It will run at 44.1kHz >> _rate_shift_, and the setters scale the
+// rotation, delay and directivity to match; the Leslie runs its drums
+// at a quarter rate, below the crossover. _rate_shift_ must be less
+// than 5.
+void amfm_rotor_init(amfm_rotor *r, int rate_shift);
+void amfm_rotor_set_delay_depth(amfm_rotor *r, float ms);
+void amfm_rotor_set_tremolo_depth(amfm_rotor *r, float depth);
+void amfm_rotor_set_directivity(amfm_rotor *r, float min_hz, float max_hz, float sample_rate);
+void amfm_rotor_set_rotation_rate(amfm_rotor *r, float hz);
+void amfm_rotor_set_phase(amfm_rotor *r, float norm);
+
+// amfm_rotor_process runs _r_ in place on _block_. Only the parts that
+// do something run. A stopped rotor keeps the delay, gain and filter
+// of where it stopped, from amfm_select_stopped's kernels, and keeps
+// writing its ring, so stopping and starting don't click. It returns 0, leaving _block_ untouched, if
+// nothing is left.
+int amfm_rotor_process(amfm_rotor *r, int16_t *block, int len);
+
+// amfm_rotor_bypassed returns nonzero if amfm_rotor_process would
+// leave blocks untouched.
+int amfm_rotor_bypassed(const amfm_rotor *r);
+
+// amfm_rotor_skip turns _r_ through _len_ samples of silence, at its
+// own rate like amfm_rotor_process, without processing them. The ring
+// and lowpass must already be silent; see amfm_rotor_clear.
+void amfm_rotor_skip(amfm_rotor *r, int len);
+
+// amfm_rotor_clear silences the ring and lowpass of _r_, keeping its
+// rotation and settings.
+void amfm_rotor_clear(amfm_rotor *r);
+
+// amfm_update_ctl_f32 and amfm_update_dir_f32 are the same kernels on
+// float samples, for hosts. The tables are shared with the int16
+// versions.
+void amfm_update_ctl_f32(float *dst, float *src, int dstsrc_len, float *ringbuf, int ringbuf_len, uint32_t *ringbuf_wp, int16_t *readVolume, int16_t *readOffset, uint32_t phaseIncr, uint32_t *phase_out, int ctl_shift);
+void amfm_update_dir_f32(float *dst, float *src, int dstsrc_len, float *ringbuf, int ringbuf_len, uint32_t *ringbuf_wp, int16_t *readVolume, int16_t *readOffset, int16_t *readCoef, float *lp, uint32_t phaseIncr, uint32_t *phase_out, int ctl_shift);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -7,50 +7,29 @@
 
 #include "amfm.h"
 
-#define AMFM_RINGBUF_LEN (512)
-
-// AmFm is a combined amplitude and frequency modulation effect. The
-// amplitude and frequency offsets are both provided as lookup tables,
-// indexed by the phase of a rotating angle. The phases are locked
-// together, so this one effect can model the doppler and volume shift
-// of a single rotating speaker.
-class AmFm : public AudioStream {
+// AmFmCore is a combined amplitude and frequency modulation effect.
+// The amplitude and frequency offsets are both provided as lookup
+// tables, indexed by the phase of a rotating angle. The phases are
+// locked together, so this one effect can model the doppler and
+// volume shift of a single rotating speaker.
+//
+// AmFmCore holds the rotor and its controls without an AudioStream,
+// so the Leslie node can own several; AmFm is the standalone node.
+class AmFmCore {
   public:
-    AmFm() : AudioStream(1, inputQueueArray) {
+    // The rotor runs at AUDIO_SAMPLE_RATE_EXACT >> rateShift; see
+    // amfm_rotor_init.
+    AmFmCore(int rateShift = 0) : rateShift(rateShift) {
     }
 
     void init() {
-        phase = 0;
-        setDelayDepth(0);
-        setTremoloDepth(0);
-        setRotationRate(0);
-        memset(ringbuf, 0, AMFM_RINGBUF_LEN * sizeof(int16_t));
+        amfm_rotor_init(&rotor, rateShift);
     }
 
-    // setDelayDepth sets the depth of the vibrato effect. This is
-    // provided in milliseconds. The Leslie treble horn rotates
-    // through 0.04064m of delay (the horn length is 8"). Assuming the
-    // speed of sound is 344 m/s (sea level) this means a Leslie
-    // induces 1.18ms of delay at its maximum.
-    //
-    // This effect incorporates a fixed length 512 sample ring
-    // buffer, so at 44.1kHz the maximum delay available is
-    // 512 * (1/44100) = 11.6ms.
+    // setDelayDepth sets the depth of the vibrato effect, in
+    // milliseconds; see amfm_rotor_set_delay_depth.
     void setDelayDepth(float ms) {
-        // Our readOffset starts from 0 (no delay) and increases from
-        // there, so it's always subtracted from the ring buffer write
-        // index.
-        int16_t maxDelay = (int16_t)(44.1 * ms * 256); // *256 for a <<8
-
-        // Clamp the delay to our ringbuffer length.
-        if (maxDelay < 0) {
-            maxDelay = 0;
-        } else if ((maxDelay >> 8) > AMFM_RINGBUF_LEN) {
-            maxDelay = AMFM_RINGBUF_LEN;
-        }
-
-        fill_sinemod(readOffset, 0, maxDelay, 0);
-        readOffset[256] = readOffset[0];
+        amfm_rotor_set_delay_depth(&rotor, ms);
     }
 
     // setTremoloDepth sets the depth of the tremolo effect. This is a
@@ -58,67 +37,75 @@ class AmFm : public AudioStream {
     // effect, 1 means the signal is attenuated all the way to 0 once
     // per cycle.
     void setTremoloDepth(float depth) {
-        int16_t maxVolume = 32767;
-        int16_t minVolume = (uint16_t)((float)maxVolume * (1.0 - depth));
-
-        if (minVolume < 0) {
-            minVolume = 0;
-        } else if (minVolume > maxVolume) {
-            minVolume = maxVolume;
-        }
+        amfm_rotor_set_tremolo_depth(&rotor, depth);
+    }
 
-        fill_sinemod(readVolume, minVolume, maxVolume, 0);
-        readVolume[256] = readVolume[0];
+    // setDirectivity makes the rotor brighter when it faces the
+    // microphone, at the peak of its tremolo: a one-pole lowpass
+    // sweeps from minHz facing away to maxHz on axis. The
+    // coefficients are precomputed per angle and interpolated at
+    // control rate, costing a few cycles per sample.
+    void setDirectivity(float minHz, float maxHz) {
+        amfm_rotor_set_directivity(&rotor, minHz, maxHz, AUDIO_SAMPLE_RATE_EXACT);
     }
 
     // setRotationRate sets the rate of rotation of the effect (in
     // cycles per second).
     void setRotationRate(float hz) {
-        // 1<<32 / 44100 = 97391.55
-        phaseIncr = (uint32_t)(hz * 97391.55 + 0.5);
+        amfm_rotor_set_rotation_rate(&rotor, hz);
     }
 
     void setPhase(float norm) {
-        phase = (uint32_t)((float)(0xFFFFFFFF) * norm);
+        amfm_rotor_set_phase(&rotor, norm);
+    }
+
+    amfm_rotor rotor;
+
+  private:
+    int rateShift;
+};
+
+class AmFm : public AudioStream, public AmFmCore {
+  public:
+    AmFm() : AudioStream(1, inputQueueArray), idle(false) {
     }
 
     void update(void) {
-        audio_block_t *in = receiveReadOnly(0);
-        if (in == NULL) {
+        // A rotor with nothing to do forwards its input as is.
+        if (amfm_rotor_bypassed(&rotor)) {
+            audio_block_t *in = receiveReadOnly(0);
+            if (in != NULL) {
+                transmit(in, 0);
+                release(in);
+            }
             return;
         }
 
-        audio_block_t *out = allocate();
-        if (out == NULL) {
-            release(in);
+        // Process in place. The crossover's outputs feed both the L
+        // and R rotors, so whichever of them runs first gets a copy.
+        // No block is silence: the rotor keeps turning, and its ring
+        // is cleared once so the next sound doesn't start with the
+        // end of the last.
+        audio_block_t *block = receiveWritable(0);
+        if (block == NULL) {
+            if (!idle) {
+                amfm_rotor_clear(&rotor);
+                idle = true;
+            }
+            amfm_rotor_skip(&rotor, AUDIO_BLOCK_SAMPLES);
             return;
         }
+        idle = false;
 
-        // Making this overly complex in order to extract the logic
-        // into amfm.cpp for offline testing. To be cleaned up later.
-        amfm_update(out->data, in->data, AUDIO_BLOCK_SAMPLES, ringbuf, AMFM_RINGBUF_LEN, &wp, readVolume, readOffset, phaseIncr, &phase);
+        amfm_rotor_process(&rotor, block->data, AUDIO_BLOCK_SAMPLES);
 
-        transmit(out, 0);
-        release(out);
-        release(in);
+        transmit(block, 0);
+        release(block);
     }
 
   private:
-    // Ring buffer & its write position.
-    int16_t ringbuf[AMFM_RINGBUF_LEN];
-    uint32_t wp;
-
-    // Phase increment & current angle for speaker rotation.
-    uint32_t phaseIncr;
-    uint32_t phase;
-
-    // Modulation amounts for the read head & volume. This is a 256
-    // value array with the first item duplicated at the end, so we
-    // can index blindly off the end.
-    int16_t readOffset[257];
-    int16_t readVolume[257];
-
     audio_block_t *inputQueueArray[1];
+    bool idle;
 };
 
 #endif
@@ -4,11 +4,14 @@
 
 #include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "greatest.h"
 
 #include "amfm.h"
+#include "profile.h"
+#include "tonewheel_osc.h"
 
 TEST test_fill_sinemod() {
     int16_t vals[256] = {0};
@@ -101,12 +104,394 @@ TEST test_amfm_update() {
     PASS();
 }
 
+// amfm_tables fills Leslie horn style tables: _depth_ tremolo and
+// _ms_ of delay.
+static void amfm_tables(int16_t volume[257], int16_t offset[257], float depth, float ms) {
+    fill_sinemod(volume, (int16_t)(32767 * (1.0 - depth)), 32767, 0);
+    volume[256] = volume[0];
+    fill_sinemod(offset, 0, (int16_t)(44.1 * ms * 256), 0);
+    offset[256] = offset[0];
+}
+
+// test_amfm_update_ctl_unmodulated ensures the control rate path
+// matches amfm_update exactly when nothing is modulated.
+TEST test_amfm_update_ctl_unmodulated() {
+    static int16_t volume[257], offset[257];
+    static int16_t src[128], want[128], got[128];
+    static int16_t ring_want[512], ring_got[512];
+
+    amfm_tables(volume, offset, 0, 0);
+    for (int i = 0; i < 128; i++) {
+        src[i] = (i * 977) % 20000 - 10000;
+    }
+
+    uint32_t wp_want = 0, wp_got = 0;
+    uint32_t phase_want = 0, phase_got = 0;
+    memset(ring_want, 0, sizeof(ring_want));
+    memset(ring_got, 0, sizeof(ring_got));
+    for (int b = 0; b < 8; b++) {
+        amfm_update(want, src, 128, ring_want, 512, &wp_want, volume, offset, 1 << 20, &phase_want);
+        amfm_update_ctl(got, src, 128, ring_got, 512, &wp_got, volume, offset, 1 << 20, &phase_got, AMFM_CTL_SHIFT);
+        ASSERT_MEM_EQ(want, got, sizeof(want));
+    }
+    ASSERT_EQ_FMT(phase_want, phase_got, "%u");
+    ASSERT_EQ_FMT(wp_want, wp_got, "%u");
+
+    PASS();
+}
+
+// test_amfm_update_ctl_fidelity ensures the control rate path stays
+// close to amfm_update for a horn at fast speed, the fastest
+// modulation the Leslie uses.
+TEST test_amfm_update_ctl_fidelity() {
+    static int16_t volume[257], offset[257];
+    static int16_t src[128], want[128], got[128];
+    static int16_t ring_want[512], ring_got[512];
+
+    amfm_tables(volume, offset, 0.1, 1.18);
+    memset(ring_want, 0, sizeof(ring_want));
+    memset(ring_got, 0, sizeof(ring_got));
+
+    // 6.66Hz rotation.
+    uint32_t phase_incr = (uint32_t)(6.66 * 97391.55 + 0.5);
+    uint32_t wp_want = 0, wp_got = 0;
+    uint32_t phase_want = 0, phase_got = 0;
+    uint32_t src_phase = 0;
+    int max_err = 0;
+
+    for (int b = 0; b < 100; b++) {
+        // A 1kHz sine at half scale.
+        for (int i = 0; i < 128; i++) {
+            src[i] = isin_S4(src_phase) * 4;
+            src_phase += 743;
+        }
+
+        amfm_update(want, src, 128, ring_want, 512, &wp_want, volume, offset, phase_incr, &phase_want);
+        amfm_update_ctl(got, src, 128, ring_got, 512, &wp_got, volume, offset, phase_incr, &phase_got, AMFM_CTL_SHIFT);
+
+        for (int i = 0; b > 0 && i < 128; i++) {
+            int err = abs(want[i] - got[i]);
+            max_err = err > max_err ? err : max_err;
+        }
+    }
+
+    // Measured at 9 (about -71dB below the half scale sine).
+    ASSERTm("control rate output too far from amfm_update", max_err < 16);
+
+    PASS();
+}
+
+TEST test_fill_directivity() {
+    int16_t coef[256];
+    fill_directivity(coef, 2000, 12000, 44100);
+
+    // Brightest on axis, dullest facing away, and symmetric.
+    for (int i = 0; i < 256; i++) {
+        ASSERT(coef[i] <= coef[64]);
+        ASSERT(coef[i] >= coef[192]);
+    }
+    ASSERT_EQ_FMT(coef[32], coef[96], "%d");
+
+    // 1 - exp(-2pi * 2000 / 44100) is 0.248.
+    ASSERT_IN_RANGE(8125, coef[192], 2);
+
+    PASS();
+}
+
+// amfm_hf_level returns the peak level of a 10kHz sine through
+// amfm_update_dir with the rotor stopped at _phase_.
+static int amfm_hf_level(int16_t *coef, uint32_t phase) {
+    static int16_t volume[257], offset[257];
+    static int16_t ring[512];
+    int16_t src[128], dst[128];
+
+    amfm_tables(volume, offset, 0, 0);
+    memset(ring, 0, sizeof(ring));
+
+    uint32_t wp = 0;
+    uint32_t src_phase = 0;
+    int32_t lp = 0;
+    int peak = 0;
+    for (int b = 0; b < 4; b++) {
+        for (int i = 0; i < 128; i++) {
+            src[i] = isin_S4(src_phase) * 4;
+            src_phase += 7430;
+        }
+        amfm_update_dir(dst, src, 128, ring, 512, &wp, volume, offset, coef, &lp, 0, &phase, AMFM_CTL_SHIFT);
+        for (int i = 0; b > 0 && i < 128; i++) {
+            peak = abs(dst[i]) > peak ? abs(dst[i]) : peak;
+        }
+    }
+    return peak;
+}
+
+TEST test_amfm_update_dir() {
+    static int16_t coef[257];
+    fill_directivity(coef, 2000, 12000, 44100);
+    coef[256] = coef[0];
+
+    // Facing away from the microphone, 10kHz is well down.
+    int on = amfm_hf_level(coef, 64 << 24);
+    int off = amfm_hf_level(coef, 192 << 24);
+    ASSERTm("no directivity", off * 2 < on);
+
+    // A fully open filter passes everything, as amfm_update_ctl does.
+    static int16_t volume[257], offset[257];
+    static int16_t src[128], want[128], got[128];
+    static int16_t ring_want[512], ring_got[512];
+    for (int i = 0; i < 257; i++) {
+        coef[i] = 32767;
+    }
+    amfm_tables(volume, offset, 0.1, 1.18);
+    memset(ring_want, 0, sizeof(ring_want));
+    memset(ring_got, 0, sizeof(ring_got));
+
+    uint32_t wp_want = 0, wp_got = 0;
+    uint32_t phase_want = 0, phase_got = 0;
+    int32_t lp = 0;
+    for (int b = 0; b < 8; b++) {
+        for (int i = 0; i < 128; i++) {
+            src[i] = ((b * 128 + i) * 977) % 20000 - 10000;
+        }
+        amfm_update_ctl(want, src, 128, ring_want, 512, &wp_want, volume, offset, 1 << 20, &phase_want, AMFM_CTL_SHIFT);
+        amfm_update_dir(got, src, 128, ring_got, 512, &wp_got, volume, offset, coef, &lp, 1 << 20, &phase_got, AMFM_CTL_SHIFT);
+        for (int i = 0; i < 128; i++) {
+            ASSERT_IN_RANGE(want[i], got[i], 1);
+        }
+    }
+
+    PASS();
+}
+
+// test_amfm_select ensures the specialized kernels match the full
+// one, and that a tremolo without delay leaves the ring alone.
+TEST test_amfm_select() {
+    ASSERT_EQ(NULL, amfm_select(0));
+
+    static int16_t volume[257], offset[257], coef[257];
+    static int16_t src[128], want[128], got[128];
+    static int16_t ring_want[512], ring_got[512];
+    amfm_tables(volume, offset, 0.1, 1.18);
+    fill_directivity(coef, 2000, 12000, 44100);
+    coef[256] = coef[0];
+    memset(ring_want, 0, sizeof(ring_want));
+    memset(ring_got, 0, sizeof(ring_got));
+
+    amfm_fn all = amfm_select(AMFM_TREMOLO | AMFM_VIBRATO | AMFM_DIRECTIVITY);
+    uint32_t wp_want = 0, wp_got = 0;
+    uint32_t phase_want = 0, phase_got = 0;
+    int32_t lp_want = 0, lp_got = 0;
+    for (int b = 0; b < 8; b++) {
+        for (int i = 0; i < 128; i++) {
+            src[i] = ((b * 128 + i) * 977) % 20000 - 10000;
+        }
+        amfm_update_dir(want, src, 128, ring_want, 512, &wp_want, volume, offset, coef, &lp_want, 1 << 20, &phase_want, AMFM_CTL_SHIFT);
+        all(got, src, 128, ring_got, 512, &wp_got, volume, offset, coef, &lp_got, 1 << 20, &phase_got, AMFM_CTL_SHIFT);
+        ASSERT_MEM_EQ(want, got, sizeof(want));
+    }
+
+    // A flat half gain, with no delay.
+    for (int i = 0; i < 257; i++) {
+        volume[i] = 16384;
+    }
+    memset(ring_got, 0, sizeof(ring_got));
+    wp_got = 0;
+    amfm_select(AMFM_TREMOLO)(got, src, 128, ring_got, 512, &wp_got, volume, offset, NULL, NULL, 1 << 20, &phase_got, AMFM_CTL_SHIFT);
+    for (int i = 0; i < 128; i++) {
+        ASSERT_IN_RANGE(src[i] >> 1, got[i], 1);
+    }
+    ASSERT_EQ_FMT(0, wp_got, "%u");
+    for (int i = 0; i < 512; i++) {
+        ASSERT_EQ_FMT(0, ring_got[i], "%d");
+    }
+
+    PASS();
+}
+
+// test_amfm_select_stopped ensures the stopped kernels match the
+// general ones at a phaseIncr of 0, with whole and fractional delays,
+// and that they're cheaper.
+TEST test_amfm_select_stopped() {
+    ASSERT_EQ(NULL, amfm_select_stopped(0));
+
+    static int16_t volume[257], offset[257], coef[257];
+    static int16_t src[128], want[128], got[128];
+    static int16_t ring_want[128], ring_got[128];
+    amfm_tables(volume, offset, 0.3, 1.18);
+    fill_directivity(coef, 2000, 12000, 44100);
+    coef[256] = coef[0];
+
+    for (int whole = 0; whole < 2; whole++) {
+        if (whole) {
+            for (int i = 0; i < 257; i++) {
+                offset[i] = (3 + i % 5) << 8;
+            }
+        }
+        for (int parts = 1; parts < 8; parts++) {
+            amfm_fn general = amfm_select(parts);
+            amfm_fn stopped = amfm_select_stopped(parts);
+            memset(ring_want, 0, sizeof(ring_want));
+            memset(ring_got, 0, sizeof(ring_got));
+
+            uint32_t wp_want = 0, wp_got = 0;
+            uint32_t phase_want = 0x12345678, phase_got = 0x12345678;
+            int32_t lp_want = 0, lp_got = 0;
+            for (int b = 0; b < 4; b++) {
+                for (int i = 0; i < 128; i++) {
+                    src[i] = ((b * 128 + i) * 977) % 20000 - 10000;
+                }
+                general(want, src, 128, ring_want, 128, &wp_want, volume, offset, coef, &lp_want, 0, &phase_want, AMFM_CTL_SHIFT);
+                stopped(got, src, 128, ring_got, 128, &wp_got, volume, offset, coef, &lp_got, 0, &phase_got, AMFM_CTL_SHIFT);
+                ASSERT_MEM_EQ(want, got, sizeof(want));
+            }
+            ASSERT_MEM_EQ(ring_want, ring_got, sizeof(ring_want));
+            ASSERT_EQ_FMT(wp_want, wp_got, "%u");
+            ASSERT_EQ_FMT(phase_want, phase_got, "%u");
+            ASSERT_EQ_FMT(lp_want, lp_got, "%d");
+        }
+    }
+
+    // Every part on, with a fractional delay, is where the stopped
+    // kernel saves least. Take the fastest of many runs of each so
+    // the host's noise doesn't decide.
+    amfm_tables(volume, offset, 0.3, 1.18);
+    uint32_t best[2] = {UINT32_MAX, UINT32_MAX};
+    for (int run = 0; run < 200; run++) {
+        for (int k = 0; k < 2; k++) {
+            amfm_fn fn = k ? amfm_select_stopped(7) : amfm_select(7);
+            uint32_t wp = 0, phase = 0x12345678;
+            int32_t lp = 0;
+            uint32_t start = profile_cycles();
+            fn(got, src, 128, ring_got, 128, &wp, volume, offset, coef, &lp, 0, &phase, AMFM_CTL_SHIFT);
+            uint32_t cycles = profile_cycles() - start;
+            best[k] = cycles < best[k] ? cycles : best[k];
+        }
+    }
+    ASSERT(best[1] < best[0]);
+
+    PASS();
+}
+
+// test_amfm_update_ctl_f32 ensures the float kernel tracks the int16
+// one, where 1.0 is int16 full scale.
+TEST test_amfm_update_ctl_f32() {
+    static int16_t volume[257], offset[257];
+    static int16_t src[128], want[128];
+    static float src_f[128], got[128];
+    static int16_t ring_want[512];
+    static float ring_got[512];
+
+    amfm_tables(volume, offset, 0.1, 1.18);
+    memset(ring_want, 0, sizeof(ring_want));
+    memset(ring_got, 0, sizeof(ring_got));
+
+    uint32_t phase_incr = (uint32_t)(6.66 * 97391.55 + 0.5);
+    uint32_t wp_want = 0, wp_got = 0;
+    uint32_t phase_want = 0, phase_got = 0;
+    uint32_t src_phase = 0;
+    for (int b = 0; b < 20; b++) {
+        for (int i = 0; i < 128; i++) {
+            src[i] = isin_S4(src_phase) * 4;
+            src_f[i] = src[i] / 32768.0f;
+            src_phase += 743;
+        }
+
+        amfm_update_ctl(want, src, 128, ring_want, 512, &wp_want, volume, offset, phase_incr, &phase_want, AMFM_CTL_SHIFT);
+        amfm_update_ctl_f32(got, src_f, 128, ring_got, 512, &wp_got, volume, offset, phase_incr, &phase_got, AMFM_CTL_SHIFT);
+        for (int i = 0; i < 128; i++) {
+            // The int16 kernel truncates twice per sample.
+            ASSERT_IN_RANGE(want[i], got[i] * 32768.0f, 2.5f);
+        }
+    }
+    ASSERT_EQ_FMT(phase_want, phase_got, "%u");
+
+    PASS();
+}
+
+// test_amfm_rotor_stop ensures stopping and restarting a rotor doesn't
+// click: a 220Hz sine through it never steps by much more than the
+// sine itself does from one sample to the next.
+TEST test_amfm_rotor_stop() {
+    static amfm_rotor r;
+    amfm_rotor_init(&r, 0);
+    amfm_rotor_set_delay_depth(&r, 1.18);
+    amfm_rotor_set_rotation_rate(&r, 6.66);
+    amfm_rotor_set_phase(&r, 0.25);
+
+    // The sine moves by at most 2pi * 220 / 44100 * 10000 = 313 per
+    // sample; the rotor's doppler adds a little.
+    int16_t block[128];
+    int16_t last = 0;
+    uint32_t phase = 0;
+    int max_step = 0;
+    for (int b = 0; b < 40; b++) {
+        if (b == 10) {
+            amfm_rotor_set_rotation_rate(&r, 0);
+            ASSERT_FALSE(amfm_rotor_bypassed(&r));
+        } else if (b == 30) {
+            amfm_rotor_set_rotation_rate(&r, 6.66);
+        }
+
+        for (int i = 0; i < 128; i++) {
+            block[i] = isin_S4(phase >> 17) * 10000 / 4096;
+            phase += 21426832;
+        }
+        amfm_rotor_process(&r, block, 128);
+
+        for (int i = 0; b > 0 && i < 128; i++) {
+            int step = abs(block[i] - (i > 0 ? block[i - 1] : last));
+            max_step = step > max_step ? step : max_step;
+        }
+        last = block[127];
+    }
+    ASSERT_IN_RANGE(0, max_step, 340);
+
+    PASS();
+}
+
+// test_amfm_rotor_delay_clamp ensures delays past a rotor's ring are
+// clamped to what it can read, at full and quarter rate, rather than
+// wrapping around.
+TEST test_amfm_rotor_delay_clamp() {
+    static amfm_rotor r;
+    for (int shift = 0; shift <= 2; shift += 2) {
+        int16_t limit = ((AMFM_RINGBUF_LEN >> shift) - 2) << 8;
+
+        amfm_rotor_init(&r, shift);
+        amfm_rotor_set_delay_depth(&r, 1.18);
+        int16_t peak = 0;
+        for (int i = 0; i < 257; i++) {
+            peak = r.readOffset[i] > peak ? r.readOffset[i] : peak;
+        }
+        ASSERT_IN_RANGE(44.1 / (1 << shift) * 1.18 * 256, peak, 2);
+
+        amfm_rotor_set_delay_depth(&r, 20);
+        peak = 0;
+        for (int i = 0; i < 257; i++) {
+            ASSERT(r.readOffset[i] >= 0);
+            peak = r.readOffset[i] > peak ? r.readOffset[i] : peak;
+        }
+        ASSERT_EQ_FMT(limit, peak, "%d");
+    }
+
+    PASS();
+}
+
 GREATEST_SUITE(amfm_suite) {
     RUN_TEST(test_fill_sinemod);
     RUN_TEST(test_fill_sinemod_zeros);
     RUN_TEST(test_fill_sinemod_phase);
     RUN_TEST(test_fill_sinemod_amplitude);
     RUN_TEST(test_amfm_update);
+    RUN_TEST(test_amfm_update_ctl_unmodulated);
+    RUN_TEST(test_amfm_update_ctl_fidelity);
+    RUN_TEST(test_fill_directivity);
+    RUN_TEST(test_amfm_update_dir);
+    RUN_TEST(test_amfm_select);
+    RUN_TEST(test_amfm_select_stopped);
+    RUN_TEST(test_amfm_update_ctl_f32);
+    RUN_TEST(test_amfm_rotor_stop);
+    RUN_TEST(test_amfm_rotor_delay_clamp);
 }
 
 #endif
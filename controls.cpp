@@ -0,0 +1,37 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "controls.h"
+
+void controls_init(controls *c) {
+    memset(c, 0, sizeof(controls));
+}
+
+void controls_route(controls *c, uint8_t ctrl, uint8_t groups) {
+    c->routes[ctrl & 0x7f] |= groups;
+}
+
+uint8_t controls_change(controls *c, uint8_t ctrl) {
+    uint8_t groups = c->routes[ctrl & 0x7f];
+    c->dirty |= groups;
+    return groups;
+}
+
+void controls_mark(controls *c, uint8_t groups) {
+    c->dirty |= groups;
+}
+
+uint8_t controls_take(controls *c) {
+    uint8_t dirty = c->dirty;
+    c->dirty = 0;
+    return dirty;
+}
+
+#if defined(__cplusplus)
+}
+#endif
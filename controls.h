@@ -0,0 +1,48 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef CONTROLS_H
+#define CONTROLS_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// Control groups: each is a set of parameters recomputed together,
+// such as every tonewheel volume.
+#define CONTROL_TONEWHEELS (1 << 0)
+#define CONTROL_PERCUSSION (1 << 1)
+#define CONTROL_LESLIE_ROTATION (1 << 2)
+#define CONTROL_VIBRATO (1 << 3)
+#define CONTROL_DRIVE (1 << 4)
+#define CONTROL_SWELL (1 << 5)
+
+// controls routes MIDI CCs to the control groups they affect. A CC
+// only marks its groups dirty; controls_take collects them, so a
+// burst of CCs costs one recompute of each group it touched.
+typedef struct _controls {
+    uint8_t routes[128];
+    uint8_t dirty;
+} controls;
+
+void controls_init(controls *c);
+
+// controls_route makes CC _ctrl_ dirty _groups_ (ORed CONTROL_*).
+void controls_route(controls *c, uint8_t ctrl, uint8_t groups);
+
+// controls_change marks the groups routed from _ctrl_ dirty. It
+// returns them, or 0 if the CC isn't routed.
+uint8_t controls_change(controls *c, uint8_t ctrl);
+
+// controls_mark marks _groups_ dirty directly.
+void controls_mark(controls *c, uint8_t groups);
+
+// controls_take returns the dirty groups and clears them.
+uint8_t controls_take(controls *c);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,55 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifdef ROTO_TEST
+
+#include "greatest.h"
+
+#include "controls.h"
+
+TEST test_controls_route() {
+    controls c;
+    controls_init(&c);
+    controls_route(&c, 87, CONTROL_PERCUSSION);
+    controls_route(&c, 87, CONTROL_TONEWHEELS);
+    controls_route(&c, 70, CONTROL_TONEWHEELS);
+
+    ASSERT_EQ_FMT(CONTROL_PERCUSSION | CONTROL_TONEWHEELS, controls_change(&c, 87), "%d");
+    ASSERT_EQ_FMT(0, controls_change(&c, 1), "%d");
+    ASSERT_EQ_FMT(CONTROL_PERCUSSION | CONTROL_TONEWHEELS, controls_take(&c), "%d");
+    ASSERT_EQ_FMT(0, controls_take(&c), "%d");
+
+    PASS();
+}
+
+// test_controls_coalesce ensures a registration change, nine drawbar
+// CCs, dirties the tonewheels once.
+TEST test_controls_coalesce() {
+    controls c;
+    controls_init(&c);
+    for (int i = 70; i <= 78; i++) {
+        controls_route(&c, i, CONTROL_TONEWHEELS);
+    }
+    controls_route(&c, 82, CONTROL_LESLIE_ROTATION);
+
+    for (int i = 70; i <= 78; i++) {
+        controls_change(&c, i);
+    }
+    ASSERT_EQ_FMT(CONTROL_TONEWHEELS, controls_take(&c), "%d");
+
+    controls_change(&c, 82);
+    controls_change(&c, 70);
+    ASSERT_EQ_FMT(CONTROL_TONEWHEELS | CONTROL_LESLIE_ROTATION, controls_take(&c), "%d");
+
+    controls_mark(&c, CONTROL_VIBRATO);
+    controls_change(&c, 70);
+    ASSERT_EQ_FMT(CONTROL_TONEWHEELS | CONTROL_VIBRATO, controls_take(&c), "%d");
+
+    PASS();
+}
+
+GREATEST_SUITE(controls_suite) {
+    RUN_TEST(test_controls_route);
+    RUN_TEST(test_controls_coalesce);
+}
+
+#endif
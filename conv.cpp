@@ -0,0 +1,320 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "conv.h"
+
+#if CONV_THREADS
+#include <sched.h>
+#endif
+
+static int part_init(conv_part *p, const float *ir, size_t ir_len, size_t block) {
+    memset(p, 0, sizeof(conv_part));
+    p->block = block;
+    p->parts = (ir_len + block - 1) / block;
+    if (p->parts == 0) {
+        return 1;
+    }
+
+    size_t n = 2 * block;
+    p->plan = fft_new(n);
+    p->ir = (fft_complex *)calloc(p->parts * n, sizeof(fft_complex));
+    p->fdl = (fft_complex *)calloc(p->parts * n, sizeof(fft_complex));
+    p->history = (float *)calloc(block, sizeof(float));
+    p->scratch = (fft_complex *)calloc(n, sizeof(fft_complex));
+    p->acc = (fft_complex *)calloc(n, sizeof(fft_complex));
+    if (!p->plan || !p->ir || !p->fdl || !p->history || !p->scratch || !p->acc) {
+        return 0;
+    }
+
+    // Each partition is zero padded to 2 * block, and pre-scaled so
+    // the unscaled inverse FFT comes out right.
+    float scale = 1.0f / (float)n;
+    for (size_t i = 0; i < p->parts; i++) {
+        fft_complex *h = &p->ir[i * n];
+        for (size_t j = 0; j < block && i * block + j < ir_len; j++) {
+            h[j].re = ir[i * block + j] * scale;
+        }
+        fft_forward(p->plan, h);
+    }
+
+    return 1;
+}
+
+static void part_free(conv_part *p) {
+    fft_free(p->plan);
+    free(p->ir);
+    free(p->fdl);
+    free(p->history);
+    free(p->scratch);
+    free(p->acc);
+}
+
+// part_process convolves one block of _in_ and writes it to _out_.
+static void part_process(conv_part *p, const float *in, float *out) {
+    size_t block = p->block;
+    size_t n = 2 * block;
+
+    if (p->parts == 0) {
+        memset(out, 0, sizeof(float) * block);
+        return;
+    }
+
+    // The spectrum of the last two input blocks goes in the frequency
+    // domain delay line.
+    fft_complex *x = &p->fdl[p->fdl_pos * n];
+    for (size_t i = 0; i < block; i++) {
+        x[i].re = p->history[i];
+        x[i].im = 0;
+        x[block + i].re = in[i];
+        x[block + i].im = 0;
+    }
+    memcpy(p->history, in, sizeof(float) * block);
+    fft_forward(p->plan, x);
+
+    // Multiply each partition with the input block it lines up with.
+    memset(p->acc, 0, sizeof(fft_complex) * n);
+    size_t pos = p->fdl_pos;
+    for (size_t i = 0; i < p->parts; i++) {
+        const fft_complex *h = &p->ir[i * n];
+        const fft_complex *xi = &p->fdl[pos * n];
+        for (size_t k = 0; k < n; k++) {
+            p->acc[k].re += xi[k].re * h[k].re - xi[k].im * h[k].im;
+            p->acc[k].im += xi[k].re * h[k].im + xi[k].im * h[k].re;
+        }
+        pos = pos == 0 ? p->parts - 1 : pos - 1;
+    }
+    p->fdl_pos = p->fdl_pos + 1 == p->parts ? 0 : p->fdl_pos + 1;
+
+    // Overlap-save: the second half is the new output.
+    fft_inverse(p->plan, p->acc);
+    for (size_t i = 0; i < block; i++) {
+        out[i] = p->acc[block + i].re;
+    }
+}
+
+// part_skip feeds _p_ a block of silence without transforming it.
+static void part_skip(conv_part *p) {
+    size_t n = 2 * p->block;
+    memset(&p->fdl[p->fdl_pos * n], 0, sizeof(fft_complex) * n);
+    memset(p->history, 0, sizeof(float) * p->block);
+    p->fdl_pos = p->fdl_pos + 1 == p->parts ? 0 : p->fdl_pos + 1;
+}
+
+// tail_run runs job _job_: the periods dropped before it, then its
+// input.
+static void tail_run(conv *c, uint32_t job) {
+    for (uint32_t i = 0; i < c->job_skips && i < c->tail.parts; i++) {
+        part_skip(&c->tail);
+    }
+    part_process(&c->tail, c->tail_in, c->tail_out[job & 1]);
+}
+
+#if CONV_THREADS
+// The audio thread wakes the tail thread with a semaphore, which
+// never blocks the poster.
+static int wake_init(conv *c) {
+#if defined(__APPLE__)
+    c->wake = dispatch_semaphore_create(0);
+    return c->wake != NULL;
+#else
+    return sem_init(&c->wake, 0, 0) == 0;
+#endif
+}
+
+static void wake_destroy(conv *c) {
+#if defined(__APPLE__)
+    dispatch_release(c->wake);
+#else
+    sem_destroy(&c->wake);
+#endif
+}
+
+static void wake_post(conv *c) {
+#if defined(__APPLE__)
+    dispatch_semaphore_signal(c->wake);
+#else
+    sem_post(&c->wake);
+#endif
+}
+
+static void wake_wait(conv *c) {
+#if defined(__APPLE__)
+    dispatch_semaphore_wait(c->wake, DISPATCH_TIME_FOREVER);
+#else
+    while (sem_wait(&c->wake) != 0) {
+    }
+#endif
+}
+
+static void *tail_thread(void *arg) {
+    conv *c = (conv *)arg;
+
+    for (;;) {
+        wake_wait(c);
+        if (__atomic_load_n(&c->quit, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        uint32_t job = __atomic_load_n(&c->jobs, __ATOMIC_ACQUIRE);
+        if (job != c->done) {
+            tail_run(c, job);
+            __atomic_store_n(&c->done, job, __ATOMIC_RELEASE);
+        }
+    }
+
+    return NULL;
+}
+#endif
+
+// tail_post starts a job for the input just collected. If the last
+// job is still running, its buffers are busy: this period's input is
+// dropped and the tail goes quiet until a job is on time again.
+static void tail_post(conv *c) {
+#if CONV_THREADS
+    if (c->threaded && __atomic_load_n(&c->done, __ATOMIC_ACQUIRE) != c->jobs) {
+        c->late++;
+        c->skipped++;
+        c->tail_live = 0;
+        return;
+    }
+#endif
+
+    // The last job's output is only for this coming period if no
+    // period was dropped since it was posted.
+    c->tail_live = c->skipped == 0;
+    c->job_skips = c->skipped;
+    c->skipped = 0;
+
+    float *t = c->tail_in;
+    c->tail_in = c->tail_fill;
+    c->tail_fill = t;
+
+#if CONV_THREADS
+    if (c->threaded) {
+        __atomic_store_n(&c->jobs, c->jobs + 1, __ATOMIC_RELEASE);
+        wake_post(c);
+        return;
+    }
+#endif
+
+    c->jobs++;
+    tail_run(c, c->jobs);
+    c->done = c->jobs;
+}
+
+conv *conv_new(const float *ir, size_t ir_len, size_t tail_block, int threaded) {
+    if (tail_block < CONV_BLOCK || (tail_block & (tail_block - 1)) != 0) {
+        return NULL;
+    }
+
+    conv *c = (conv *)calloc(1, sizeof(conv));
+    if (c == NULL) {
+        return NULL;
+    }
+    c->tail_block = tail_block;
+    c->tail_live = 1;
+
+    size_t head_len = 2 * tail_block;
+    if (!part_init(&c->head, ir, ir_len < head_len ? ir_len : head_len, CONV_BLOCK)) {
+        conv_free(c);
+        return NULL;
+    }
+    if (ir_len <= head_len) {
+        return c;
+    }
+
+    if (!part_init(&c->tail, ir + head_len, ir_len - head_len, tail_block)) {
+        conv_free(c);
+        return NULL;
+    }
+
+    c->tail_fill = (float *)calloc(tail_block, sizeof(float));
+    c->tail_in = (float *)calloc(tail_block, sizeof(float));
+    c->tail_out[0] = (float *)calloc(tail_block, sizeof(float));
+    c->tail_out[1] = (float *)calloc(tail_block, sizeof(float));
+    if (!c->tail_fill || !c->tail_in || !c->tail_out[0] || !c->tail_out[1]) {
+        conv_free(c);
+        return NULL;
+    }
+
+#if CONV_THREADS
+    if (threaded && wake_init(c)) {
+        if (pthread_create(&c->thread, NULL, tail_thread, c) == 0) {
+            c->threaded = 1;
+        } else {
+            wake_destroy(c);
+        }
+    }
+#endif
+
+    return c;
+}
+
+void conv_free(conv *c) {
+    if (c == NULL) {
+        return;
+    }
+
+#if CONV_THREADS
+    if (c->threaded) {
+        __atomic_store_n(&c->quit, 1, __ATOMIC_RELEASE);
+        wake_post(c);
+        pthread_join(c->thread, NULL);
+        wake_destroy(c);
+    }
+#endif
+
+    part_free(&c->head);
+    part_free(&c->tail);
+    free(c->tail_fill);
+    free(c->tail_in);
+    free(c->tail_out[0]);
+    free(c->tail_out[1]);
+    free(c);
+}
+
+void conv_process(conv *c, const float *in, float *out) {
+    if (c->tail.parts != 0) {
+        memcpy(c->tail_fill + c->tail_pos, in, sizeof(float) * CONV_BLOCK);
+    }
+
+    part_process(&c->head, in, out);
+    if (c->tail.parts == 0) {
+        return;
+    }
+
+    // The tail job finished at the start of this period is in the
+    // buffer the current job isn't writing.
+    if (c->tail_live) {
+        const float *tail = c->tail_out[(c->jobs - 1) & 1] + c->tail_pos;
+        for (size_t i = 0; i < CONV_BLOCK; i++) {
+            out[i] += tail[i];
+        }
+    }
+
+    c->tail_pos += CONV_BLOCK;
+    if (c->tail_pos == c->tail_block) {
+        c->tail_pos = 0;
+        tail_post(c);
+    }
+}
+
+void conv_wait(conv *c) {
+#if CONV_THREADS
+    while (c->threaded && __atomic_load_n(&c->done, __ATOMIC_ACQUIRE) != c->jobs) {
+        sched_yield();
+    }
+#else
+    (void)c;
+#endif
+}
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,130 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef CONV_H
+#define CONV_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fft.h"
+
+// conv processes audio in blocks of CONV_BLOCK samples, one Teensy
+// audio block.
+#define CONV_BLOCK (128)
+
+// The tail runs on a background thread where there are pthreads (the
+// host and the plugin). Without them, conv_new's _threaded_ is
+// ignored and the tail is processed inline.
+#ifndef CONV_THREADS
+#if defined(__unix__) || defined(__APPLE__)
+#define CONV_THREADS (1)
+#else
+#define CONV_THREADS (0)
+#endif
+#endif
+
+#if CONV_THREADS
+#include <pthread.h>
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#endif
+#endif
+
+// conv_part is a uniformly partitioned overlap-save convolution of
+// one section of an impulse response, in blocks of _block_ samples.
+typedef struct _conv_part {
+    size_t block;
+    size_t parts;
+
+    fft *plan;
+
+    // ir holds the spectrum of each partition. fdl holds the spectra
+    // of the last _parts_ input blocks, newest at fdl_pos.
+    fft_complex *ir;
+    fft_complex *fdl;
+    size_t fdl_pos;
+
+    float *history;
+    fft_complex *scratch;
+    fft_complex *acc;
+} conv_part;
+
+// conv convolves a signal with a long impulse response (a Leslie
+// cabinet or a room) with no added latency.
+//
+// The first 2 * tail_block taps (the head) are convolved in
+// CONV_BLOCK partitions, inline with each block. The rest (the tail)
+// are convolved in tail_block partitions, once every tail_block
+// samples, on a background thread. The tail's output isn't needed
+// until tail_block samples after its input is complete, which gives
+// the thread a whole tail period to finish.
+//
+// conv_process never locks or waits for the thread. If a job isn't
+// finished when the next is due, that period is late: the tail hears
+// silence for its input and plays silence until it catches up.
+typedef struct _conv {
+    conv_part head;
+    conv_part tail;
+
+    size_t tail_block;
+    size_t tail_pos;
+
+    // tail_fill collects input for the next tail job; tail_in is the
+    // input of the job in progress. Job number _jobs_ writes
+    // tail_out[jobs & 1] while blocks read the other. Only the thread
+    // writes _done_, the number of jobs it has finished.
+    float *tail_fill;
+    float *tail_in;
+    float *tail_out[2];
+    uint32_t jobs;
+    volatile uint32_t done;
+
+    // skipped counts the tail periods dropped since the last job, and
+    // job_skips hands that count to the job. The tail plays only while
+    // tail_live.
+    uint32_t skipped;
+    uint32_t job_skips;
+    int tail_live;
+
+    // late counts tail jobs that weren't finished in time.
+    uint32_t late;
+
+    int threaded;
+#if CONV_THREADS
+    pthread_t thread;
+#if defined(__APPLE__)
+    dispatch_semaphore_t wake;
+#else
+    sem_t wake;
+#endif
+    volatile int quit;
+#endif
+} conv;
+
+// conv_new prepares to convolve with the _ir_len_ taps of _ir_.
+// _tail_block_ must be a power of two, at least CONV_BLOCK; larger
+// is cheaper for long tails but needs a longer head. It returns NULL
+// on bad arguments or allocation failure.
+conv *conv_new(const float *ir, size_t ir_len, size_t tail_block, int threaded);
+void conv_free(conv *c);
+
+// conv_process convolves one CONV_BLOCK block of _in_ into _out_,
+// which may be the same buffer.
+void conv_process(conv *c, const float *in, float *out);
+
+// conv_wait waits for the tail job in progress to finish. It's for
+// offline use, like tests, where blocks come faster than real time;
+// the audio thread must never call it.
+void conv_wait(conv *c);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,101 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef CONV_AUDIO_H
+#define CONV_AUDIO_H
+
+#include <Audio.h>
+
+#include "conv.h"
+
+// Convolution applies a measured impulse response, such as a Leslie
+// cabinet or a room, to one channel. Connect one after each of
+// leslieR and leslieL.
+//
+// It's meant for the host and plugin builds: a 2s room costs a few
+// percent of one desktop core (see roto.bench), far more than a
+// Teensy has. The tail of the response runs on a background thread
+// where pthreads are available.
+class Convolution : public AudioStream {
+  public:
+    Convolution() : AudioStream(1, inputQueueArray), c(NULL), incoming(NULL), retired(NULL) {
+    }
+
+    ~Convolution() {
+        conv_free(c);
+        conv_free(incoming);
+        conv_free(retired);
+    }
+
+    // load replaces the impulse response. It allocates, so call it
+    // from the main loop, never from update; it's safe while audio is
+    // running. The new response is handed to update, which switches to
+    // it at the start of a block and hands back the old one for the
+    // next load (or the destructor) to free. Longer tail blocks are
+    // cheaper for long responses.
+    bool load(const float *ir, size_t len, size_t tailBlock = 1024) {
+        conv *next = conv_new(ir, len, tailBlock, 1);
+        if (next == NULL) {
+            return false;
+        }
+        // A response update hasn't taken yet is replaced. Freeing the
+        // retired one afterward lets update take _next_ right away,
+        // even if it switched to the replaced one meanwhile.
+        conv_free(__atomic_exchange_n(&incoming, next, __ATOMIC_ACQ_REL));
+        conv_free(__atomic_exchange_n(&retired, (conv *)NULL, __ATOMIC_ACQ_REL));
+        return true;
+    }
+
+    void update(void) {
+        // Switch to a loaded response once the last one switched from
+        // has been freed.
+        if (__atomic_load_n(&retired, __ATOMIC_ACQUIRE) == NULL) {
+            conv *next = __atomic_exchange_n(&incoming, (conv *)NULL, __ATOMIC_ACQ_REL);
+            if (next != NULL) {
+                __atomic_store_n(&retired, c, __ATOMIC_RELEASE);
+                c = next;
+            }
+        }
+        if (c == NULL) {
+            return;
+        }
+
+        // A missing block is silence, but the tail still rings out.
+        audio_block_t *in = receiveReadOnly(0);
+        audio_block_t *out = allocate();
+        if (out == NULL) {
+            if (in) {
+                release(in);
+            }
+            return;
+        }
+
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+            buf[i] = in ? in->data[i] / 32768.0f : 0;
+        }
+        if (in) {
+            release(in);
+        }
+
+        conv_process(c, buf, buf);
+
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+            float v = buf[i] * 32768.0f;
+            out->data[i] = v > 32767 ? 32767 : (v < -32768 ? -32768 : (int16_t)v);
+        }
+
+        transmit(out, 0);
+        release(out);
+    }
+
+  private:
+    // c is only touched by update. incoming and retired pass
+    // responses between it and load.
+    conv *c;
+    conv *incoming;
+    conv *retired;
+    float buf[AUDIO_BLOCK_SAMPLES];
+
+    audio_block_t *inputQueueArray[1];
+};
+
+#endif
@@ -0,0 +1,106 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifdef ROTO_TEST
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "greatest.h"
+
+#include "conv.h"
+
+#define CONV_TEST_IR_LEN (3000)
+#define CONV_TEST_BLOCKS (48)
+#define CONV_TEST_LEN (CONV_TEST_BLOCKS * CONV_BLOCK)
+
+// conv_check compares conv against direct convolution, with a tail
+// block of 256 so both the head and the tail are exercised.
+static int conv_check(int threaded) {
+    static float ir[CONV_TEST_IR_LEN];
+    static float in[CONV_TEST_LEN];
+    static float got[CONV_TEST_LEN];
+
+    // A decaying noise IR, and noise in.
+    srand(1);
+    for (int i = 0; i < CONV_TEST_IR_LEN; i++) {
+        ir[i] = ((float)rand() / RAND_MAX - 0.5f) * expf(-i / 1000.0f);
+    }
+    for (int i = 0; i < CONV_TEST_LEN; i++) {
+        in[i] = (float)rand() / RAND_MAX - 0.5f;
+    }
+
+    conv *c = conv_new(ir, CONV_TEST_IR_LEN, 256, threaded);
+    if (c == NULL) {
+        return 0;
+    }
+    // In place. Blocks come faster than real time here, so give the
+    // tail its time.
+    memcpy(got, in, sizeof(in));
+    for (int b = 0; b < CONV_TEST_BLOCKS; b++) {
+        conv_wait(c);
+        conv_process(c, got + b * CONV_BLOCK, got + b * CONV_BLOCK);
+    }
+    int late = c->late;
+    conv_free(c);
+    if (late != 0) {
+        return 0;
+    }
+
+    for (int n = 0; n < CONV_TEST_LEN; n++) {
+        double want = 0;
+        for (int k = 0; k < CONV_TEST_IR_LEN && k <= n; k++) {
+            want += (double)ir[k] * in[n - k];
+        }
+        if (fabs(want - got[n]) > 1e-3) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+TEST test_conv_inline() {
+    ASSERTm("doesn't match direct convolution", conv_check(0));
+    PASS();
+}
+
+TEST test_conv_threaded() {
+    ASSERTm("doesn't match direct convolution", conv_check(1));
+    PASS();
+}
+
+// test_conv_short ensures an IR that fits in the head has no tail.
+TEST test_conv_short() {
+    float ir[3] = {1, 0.5, 0.25};
+    float in[CONV_BLOCK] = {0};
+    float out[CONV_BLOCK];
+    in[0] = 1;
+
+    conv *c = conv_new(ir, 3, 256, 1);
+    ASSERT_EQ(0, c->tail.parts);
+
+    conv_process(c, in, out);
+    ASSERT_IN_RANGE(1, out[0], 1e-6);
+    ASSERT_IN_RANGE(0.5, out[1], 1e-6);
+    ASSERT_IN_RANGE(0.25, out[2], 1e-6);
+    ASSERT_IN_RANGE(0, out[3], 1e-6);
+
+    conv_free(c);
+    PASS();
+}
+
+TEST test_conv_bad_tail_block() {
+    float ir[3] = {1, 0.5, 0.25};
+    ASSERT_EQ(NULL, conv_new(ir, 3, 64, 0));
+    ASSERT_EQ(NULL, conv_new(ir, 3, 384, 0));
+    PASS();
+}
+
+GREATEST_SUITE(conv_suite) {
+    RUN_TEST(test_conv_inline);
+    RUN_TEST(test_conv_threaded);
+    RUN_TEST(test_conv_short);
+    RUN_TEST(test_conv_bad_tail_block);
+}
+
+#endif
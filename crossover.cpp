@@ -0,0 +1,96 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include "crossover.h"
+#include "sample.h"
+
+#define CROSSOVER_STATE_BITS (12)
+#define CROSSOVER_COEF_BITS (29)
+
+// crossover_section runs the shared denominator: _num_ is a section's
+// numerator, already scaled by its gain, and _y1_ and _y2_ its last
+// two outputs.
+static inline int32_t crossover_section(int64_t num, int32_t a1, int32_t a2, int32_t y1, int32_t y2) {
+    int64_t acc = num - (int64_t)a1 * y1 - (int64_t)a2 * y2;
+    return (int32_t)((acc + (1 << (CROSSOVER_COEF_BITS - 1))) >> CROSSOVER_COEF_BITS);
+}
+
+void crossover_init(crossover_filter *c) {
+    memset(c, 0, sizeof(crossover_filter));
+    crossover_set(c, 800, 44100);
+}
+
+void crossover_set(crossover_filter *c, float hz, float sample_rate) {
+    // Bilinear Butterworth sections: the lowpass numerator is
+    // K^2 (1, 2, 1). The allpass is (a2, a1, 1) over the same poles.
+    double k = tan(M_PI * hz / sample_rate);
+    double norm = 1.0 / (1.0 + M_SQRT2 * k + k * k);
+    double one = (double)(1 << CROSSOVER_COEF_BITS);
+
+    c->lo_gain = (int32_t)(k * k * norm * one + 0.5);
+    c->a1 = (int32_t)lround(2.0 * (k * k - 1.0) * norm * one);
+    c->a2 = (int32_t)lround((1.0 - M_SQRT2 * k + k * k) * norm * one);
+}
+
+void crossover_clear(crossover_filter *c) {
+    c->x1 = 0;
+    c->x2 = 0;
+    memset(c->lo1, 0, sizeof(c->lo1));
+    memset(c->lo2, 0, sizeof(c->lo2));
+    memset(c->ap, 0, sizeof(c->ap));
+}
+
+void crossover_process(crossover_filter *c, const int16_t *in, int16_t *lo, int16_t *hi, size_t len) {
+    int64_t lo_gain = c->lo_gain;
+    int32_t a1 = c->a1;
+    int32_t a2 = c->a2;
+
+    int32_t x1 = c->x1, x2 = c->x2;
+    int32_t lo1_1 = c->lo1[0], lo1_2 = c->lo1[1];
+    int32_t lo2_1 = c->lo2[0], lo2_2 = c->lo2[1];
+    int32_t ap1 = c->ap[0], ap2 = c->ap[1];
+
+    for (size_t i = 0; i < len; i++) {
+        int32_t x = (int32_t)in[i] << CROSSOVER_STATE_BITS;
+
+        int32_t l1 = crossover_section(lo_gain * (x + 2 * x1 + x2), a1, a2, lo1_1, lo1_2);
+        int32_t l2 = crossover_section(lo_gain * (l1 + 2 * lo1_1 + lo1_2), a1, a2, lo2_1, lo2_2);
+
+        // The allpass, (a2 + a1 z^-1 + z^-2) / (1 + a1 z^-1 + a2 z^-2),
+        // with its two multiplies shared between the numerator and
+        // denominator.
+        int64_t acc = (int64_t)a2 * (x - ap2) + (int64_t)a1 * (x1 - ap1);
+        int32_t ap = (int32_t)((acc + (1 << (CROSSOVER_COEF_BITS - 1))) >> CROSSOVER_COEF_BITS) + x2;
+
+        x2 = x1;
+        x1 = x;
+        lo1_2 = lo1_1;
+        lo1_1 = l1;
+        lo2_2 = lo2_1;
+        lo2_1 = l2;
+        ap2 = ap1;
+        ap1 = ap;
+
+        lo[i] = sat16((l2 + (1 << (CROSSOVER_STATE_BITS - 1))) >> CROSSOVER_STATE_BITS);
+        hi[i] = sat16((ap - l2 + (1 << (CROSSOVER_STATE_BITS - 1))) >> CROSSOVER_STATE_BITS);
+    }
+
+    c->x1 = x1;
+    c->x2 = x2;
+    c->lo1[0] = lo1_1;
+    c->lo1[1] = lo1_2;
+    c->lo2[0] = lo2_1;
+    c->lo2[1] = lo2_2;
+    c->ap[0] = ap1;
+    c->ap[1] = ap2;
+}
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,55 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef CROSSOVER_H
+#define CROSSOVER_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// crossover_filter splits a signal into bass and treble for the
+// Leslie's drum and horn: a 4th order Linkwitz-Riley crossover, each
+// band two Butterworth biquads. The bands fall off at 24dB an octave
+// and sum to an allpass, so the cabinet's response stays flat across
+// the split.
+//
+// The biquads are fixed point (Q29 coefficients, 12 bits of state
+// below each sample). Only the bass runs its two lowpass sections: the
+// bands of a Linkwitz-Riley crossover sum to a second order allpass
+// over the same poles, so the treble is that allpass minus the bass.
+// That's 8 multiplies a sample instead of 12.
+typedef struct _crossover_filter {
+    // The Butterworth lowpass numerator gain and the shared
+    // denominator.
+    int32_t lo_gain;
+    int32_t a1, a2;
+
+    // Input history, and the last two outputs of the lowpass sections
+    // and the allpass.
+    int32_t x1, x2;
+    int32_t lo1[2], lo2[2];
+    int32_t ap[2];
+} crossover_filter;
+
+void crossover_init(crossover_filter *c);
+
+// crossover_set sets the crossover frequency. _hz_ must be below half
+// of _sample_rate_.
+void crossover_set(crossover_filter *c, float hz, float sample_rate);
+
+// crossover_clear silences the filter's history, keeping its
+// frequency.
+void crossover_clear(crossover_filter *c);
+
+// crossover_process splits _len_ samples of _in_ into _lo_ and _hi_
+// in one pass. _lo_ may be the same buffer as _in_.
+void crossover_process(crossover_filter *c, const int16_t *in, int16_t *lo, int16_t *hi, size_t len);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,60 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef CROSSOVER_AUDIO_H
+#define CROSSOVER_AUDIO_H
+
+#include <Audio.h>
+
+#include "crossover.h"
+
+// CrossoverCore holds the Leslie's crossover, without an AudioStream,
+// so the Leslie node can split its bands inline. frequency() is the
+// AudioFilterStateVariable control it replaced; a Linkwitz-Riley
+// crossover has no resonance to set.
+class CrossoverCore {
+  public:
+    CrossoverCore() {
+        crossover_init(&xover);
+    }
+
+    void frequency(float hz) {
+        crossover_set(&xover, hz, AUDIO_SAMPLE_RATE_EXACT);
+    }
+
+    crossover_filter xover;
+};
+
+// Crossover splits the Leslie's signal for its rotors: output 0 is the
+// bass, for the drums, and 1 the treble, for the horns.
+class Crossover : public AudioStream, public CrossoverCore {
+  public:
+    Crossover() : AudioStream(1, inputQueueArray) {
+    }
+
+    void update(void) {
+        // Crossover is the preamp's only consumer, so the bass is
+        // written over its block.
+        audio_block_t *block = receiveWritable(0);
+        if (block == NULL) {
+            return;
+        }
+
+        audio_block_t *hi = allocate();
+        if (hi == NULL) {
+            release(block);
+            return;
+        }
+
+        crossover_process(&xover, block->data, block->data, hi->data, AUDIO_BLOCK_SAMPLES);
+
+        transmit(block, 0);
+        release(block);
+        transmit(hi, 1);
+        release(hi);
+    }
+
+  private:
+    audio_block_t *inputQueueArray[1];
+};
+
+#endif
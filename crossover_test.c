@@ -0,0 +1,100 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifdef ROTO_TEST
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "greatest.h"
+
+#include "crossover.h"
+
+// crossover_peaks runs a sine at _hz_ through a fresh 800Hz crossover
+// and returns the peak of each band, and of their sum, once it has
+// settled.
+static void crossover_peaks(float hz, int *lo_peak, int *hi_peak, int *sum_peak) {
+    crossover_filter c;
+    crossover_init(&c);
+    crossover_set(&c, 800, 44100);
+
+    int16_t in[128], lo[128], hi[128];
+    *lo_peak = 0;
+    *hi_peak = 0;
+    *sum_peak = 0;
+    for (int b = 0; b < 40; b++) {
+        for (int i = 0; i < 128; i++) {
+            in[i] = (int16_t)(16000 * sinf(2 * (float)M_PI * hz * (b * 128 + i) / 44100));
+        }
+        crossover_process(&c, in, lo, hi, 128);
+        if (b < 20) {
+            continue;
+        }
+        for (int i = 0; i < 128; i++) {
+            int sum = abs(lo[i] + hi[i]);
+            *lo_peak = abs(lo[i]) > *lo_peak ? abs(lo[i]) : *lo_peak;
+            *hi_peak = abs(hi[i]) > *hi_peak ? abs(hi[i]) : *hi_peak;
+            *sum_peak = sum > *sum_peak ? sum : *sum_peak;
+        }
+    }
+}
+
+TEST test_crossover_dc() {
+    crossover_filter c;
+    crossover_init(&c);
+
+    int16_t in[128], lo[128], hi[128];
+    for (int i = 0; i < 128; i++) {
+        in[i] = 10000;
+    }
+    for (int b = 0; b < 20; b++) {
+        crossover_process(&c, in, lo, hi, 128);
+    }
+    for (int i = 0; i < 128; i++) {
+        ASSERT_IN_RANGE(10000, lo[i], 2);
+        ASSERT_IN_RANGE(0, hi[i], 2);
+    }
+
+    PASS();
+}
+
+// test_crossover_bands ensures bass goes to the drum and treble to the
+// horn, each down 48dB two octaves past the crossover.
+TEST test_crossover_bands() {
+    int lo, hi, sum;
+
+    crossover_peaks(200, &lo, &hi, &sum);
+    ASSERT_IN_RANGE(16000, lo, 160);
+    ASSERTm("bass in the treble", hi < 16000 / 200);
+
+    crossover_peaks(3200, &lo, &hi, &sum);
+    ASSERT_IN_RANGE(16000, hi, 160);
+    ASSERTm("treble in the bass", lo < 16000 / 200);
+
+    // Both are 6dB down at the crossover.
+    crossover_peaks(800, &lo, &hi, &sum);
+    ASSERT_IN_RANGE(8000, lo, 160);
+    ASSERT_IN_RANGE(8000, hi, 160);
+
+    PASS();
+}
+
+// test_crossover_flat ensures the bands sum back to the input's level
+// at every frequency: the crossover is an allpass.
+TEST test_crossover_flat() {
+    for (float hz = 50; hz < 16000; hz *= 1.5) {
+        int lo, hi, sum;
+        crossover_peaks(hz, &lo, &hi, &sum);
+        ASSERT_IN_RANGE(16000, sum, 80);
+    }
+
+    PASS();
+}
+
+GREATEST_SUITE(crossover_suite) {
+    RUN_TEST(test_crossover_dc);
+    RUN_TEST(test_crossover_bands);
+    RUN_TEST(test_crossover_flat);
+}
+
+#endif
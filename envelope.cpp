@@ -0,0 +1,122 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "envelope.h"
+
+#define ENVELOPE_MAX (1 << 30)
+
+void envelope_init(envelope *e, float sample_rate) {
+    memset(e, 0, sizeof(envelope));
+    envelope_set(e,
+                 envelope_samples(0, sample_rate),
+                 envelope_samples(10.5, sample_rate),
+                 envelope_samples(2.5, sample_rate),
+                 envelope_samples(35, sample_rate),
+                 0.5,
+                 envelope_samples(300, sample_rate));
+}
+
+uint32_t envelope_samples(float ms, float sample_rate) {
+    if (ms <= 0) {
+        return 0;
+    }
+    return (uint32_t)(ms * sample_rate / 1000.0f + 0.5f);
+}
+
+void envelope_set(envelope *e, uint32_t delay, uint32_t attack, uint32_t hold, uint32_t decay, float sustain, uint32_t release) {
+    if (sustain < 0) {
+        sustain = 0;
+    } else if (sustain > 1) {
+        sustain = 1;
+    }
+
+    e->delay = delay;
+    e->attack = attack;
+    e->hold = hold;
+    e->decay = decay;
+    e->sustain = (int32_t)(sustain * ENVELOPE_MAX);
+    e->release = release;
+}
+
+void envelope_note_on(envelope *e) {
+    e->gate = 1;
+    e->ons++;
+}
+
+void envelope_note_off(envelope *e) {
+    e->gate = 0;
+}
+
+// envelope_ramp starts a segment of _len_ samples toward _target_.
+static void envelope_ramp(envelope *e, uint8_t stage, uint32_t len, int32_t target) {
+    e->stage = stage;
+    e->count = len;
+    e->incr = len == 0 ? 0 : (target - e->level) / (int32_t)len;
+}
+
+// envelope_next moves to the segment after the current one ends.
+static void envelope_next(envelope *e) {
+    switch (e->stage) {
+    case ENVELOPE_DELAY:
+        envelope_ramp(e, ENVELOPE_ATTACK, e->attack, ENVELOPE_MAX);
+        break;
+    case ENVELOPE_ATTACK:
+        e->level = ENVELOPE_MAX;
+        envelope_ramp(e, ENVELOPE_HOLD, e->hold, ENVELOPE_MAX);
+        break;
+    case ENVELOPE_HOLD:
+        envelope_ramp(e, ENVELOPE_DECAY, e->decay, e->sustain);
+        break;
+    case ENVELOPE_DECAY:
+        e->level = e->sustain;
+        e->stage = ENVELOPE_SUSTAIN;
+        e->incr = 0;
+        break;
+    case ENVELOPE_RELEASE:
+        e->level = 0;
+        e->stage = ENVELOPE_IDLE;
+        e->incr = 0;
+        break;
+    }
+}
+
+void envelope_process(envelope *e, int16_t *block, size_t len) {
+    uint8_t ons = e->ons;
+    if (ons != e->ons_taken) {
+        e->ons_taken = ons;
+        envelope_ramp(e, ENVELOPE_DELAY, e->delay, e->level);
+    }
+    if (!e->gate && e->stage != ENVELOPE_IDLE && e->stage != ENVELOPE_RELEASE) {
+        envelope_ramp(e, ENVELOPE_RELEASE, e->release, 0);
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        // Zero length segments end before their first sample.
+        while (e->count == 0 && e->stage != ENVELOPE_IDLE && e->stage != ENVELOPE_SUSTAIN) {
+            envelope_next(e);
+        }
+
+        block[i] = (block[i] * (e->level >> 15)) >> 15;
+
+        if (e->count > 0) {
+            e->level += e->incr;
+            e->count--;
+        }
+    }
+}
+
+int envelope_resting(const envelope *e) {
+    if (e->ons != e->ons_taken) {
+        return 0;
+    }
+    return e->stage == ENVELOPE_IDLE || (e->stage == ENVELOPE_SUSTAIN && e->gate);
+}
+
+#if defined(__cplusplus)
+}
+#endif
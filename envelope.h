@@ -0,0 +1,71 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum envelope_stage {
+    ENVELOPE_IDLE = 0,
+    ENVELOPE_DELAY,
+    ENVELOPE_ATTACK,
+    ENVELOPE_HOLD,
+    ENVELOPE_DECAY,
+    ENVELOPE_SUSTAIN,
+    ENVELOPE_RELEASE,
+};
+
+// envelope is a linear DAHDSR envelope like the Teensy library's
+// AudioEffectEnvelope, for the organ's percussion. Each segment is a
+// straight line in Q30, stepped every sample.
+//
+// envelope_note_on and envelope_note_off only post requests;
+// envelope_process takes them at the start of its next block, so they
+// can be called from outside the audio interrupt.
+typedef struct _envelope {
+    // Segment lengths in samples, and the sustain level (Q30).
+    uint32_t delay, attack, hold, decay, release;
+    int32_t sustain;
+
+    uint8_t stage;
+    uint32_t count;
+    int32_t level;
+    int32_t incr;
+
+    // Each note on bumps ons; gate is nonzero while the note is held.
+    volatile uint8_t ons;
+    volatile uint8_t gate;
+    uint8_t ons_taken;
+} envelope;
+
+// envelope_init sets up an idle envelope with the Teensy's defaults.
+void envelope_init(envelope *e, float sample_rate);
+
+// envelope_samples converts _ms_ to a segment length for
+// envelope_set.
+uint32_t envelope_samples(float ms, float sample_rate);
+
+// envelope_set sets every segment at once; _sustain_ is 0..1.
+void envelope_set(envelope *e, uint32_t delay, uint32_t attack, uint32_t hold, uint32_t decay, float sustain, uint32_t release);
+
+void envelope_note_on(envelope *e);
+void envelope_note_off(envelope *e);
+
+// envelope_process scales _len_ samples of _block_ in place.
+void envelope_process(envelope *e, int16_t *block, size_t len);
+
+// envelope_resting returns nonzero if envelope_process would hold the
+// level where it is: the envelope is idle, or sustaining with its note
+// held, and no note on is waiting. A resting envelope may skip blocks.
+int envelope_resting(const envelope *e);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
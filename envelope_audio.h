@@ -0,0 +1,80 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef ENVELOPE_AUDIO_H
+#define ENVELOPE_AUDIO_H
+
+#include <Audio.h>
+
+#include "envelope.h"
+
+// EnvelopeCore holds a DAHDSR envelope with the controls of the
+// Teensy library's AudioEffectEnvelope, without an AudioStream, so
+// the Organ node can shape its percussion.
+class EnvelopeCore {
+  public:
+    EnvelopeCore() {
+        envelope_init(&env, AUDIO_SAMPLE_RATE_EXACT);
+        delayMs = 0;
+        attackMs = 10.5;
+        holdMs = 2.5;
+        decayMs = 35;
+        sustainLevel = 0.5;
+        releaseMs = 300;
+    }
+
+    void delay(float ms) {
+        delayMs = ms;
+        set();
+    }
+
+    void attack(float ms) {
+        attackMs = ms;
+        set();
+    }
+
+    void hold(float ms) {
+        holdMs = ms;
+        set();
+    }
+
+    void decay(float ms) {
+        decayMs = ms;
+        set();
+    }
+
+    void sustain(float level) {
+        sustainLevel = level;
+        set();
+    }
+
+    void release(float ms) {
+        releaseMs = ms;
+        set();
+    }
+
+    void noteOn() {
+        envelope_note_on(&env);
+    }
+
+    void noteOff() {
+        envelope_note_off(&env);
+    }
+
+    envelope env;
+
+  private:
+    void set() {
+        float sr = AUDIO_SAMPLE_RATE_EXACT;
+        envelope_set(&env,
+                     envelope_samples(delayMs, sr),
+                     envelope_samples(attackMs, sr),
+                     envelope_samples(holdMs, sr),
+                     envelope_samples(decayMs, sr),
+                     sustainLevel,
+                     envelope_samples(releaseMs, sr));
+    }
+
+    float delayMs, attackMs, holdMs, decayMs, sustainLevel, releaseMs;
+};
+
+#endif
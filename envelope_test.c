@@ -0,0 +1,128 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifdef ROTO_TEST
+
+#include <string.h>
+
+#include "greatest.h"
+
+#include "envelope.h"
+
+static void envelope_ones(int16_t *block, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        block[i] = 32767;
+    }
+}
+
+TEST test_envelope_idle() {
+    envelope e;
+    envelope_init(&e, 44100);
+
+    int16_t block[128];
+    envelope_ones(block, 128);
+    envelope_process(&e, block, 128);
+    for (int i = 0; i < 128; i++) {
+        ASSERT_EQ_FMT(0, block[i], "%d");
+    }
+
+    PASS();
+}
+
+// test_envelope_segments walks through attack, hold, decay, sustain
+// and release with short segments.
+TEST test_envelope_segments() {
+    envelope e;
+    envelope_init(&e, 44100);
+    envelope_set(&e, 0, 4, 8, 100, 0.5, 50);
+
+    int16_t block[128];
+    envelope_note_on(&e);
+    envelope_ones(block, 128);
+    envelope_process(&e, block, 128);
+
+    // Attack from silence, then hold at full scale.
+    ASSERT_EQ_FMT(0, block[0], "%d");
+    ASSERT_IN_RANGE(16383, block[2], 2);
+    for (int i = 4; i < 12; i++) {
+        ASSERT_IN_RANGE(32767, block[i], 1);
+    }
+
+    // Decay halfway to sustain, then sustain.
+    ASSERT_IN_RANGE(24575, block[62], 2);
+    for (int i = 112; i < 128; i++) {
+        ASSERT_IN_RANGE(16383, block[i], 1);
+    }
+
+    // Release to silence.
+    envelope_note_off(&e);
+    envelope_ones(block, 128);
+    envelope_process(&e, block, 128);
+    ASSERT_IN_RANGE(16383, block[0], 1);
+    ASSERT_IN_RANGE(8191, block[25], 2);
+    for (int i = 50; i < 128; i++) {
+        ASSERT_EQ_FMT(0, block[i], "%d");
+    }
+    ASSERT_EQ_FMT(ENVELOPE_IDLE, e.stage, "%d");
+
+    PASS();
+}
+
+// test_envelope_percussion ensures a decay with no sustain fades out
+// and stays out while the note is held, as roto's percussion does.
+TEST test_envelope_percussion() {
+    envelope e;
+    envelope_init(&e, 44100);
+    envelope_set(&e, 0, 0, 0, 200, 0, 0);
+
+    int16_t block[128];
+    envelope_note_on(&e);
+    envelope_ones(block, 128);
+    envelope_process(&e, block, 128);
+    ASSERT_IN_RANGE(32767, block[0], 1);
+    ASSERT_IN_RANGE(16383, block[100], 2);
+
+    envelope_ones(block, 128);
+    envelope_process(&e, block, 128);
+    for (int i = 72; i < 128; i++) {
+        ASSERT_EQ_FMT(0, block[i], "%d");
+    }
+
+    // A second note on retriggers it.
+    envelope_note_on(&e);
+    envelope_ones(block, 128);
+    envelope_process(&e, block, 128);
+    ASSERT_IN_RANGE(32767, block[0], 1);
+
+    PASS();
+}
+
+// test_envelope_resting ensures an envelope is only at rest when its
+// level can't change until the next note on.
+TEST test_envelope_resting() {
+    envelope e;
+    envelope_init(&e, 44100);
+    envelope_set(&e, 0, 0, 0, 100, 0.5, 50);
+    ASSERT(envelope_resting(&e));
+
+    int16_t block[128];
+    envelope_note_on(&e);
+    ASSERT_FALSE(envelope_resting(&e));
+    envelope_process(&e, block, 128);
+    ASSERT(envelope_resting(&e));
+
+    envelope_note_off(&e);
+    ASSERT_FALSE(envelope_resting(&e));
+    envelope_process(&e, block, 128);
+    ASSERT(envelope_resting(&e));
+
+    PASS();
+}
+
+GREATEST_SUITE(envelope_suite) {
+    RUN_TEST(test_envelope_idle);
+    RUN_TEST(test_envelope_segments);
+    RUN_TEST(test_envelope_percussion);
+    RUN_TEST(test_envelope_resting);
+}
+
+#endif
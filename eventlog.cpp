@@ -0,0 +1,46 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "eventlog.h"
+
+void eventlog_init(eventlog *log) {
+    memset(log, 0, sizeof(eventlog));
+}
+
+int eventlog_pop(eventlog *log, eventlog_entry *e) {
+    uint32_t tail = log->tail;
+    if (tail == log->head) {
+        return 0;
+    }
+
+    __sync_synchronize();
+    *e = log->entries[tail & (EVENTLOG_LEN - 1)];
+    __sync_synchronize();
+
+    log->tail = tail + 1;
+    return 1;
+}
+
+int eventlog_format(const eventlog_entry *e, char *buf, size_t buf_len) {
+    unsigned long t = (unsigned long)e->time;
+
+    switch (e->type) {
+    case EVENT_NOTE_ON:
+        return snprintf(buf, buf_len, "%lu Note on: ch=%d note=%d vel=%d", t, e->chan, e->a, e->b);
+    case EVENT_NOTE_OFF:
+        return snprintf(buf, buf_len, "%lu Note off: ch=%d note=%d vel=%d", t, e->chan, e->a, e->b);
+    case EVENT_CONTROL_CHANGE:
+        return snprintf(buf, buf_len, "%lu Control Change, ch=%d, control=%d, value=%d", t, e->chan, e->a, e->b);
+    }
+    return snprintf(buf, buf_len, "%lu Unknown event %d: ch=%d %d %d", t, e->type, e->chan, e->a, e->b);
+}
+
+#if defined(__cplusplus)
+}
+#endif
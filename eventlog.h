@@ -0,0 +1,95 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The event log holds EVENTLOG_LEN entries. This must be a power of
+// two.
+#ifndef EVENTLOG_LEN
+#define EVENTLOG_LEN (64)
+#endif
+
+// Log levels. Events above EVENTLOG_LEVEL are compiled out entirely.
+#define EVENTLOG_OFF (0)
+#define EVENTLOG_INFO (1)
+#define EVENTLOG_DEBUG (2)
+
+#ifndef EVENTLOG_LEVEL
+#define EVENTLOG_LEVEL EVENTLOG_INFO
+#endif
+
+enum eventlog_type {
+    EVENT_NOTE_ON = 1,
+    EVENT_NOTE_OFF,
+    EVENT_CONTROL_CHANGE,
+};
+
+// eventlog_entry is a binary record of one event. It's formatted
+// later, when the log is drained.
+typedef struct _eventlog_entry {
+    uint32_t time;
+    uint8_t type;
+    uint8_t chan;
+    uint8_t a;
+    uint8_t b;
+} eventlog_entry;
+
+// eventlog is a single producer, single consumer ring of events. The
+// producer never waits: when the ring is full, new events are
+// dropped and counted.
+typedef struct _eventlog {
+    volatile uint32_t head; // next entry to write; producer only
+    volatile uint32_t tail; // next entry to read; consumer only
+    volatile uint32_t dropped;
+    eventlog_entry entries[EVENTLOG_LEN];
+} eventlog;
+
+void eventlog_init(eventlog *log);
+
+// eventlog_push appends an event. It returns 0 if the log was full.
+static inline int eventlog_push(eventlog *log, uint32_t time, uint8_t type, uint8_t chan, uint8_t a, uint8_t b) {
+    uint32_t head = log->head;
+    if (head - log->tail >= EVENTLOG_LEN) {
+        log->dropped++;
+        return 0;
+    }
+
+    eventlog_entry *e = &log->entries[head & (EVENTLOG_LEN - 1)];
+    e->time = time;
+    e->type = type;
+    e->chan = chan;
+    e->a = a;
+    e->b = b;
+
+    __sync_synchronize();
+    log->head = head + 1;
+    return 1;
+}
+
+// EVENTLOG appends an event if level is enabled at compile time.
+#define EVENTLOG(level, log, time, type, chan, a, b)                \
+    do {                                                            \
+        if ((level) <= EVENTLOG_LEVEL) {                            \
+            eventlog_push((log), (time), (type), (chan), (a), (b)); \
+        }                                                           \
+    } while (0)
+
+// eventlog_pop removes the oldest event into e. It returns 0 if the
+// log was empty.
+int eventlog_pop(eventlog *log, eventlog_entry *e);
+
+// eventlog_format writes a human readable line for e to buf.
+int eventlog_format(const eventlog_entry *e, char *buf, size_t buf_len);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifdef ROTO_TEST
+
+#include "greatest.h"
+
+#include "eventlog.h"
+
+TEST test_eventlog_push_pop() {
+    static eventlog log;
+    eventlog_init(&log);
+
+    eventlog_entry e;
+    ASSERT_EQ(0, eventlog_pop(&log, &e));
+
+    ASSERT_EQ(1, eventlog_push(&log, 10, EVENT_NOTE_ON, 1, 60, 127));
+    ASSERT_EQ(1, eventlog_push(&log, 20, EVENT_NOTE_OFF, 1, 60, 0));
+
+    ASSERT_EQ(1, eventlog_pop(&log, &e));
+    ASSERT_EQ_FMT(10, e.time, "%d");
+    ASSERT_EQ_FMT(EVENT_NOTE_ON, e.type, "%d");
+    ASSERT_EQ_FMT(60, e.a, "%d");
+    ASSERT_EQ_FMT(127, e.b, "%d");
+
+    ASSERT_EQ(1, eventlog_pop(&log, &e));
+    ASSERT_EQ_FMT(20, e.time, "%d");
+    ASSERT_EQ_FMT(EVENT_NOTE_OFF, e.type, "%d");
+
+    ASSERT_EQ(0, eventlog_pop(&log, &e));
+    ASSERT_EQ_FMT(0, log.dropped, "%d");
+
+    PASS();
+}
+
+// test_eventlog_dropped ensures a full log drops new events rather
+// than overwriting old ones, and counts the drops.
+TEST test_eventlog_dropped() {
+    static eventlog log;
+    eventlog_init(&log);
+
+    for (int i = 0; i < EVENTLOG_LEN + 5; i++) {
+        eventlog_push(&log, i, EVENT_CONTROL_CHANGE, 1, 70, i);
+    }
+    ASSERT_EQ_FMT(5, log.dropped, "%d");
+
+    eventlog_entry e;
+    for (int i = 0; i < EVENTLOG_LEN; i++) {
+        ASSERT_EQ(1, eventlog_pop(&log, &e));
+        ASSERT_EQ_FMT(i, e.time, "%d");
+    }
+    ASSERT_EQ(0, eventlog_pop(&log, &e));
+
+    // Room again after draining.
+    ASSERT_EQ(1, eventlog_push(&log, 0, EVENT_NOTE_ON, 1, 60, 127));
+
+    PASS();
+}
+
+TEST test_eventlog_level() {
+    static eventlog log;
+    eventlog_init(&log);
+
+    EVENTLOG(EVENTLOG_INFO, &log, 0, EVENT_NOTE_ON, 1, 60, 127);
+    EVENTLOG(EVENTLOG_LEVEL + 1, &log, 0, EVENT_NOTE_ON, 1, 61, 127);
+
+    eventlog_entry e;
+    ASSERT_EQ(1, eventlog_pop(&log, &e));
+    ASSERT_EQ_FMT(60, e.a, "%d");
+    ASSERT_EQ(0, eventlog_pop(&log, &e));
+
+    PASS();
+}
+
+TEST test_eventlog_format() {
+    eventlog_entry e = {1234, EVENT_CONTROL_CHANGE, 1, 70, 127};
+
+    char buf[64];
+    eventlog_format(&e, buf, sizeof(buf));
+    ASSERT_STR_EQ("1234 Control Change, ch=1, control=70, value=127", buf);
+
+    PASS();
+}
+
+GREATEST_SUITE(eventlog_suite) {
+    RUN_TEST(test_eventlog_push_pop);
+    RUN_TEST(test_eventlog_dropped);
+    RUN_TEST(test_eventlog_level);
+    RUN_TEST(test_eventlog_format);
+}
+
+#endif
@@ -0,0 +1,109 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "fft.h"
+
+fft *fft_new(size_t n) {
+    if (n < 2 || (n & (n - 1)) != 0) {
+        return NULL;
+    }
+
+    fft *f = (fft *)calloc(1, sizeof(fft));
+    if (f == NULL) {
+        return NULL;
+    }
+
+    f->n = n;
+    f->twiddles = (fft_complex *)malloc(sizeof(fft_complex) * (n / 2));
+    f->bitrev = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    if (f->twiddles == NULL || f->bitrev == NULL) {
+        fft_free(f);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < n / 2; i++) {
+        double angle = -2.0 * M_PI * (double)i / (double)n;
+        f->twiddles[i].re = (float)cos(angle);
+        f->twiddles[i].im = (float)sin(angle);
+    }
+
+    int bits = 0;
+    while (((size_t)1 << bits) < n) {
+        bits++;
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint32_t r = 0;
+        for (int b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        f->bitrev[i] = r;
+    }
+
+    return f;
+}
+
+void fft_free(fft *f) {
+    if (f == NULL) {
+        return;
+    }
+    free(f->twiddles);
+    free(f->bitrev);
+    free(f);
+}
+
+// fft_run is an iterative decimation in time FFT. The inverse uses
+// conjugated twiddles.
+static void fft_run(fft *f, fft_complex *x, int inverse) {
+    size_t n = f->n;
+
+    for (size_t i = 0; i < n; i++) {
+        size_t j = f->bitrev[i];
+        if (j > i) {
+            fft_complex t = x[i];
+            x[i] = x[j];
+            x[j] = t;
+        }
+    }
+
+    for (size_t len = 2; len <= n; len <<= 1) {
+        size_t half = len >> 1;
+        size_t step = n / len;
+
+        for (size_t start = 0; start < n; start += len) {
+            for (size_t k = 0; k < half; k++) {
+                fft_complex w = f->twiddles[k * step];
+                if (inverse) {
+                    w.im = -w.im;
+                }
+
+                fft_complex *a = &x[start + k];
+                fft_complex *b = &x[start + k + half];
+                float re = b->re * w.re - b->im * w.im;
+                float im = b->re * w.im + b->im * w.re;
+
+                b->re = a->re - re;
+                b->im = a->im - im;
+                a->re += re;
+                a->im += im;
+            }
+        }
+    }
+}
+
+void fft_forward(fft *f, fft_complex *x) {
+    fft_run(f, x, 0);
+}
+
+void fft_inverse(fft *f, fft_complex *x) {
+    fft_run(f, x, 1);
+}
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,41 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef FFT_H
+#define FFT_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct _fft_complex {
+    float re;
+    float im;
+} fft_complex;
+
+// fft is a plan for in-place radix-2 complex FFTs of one size. It's
+// small and self contained, for the host side convolution.
+typedef struct _fft {
+    size_t n;
+    fft_complex *twiddles;
+    uint32_t *bitrev;
+} fft;
+
+// fft_new plans FFTs of size _n_, which must be a power of two. It
+// returns NULL if _n_ isn't or allocation fails.
+fft *fft_new(size_t n);
+void fft_free(fft *f);
+
+// fft_forward transforms _x_ in place.
+void fft_forward(fft *f, fft_complex *x);
+
+// fft_inverse transforms _x_ in place, without the 1/n scale.
+void fft_inverse(fft *f, fft_complex *x);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifdef ROTO_TEST
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "greatest.h"
+
+#include "fft.h"
+
+TEST test_fft_impulse() {
+    fft *f = fft_new(16);
+    fft_complex x[16] = {{0}};
+    x[1].re = 1;
+
+    // A delayed impulse is a unit magnitude spiral.
+    fft_forward(f, x);
+    for (int k = 0; k < 16; k++) {
+        ASSERT_IN_RANGE(cos(-2 * M_PI * k / 16), x[k].re, 1e-6);
+        ASSERT_IN_RANGE(sin(-2 * M_PI * k / 16), x[k].im, 1e-6);
+    }
+
+    fft_free(f);
+    PASS();
+}
+
+TEST test_fft_round_trip() {
+    fft *f = fft_new(256);
+    fft_complex x[256], want[256];
+    for (int i = 0; i < 256; i++) {
+        want[i].re = (float)((i * 37) % 101) - 50;
+        want[i].im = (float)((i * 11) % 7) - 3;
+        x[i] = want[i];
+    }
+
+    fft_forward(f, x);
+    fft_inverse(f, x);
+    for (int i = 0; i < 256; i++) {
+        ASSERT_IN_RANGE(want[i].re, x[i].re / 256, 1e-4);
+        ASSERT_IN_RANGE(want[i].im, x[i].im / 256, 1e-4);
+    }
+
+    fft_free(f);
+    PASS();
+}
+
+TEST test_fft_sizes() {
+    ASSERT_EQ(NULL, fft_new(0));
+    ASSERT_EQ(NULL, fft_new(1));
+    ASSERT_EQ(NULL, fft_new(96));
+    PASS();
+}
+
+GREATEST_SUITE(fft_suite) {
+    RUN_TEST(test_fft_impulse);
+    RUN_TEST(test_fft_round_trip);
+    RUN_TEST(test_fft_sizes);
+}
+
+#endif
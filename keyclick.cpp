@@ -0,0 +1,136 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "keyclick.h"
+
+void keyclick_init(keyclick *kc, uint32_t spread, uint32_t bounce) {
+    memset(kc, 0, sizeof(keyclick));
+    kc->spread = spread;
+    kc->bounce = bounce;
+    kc->seed = 1;
+}
+
+// contact_delay is a contact's fixed offset from its key: it depends
+// only on where the contact sits on the busbar, so a key clicks the
+// same way every time it's played.
+static uint32_t contact_delay(keyclick *kc, int key, int drawbar) {
+    if (kc->spread == 0) {
+        return 0;
+    }
+
+    uint32_t h = (uint32_t)(key * 16 + drawbar) * 2654435761u;
+    return (h >> 16) % kc->spread;
+}
+
+// bounce_len is how long a closing contact bounces open, different on
+// every press.
+static uint32_t bounce_len(keyclick *kc) {
+    if (kc->bounce == 0) {
+        return 0;
+    }
+
+    kc->seed = kc->seed * 1664525u + 1013904223u;
+    return (kc->seed >> 16) % (kc->bounce + 1);
+}
+
+static void cancel(keyclick *kc, manual *m, int key) {
+    size_t j = 0;
+    for (size_t i = 0; i < kc->num_pending; i++) {
+        if (kc->pending[i].m != m || kc->pending[i].key != key) {
+            kc->pending[j++] = kc->pending[i];
+        }
+    }
+    kc->num_pending = j;
+}
+
+static void push(keyclick *kc, manual *m, int key, int drawbar, int closed, uint32_t time) {
+    keyclick_contact *c = &kc->pending[kc->num_pending++];
+    c->time = time;
+    c->m = m;
+    c->key = key;
+    c->drawbar = drawbar;
+    c->closed = closed;
+}
+
+void keyclick_key_down(keyclick *kc, manual *m, int key, uint32_t now) {
+    if (key < 1 || key > m->num_keys) {
+        return;
+    }
+
+    cancel(kc, m, key);
+    if (kc->num_pending + 3 * m->num_drawbars > KEYCLICK_PENDING) {
+        manual_key_down(m, key);
+        return;
+    }
+
+    m->keys[key] = 1;
+    for (int d = 1; d <= m->num_drawbars; d++) {
+        uint32_t t = now + contact_delay(kc, key, d);
+        uint32_t b = bounce_len(kc);
+
+        push(kc, m, key, d, 1, t);
+        if (b > 0) {
+            push(kc, m, key, d, 0, t + b);
+            push(kc, m, key, d, 1, t + 2 * b);
+        }
+    }
+}
+
+void keyclick_key_up(keyclick *kc, manual *m, int key, uint32_t now) {
+    if (key < 1 || key > m->num_keys) {
+        return;
+    }
+
+    cancel(kc, m, key);
+    if (kc->num_pending + m->num_drawbars > KEYCLICK_PENDING) {
+        manual_key_up(m, key);
+        return;
+    }
+
+    m->keys[key] = 0;
+    for (int d = 1; d <= m->num_drawbars; d++) {
+        push(kc, m, key, d, 0, now + contact_delay(kc, key, d));
+    }
+}
+
+size_t keyclick_run(keyclick *kc, uint32_t until, size_t max, keyclick_emit_fn emit, void *ctx) {
+    size_t n = 0;
+
+    while (n < max && kc->num_pending > 0) {
+        // Few contacts are ever pending, so a linear search for the
+        // earliest is fine.
+        size_t first = 0;
+        for (size_t i = 1; i < kc->num_pending; i++) {
+            if ((int32_t)(kc->pending[i].time - kc->pending[first].time) < 0) {
+                first = i;
+            }
+        }
+
+        keyclick_contact c = kc->pending[first];
+        if ((int32_t)(c.time - until) >= 0) {
+            break;
+        }
+
+        // Keep the rest in order, so simultaneous contacts stay in
+        // the order they were pushed.
+        memmove(&kc->pending[first], &kc->pending[first + 1], (kc->num_pending - first - 1) * sizeof(keyclick_contact));
+        kc->num_pending--;
+
+        int t = manual_contact(c.m, c.key, c.drawbar, c.closed);
+        if (t != 0) {
+            emit(c.time, t, c.m->bus->output[t], ctx);
+            n++;
+        }
+    }
+
+    return n;
+}
+
+#if defined(__cplusplus)
+}
+#endif
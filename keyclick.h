@@ -0,0 +1,73 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef KEYCLICK_H
+#define KEYCLICK_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "manual.h"
+
+// The most contacts that can be waiting to close or open. A key with
+// bounce uses three per drawbar.
+#define KEYCLICK_PENDING (256)
+
+// keyclick_contact is one busbar contact waiting to change.
+typedef struct _keyclick_contact {
+    uint32_t time;
+    manual *m;
+    uint8_t key;
+    uint8_t drawbar;
+    uint8_t closed;
+} keyclick_contact;
+
+// keyclick staggers the busbar contacts of each key. A B3 key closes
+// one contact per drawbar, and they don't all make contact at once:
+// the tonewheels come in one at a time over a few milliseconds, each
+// with a step in volume. That is the organ's key click.
+//
+// Each (key, drawbar) contact gets its own fixed delay within
+// _spread_ samples, and on a key down can bounce open and closed
+// again. keyclick_run applies the contacts to their manuals in time
+// order and reports each tonewheel's new volume with its sample time,
+// for tonewheel_osc_schedule.
+//
+// keyclick only runs in loop(); it's not safe to use from the audio
+// interrupt.
+typedef struct _keyclick {
+    uint32_t spread;
+    uint32_t bounce;
+    uint32_t seed;
+
+    size_t num_pending;
+    keyclick_contact pending[KEYCLICK_PENDING];
+} keyclick;
+
+// keyclick_init spreads contacts over _spread_ samples. Closing
+// contacts bounce open for up to _bounce_ samples; 0 disables bounce.
+void keyclick_init(keyclick *kc, uint32_t spread, uint32_t bounce);
+
+// keyclick_key_down and keyclick_key_up press or release _key_ of _m_
+// at sample time _now_. Contacts still pending for the key are
+// dropped. If there isn't room for every contact, they all change at
+// once.
+void keyclick_key_down(keyclick *kc, manual *m, int key, uint32_t now);
+void keyclick_key_up(keyclick *kc, manual *m, int key, uint32_t now);
+
+// keyclick_emit_fn receives a tonewheel's new volume and the sample
+// time it takes effect.
+typedef void (*keyclick_emit_fn)(uint32_t time, int tonewheel, uint16_t volume, void *ctx);
+
+// keyclick_run applies the pending contacts due before _until_, at
+// most _max_ of them, in time order. It returns the number applied.
+size_t keyclick_run(keyclick *kc, uint32_t until, size_t max, keyclick_emit_fn emit, void *ctx);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
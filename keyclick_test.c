@@ -0,0 +1,172 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifdef ROTO_TEST
+
+#include "greatest.h"
+
+#include "keyclick.h"
+
+typedef struct {
+    int n;
+    uint32_t times[64];
+    int tonewheels[64];
+    uint16_t volumes[64];
+} emitted;
+
+static void record(uint32_t time, int tonewheel, uint16_t volume, void *ctx) {
+    emitted *e = (emitted *)ctx;
+    if (e->n < 64) {
+        e->times[e->n] = time;
+        e->tonewheels[e->n] = tonewheel;
+        e->volumes[e->n] = volume;
+    }
+    e->n++;
+}
+
+static void all_drawbars(manual *m) {
+    for (int d = 1; d <= m->num_drawbars; d++) {
+        manual_set_drawbar(m, d, 8);
+    }
+}
+
+// test_keyclick_staggered ensures a key's contacts close one at a
+// time, in time order, within the spread, and end up where
+// manual_key_down would have put them.
+TEST test_keyclick_staggered() {
+    static manual_bus bus, want_bus;
+    static manual m, want;
+    static keyclick kc;
+    static emitted e;
+
+    manual_bus_init(&bus);
+    manual_init(&m, &bus);
+    all_drawbars(&m);
+    manual_bus_init(&want_bus);
+    manual_init(&want, &want_bus);
+    all_drawbars(&want);
+
+    keyclick_init(&kc, 132, 0);
+    e.n = 0;
+
+    keyclick_key_down(&kc, &m, 30, 1000);
+    ASSERT_EQ_FMT(9, (int)kc.num_pending, "%d");
+    ASSERT_EQ_FMT(1, m.keys[30], "%d");
+    ASSERT_EQ_FMT(0, m.contacts[30], "%d");
+
+    // Nothing is due before the key was pressed.
+    ASSERT_EQ_FMT(0, (int)keyclick_run(&kc, 1000, 100, record, &e), "%d");
+
+    ASSERT_EQ_FMT(9, (int)keyclick_run(&kc, 1000 + 132, 100, record, &e), "%d");
+    ASSERT_EQ_FMT(9, e.n, "%d");
+    ASSERT_EQ_FMT(0, (int)kc.num_pending, "%d");
+
+    int distinct = 0;
+    for (int i = 0; i < 9; i++) {
+        ASSERT(e.times[i] >= 1000 && e.times[i] < 1000 + 132);
+        if (i > 0) {
+            ASSERT(e.times[i] >= e.times[i - 1]);
+            distinct += e.times[i] != e.times[i - 1];
+        }
+    }
+    ASSERTm("contacts all closed at once", distinct > 0);
+
+    manual_key_down(&want, 30);
+    ASSERT_EQ_FMT(want.contacts[30], m.contacts[30], "%d");
+    ASSERT_MEM_EQ(want_bus.output, bus.output, sizeof(bus.output));
+
+    // The last volume reported for each tonewheel is its final one.
+    for (int i = 0; i < 9; i++) {
+        int t = e.tonewheels[i];
+        int last = 1;
+        for (int j = i + 1; j < 9; j++) {
+            last &= e.tonewheels[j] != t;
+        }
+        if (last) {
+            ASSERT_EQ_FMT(bus.output[t], e.volumes[i], "%d");
+        }
+    }
+
+    PASS();
+}
+
+TEST test_keyclick_partial() {
+    static manual_bus bus;
+    static manual m;
+    static keyclick kc;
+    static emitted e;
+
+    manual_bus_init(&bus);
+    manual_init(&m, &bus);
+    all_drawbars(&m);
+    keyclick_init(&kc, 132, 0);
+    e.n = 0;
+
+    keyclick_key_down(&kc, &m, 30, 0);
+
+    // Limited by max.
+    ASSERT_EQ_FMT(2, (int)keyclick_run(&kc, 132, 2, record, &e), "%d");
+    ASSERT_EQ_FMT(7, (int)kc.num_pending, "%d");
+
+    // A key up before every contact closed drops the rest.
+    keyclick_key_up(&kc, &m, 30, 10);
+    ASSERT_EQ_FMT(9, (int)kc.num_pending, "%d");
+    keyclick_run(&kc, 10 + 132, 100, record, &e);
+    ASSERT_EQ_FMT(0, m.contacts[30], "%d");
+    for (int t = 1; t < 92; t++) {
+        ASSERT_EQ_FMT(0, bus.output[t], "%d");
+    }
+
+    PASS();
+}
+
+TEST test_keyclick_bounce() {
+    static manual_bus bus;
+    static manual m;
+    static keyclick kc;
+    static emitted e;
+
+    manual_bus_init(&bus);
+    manual_init(&m, &bus);
+    all_drawbars(&m);
+    keyclick_init(&kc, 132, 20);
+    e.n = 0;
+
+    keyclick_key_down(&kc, &m, 30, 0);
+    keyclick_run(&kc, 1000, 100, record, &e);
+
+    // Bounced contacts open and close again.
+    ASSERT(e.n > 9);
+    ASSERT_EQ_FMT(0x3fe, m.contacts[30], "%x");
+
+    PASS();
+}
+
+// test_keyclick_full ensures keys still sound when there's no room
+// to stagger their contacts.
+TEST test_keyclick_full() {
+    static manual_bus bus;
+    static manual m;
+    static keyclick kc;
+
+    manual_bus_init(&bus);
+    manual_init(&m, &bus);
+    all_drawbars(&m);
+    keyclick_init(&kc, 132, 0);
+
+    for (int k = 1; k <= 61; k++) {
+        keyclick_key_down(&kc, &m, k, 0);
+    }
+    ASSERT(kc.num_pending <= KEYCLICK_PENDING);
+    ASSERT_EQ_FMT(0x3fe, m.contacts[61], "%x");
+
+    PASS();
+}
+
+GREATEST_SUITE(keyclick_suite) {
+    RUN_TEST(test_keyclick_staggered);
+    RUN_TEST(test_keyclick_partial);
+    RUN_TEST(test_keyclick_bounce);
+    RUN_TEST(test_keyclick_full);
+}
+
+#endif
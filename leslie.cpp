@@ -0,0 +1,125 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "leslie.h"
+#include "sample.h"
+
+void leslie_init(leslie_cabinet *l) {
+    memset(l, 0, sizeof(leslie_cabinet));
+    for (int side = 0; side < 2; side++) {
+        l->gains[side][LESLIE_BASS] = LESLIE_GAIN_ONE;
+        l->gains[side][LESLIE_TREBLE] = LESLIE_GAIN_ONE;
+    }
+}
+
+static void leslie_mix(const int32_t gains[2], const int16_t *bass, const int16_t *treble, int16_t *out, size_t len) {
+    int32_t g0 = gains[LESLIE_BASS];
+    int32_t g1 = gains[LESLIE_TREBLE];
+    for (size_t i = 0; i < len; i++) {
+        out[i] = sat16((bass[i] * g0 + treble[i] * g1) >> 12);
+    }
+}
+
+// leslie_rotor runs one rotor over _band_. The band is shared with
+// the other side, so unless _last_ it's processed in a copy in
+// _scratch_. It returns the block holding the rotor's output.
+static const int16_t *leslie_rotor(amfm_rotor *r, int16_t *band, int16_t *scratch, size_t len, int last) {
+    if (amfm_rotor_bypassed(r)) {
+        return band;
+    }
+
+    int16_t *block = band;
+    if (!last) {
+        memcpy(scratch, band, len * sizeof(int16_t));
+        block = scratch;
+    }
+    amfm_rotor_process(r, block, (int)len);
+    return block;
+}
+
+// leslie_horn_delay delays _block_ by LESLIE_DRUM_DELAY samples.
+static void leslie_horn_delay(int16_t *hist, int16_t *block, size_t len) {
+    int16_t tail[LESLIE_DRUM_DELAY];
+    memcpy(tail, block + len - LESLIE_DRUM_DELAY, sizeof(tail));
+    memmove(block + LESLIE_DRUM_DELAY, block, (len - LESLIE_DRUM_DELAY) * sizeof(int16_t));
+    memcpy(block, hist, sizeof(tail));
+    memcpy(hist, tail, sizeof(tail));
+}
+
+void leslie_process(leslie_cabinet *l, int16_t *in, int16_t *out_r, int16_t *out_l, size_t len) {
+    int16_t hi[LESLIE_BLOCK_MAX];
+    int16_t bass[LESLIE_BLOCK_MAX];
+    int16_t treble[LESLIE_BLOCK_MAX];
+    int16_t drum[LESLIE_BLOCK_MAX >> LESLIE_DRUM_SHIFT];
+    int16_t drum_scratch[LESLIE_BLOCK_MAX >> LESLIE_DRUM_SHIFT];
+
+    l->ringing = 1;
+    preamp_process(l->preamp, in, in, len);
+    crossover_process(l->crossover, in, in, hi, len);
+
+    size_t drum_len = len >> LESLIE_DRUM_SHIFT;
+    decimate4(in, len, drum);
+    leslie_horn_delay(l->horn_delay, hi, len);
+
+    // The right side goes last, so it can work in drum and hi and
+    // write over them.
+    int16_t *outs[2] = {out_r, out_l};
+    for (int side = LESLIE_L; side >= LESLIE_R; side--) {
+        int last = side == LESLIE_R;
+
+        const int16_t *d = leslie_rotor(l->rotors[side][LESLIE_BASS], drum, drum_scratch, drum_len, last);
+        polyphase4_interpolate(&l->drum_up[side], d, drum_len, bass);
+
+        const int16_t *t = leslie_rotor(l->rotors[side][LESLIE_TREBLE], hi, treble, len, last);
+        leslie_mix(l->gains[side], bass, t, outs[side], len);
+    }
+}
+
+int leslie_ringing(const leslie_cabinet *l) {
+    return l->ringing;
+}
+
+static int leslie_peak(const int16_t *block, size_t len) {
+    int peak = 0;
+    for (size_t i = 0; i < len; i++) {
+        int x = block[i] < 0 ? -block[i] : block[i];
+        peak = x > peak ? x : peak;
+    }
+    return peak;
+}
+
+void leslie_tail(leslie_cabinet *l, int16_t *out_r, int16_t *out_l, size_t len) {
+    memset(out_r, 0, len * sizeof(int16_t));
+    leslie_process(l, out_r, out_r, out_l, len);
+
+    if (leslie_peak(out_r, len) > LESLIE_SILENCE || leslie_peak(out_l, len) > LESLIE_SILENCE) {
+        return;
+    }
+
+    // Fixed point filters can hum along just above zero forever, so
+    // what's left is cleared rather than played out.
+    crossover_clear(l->crossover);
+    for (int side = 0; side < 2; side++) {
+        amfm_rotor_clear(l->rotors[side][LESLIE_BASS]);
+        amfm_rotor_clear(l->rotors[side][LESLIE_TREBLE]);
+        polyphase4_init(&l->drum_up[side]);
+    }
+    memset(l->horn_delay, 0, sizeof(l->horn_delay));
+    l->ringing = 0;
+}
+
+void leslie_skip(leslie_cabinet *l, size_t len) {
+    for (int side = 0; side < 2; side++) {
+        amfm_rotor_skip(l->rotors[side][LESLIE_BASS], (int)(len >> LESLIE_DRUM_SHIFT));
+        amfm_rotor_skip(l->rotors[side][LESLIE_TREBLE], (int)len);
+    }
+}
+
+#if defined(__cplusplus)
+}
+#endif
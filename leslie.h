@@ -0,0 +1,93 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef LESLIE_H
+#define LESLIE_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "amfm.h"
+#include "crossover.h"
+#include "preamp.h"
+#include "resample.h"
+
+#define LESLIE_R (0)
+#define LESLIE_L (1)
+
+#define LESLIE_BASS (0)
+#define LESLIE_TREBLE (1)
+
+// LESLIE_GAIN_ONE is unity for the microphone mix gains (Q12).
+#define LESLIE_GAIN_ONE (1 << 12)
+
+#define LESLIE_BLOCK_MAX (128)
+
+// The drums only get what's below the crossover, so they run at
+// 44.1kHz >> LESLIE_DRUM_SHIFT: decimate4 on the way in, polyphase4 on
+// the way out. Initialize their rotors with this shift.
+#define LESLIE_DRUM_SHIFT (2)
+
+// LESLIE_DRUM_DELAY is the latency of that round trip: polyphase4
+// delays by 3.5 samples, less the 1.5 decimate4's outputs are
+// centered ahead. The horns are delayed to match, so the bands still
+// cross over in phase.
+#define LESLIE_DRUM_DELAY (2)
+
+// Once the input stops, the cabinet rings until both outputs' peaks
+// are at most LESLIE_SILENCE for a block.
+#define LESLIE_SILENCE (4)
+
+// leslie_cabinet is a Leslie 122 as one block of work: the preamp,
+// the crossover, a bass drum and treble horn for each of the two
+// microphones, and each microphone's mix. It does what the Preamp,
+// AudioFilterStateVariable, AmFm and AudioMixer4 nodes do with two
+// stack scratch bands instead of the audio library's pool.
+//
+// The parts are owned elsewhere; leslie_cabinet only points at them.
+typedef struct _leslie_cabinet {
+    preamp_curve *preamp;
+    crossover_filter *crossover;
+
+    // rotors[side][band] with side LESLIE_R or LESLIE_L and band
+    // LESLIE_BASS or LESLIE_TREBLE.
+    amfm_rotor *rotors[2][2];
+
+    // gains[side][band] is each rotor's level in its side's mix.
+    int32_t gains[2][2];
+
+    // drum_up[side] upsamples each side's drum back to 44.1kHz, and
+    // horn_delay holds the end of the last block's treble.
+    polyphase4 drum_up[2];
+    int16_t horn_delay[LESLIE_DRUM_DELAY];
+
+    // ringing is set while the filters and rotors may still hold
+    // some of the input.
+    uint8_t ringing;
+} leslie_cabinet;
+
+// leslie_init points _l_ at nothing, with unity gains.
+void leslie_init(leslie_cabinet *l);
+
+// leslie_process runs _in_ through the cabinet into _out_r_ and
+// _out_l_, _len_ samples, a multiple of 4 and at most
+// LESLIE_BLOCK_MAX. _in_ is overwritten; _out_r_ may be the same
+// buffer as _in_.
+void leslie_process(leslie_cabinet *l, int16_t *in, int16_t *out_r, int16_t *out_l, size_t len);
+
+// When the input is silent, a ringing cabinet renders its tail with
+// leslie_tail, which stops the ringing once the tail is below
+// LESLIE_SILENCE and clears what's left. A cabinet that isn't ringing
+// outputs silence: leslie_skip only turns its rotors.
+int leslie_ringing(const leslie_cabinet *l);
+void leslie_tail(leslie_cabinet *l, int16_t *out_r, int16_t *out_l, size_t len);
+void leslie_skip(leslie_cabinet *l, size_t len);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,98 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef LESLIE_AUDIO_H
+#define LESLIE_AUDIO_H
+
+#include <Audio.h>
+
+#include "amfm_audio.h"
+#include "crossover_audio.h"
+#include "leslie.h"
+#include "mixer_audio.h"
+#include "preamp_audio.h"
+
+// Leslie is the Leslie 122 half of roto's graph in a single node:
+// preamp, crossover, the four rotors and the two microphone mixers.
+// Its input is the organ; output 0 is the right microphone and 1 the
+// left. Its members have the same controls as the nodes they replace,
+// so the sketch can bind its old names to them.
+//
+// The drums run at a quarter rate; see LESLIE_DRUM_SHIFT.
+//
+// The separate graph allocates a block for the crossover's treble, a
+// copy for two of the rotors and one for each mixer every cycle;
+// Leslie allocates one, for its second output.
+class Leslie : public AudioStream {
+  public:
+    Leslie()
+        : AudioStream(1, inputQueueArray),
+          leslieBassR(LESLIE_DRUM_SHIFT),
+          leslieBassL(LESLIE_DRUM_SHIFT),
+          leslieR(cabinet.gains[LESLIE_R], 2),
+          leslieL(cabinet.gains[LESLIE_L], 2) {
+        leslie_init(&cabinet);
+        cabinet.preamp = &preamp.pre;
+        cabinet.crossover = &crossover.xover;
+        cabinet.rotors[LESLIE_R][LESLIE_BASS] = &leslieBassR.rotor;
+        cabinet.rotors[LESLIE_R][LESLIE_TREBLE] = &leslieTrebleR.rotor;
+        cabinet.rotors[LESLIE_L][LESLIE_BASS] = &leslieBassL.rotor;
+        cabinet.rotors[LESLIE_L][LESLIE_TREBLE] = &leslieTrebleL.rotor;
+    }
+
+    void update() {
+        // The organ is the only consumer of the input, so the right
+        // microphone is written over it.
+        audio_block_t *in = receiveWritable(0);
+
+        // With no input the cabinet plays out its tail, then sends
+        // nothing while the rotors keep turning.
+        if (in == NULL && !leslie_ringing(&cabinet)) {
+            leslie_skip(&cabinet, AUDIO_BLOCK_SAMPLES);
+            return;
+        }
+
+        int tail = in == NULL;
+        if (tail) {
+            in = allocate();
+            if (in == NULL) {
+                return;
+            }
+        }
+
+        audio_block_t *left = allocate();
+        if (left == NULL) {
+            release(in);
+            return;
+        }
+
+        if (tail) {
+            leslie_tail(&cabinet, in->data, left->data, AUDIO_BLOCK_SAMPLES);
+        } else {
+            leslie_process(&cabinet, in->data, in->data, left->data, AUDIO_BLOCK_SAMPLES);
+        }
+
+        transmit(in, 0);
+        transmit(left, 1);
+        release(in);
+        release(left);
+    }
+
+  private:
+    // cabinet is first so it's set up before the gains bind to it.
+    leslie_cabinet cabinet;
+    audio_block_t *inputQueueArray[1];
+
+  public:
+    PreampCore preamp;
+    CrossoverCore crossover;
+
+    AmFmCore leslieBassR;
+    AmFmCore leslieTrebleR;
+    AmFmCore leslieBassL;
+    AmFmCore leslieTrebleL;
+
+    MixerGains leslieR;
+    MixerGains leslieL;
+};
+
+#endif
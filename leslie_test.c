@@ -0,0 +1,189 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifdef ROTO_TEST
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "greatest.h"
+
+#include "leslie.h"
+#include "sample.h"
+
+// leslie_test_parts is everything a leslie_cabinet points at.
+typedef struct {
+    int16_t table[PREAMP_TABLE_LEN + 1];
+    preamp_curve pre;
+    crossover_filter xover;
+    amfm_rotor rotors[2][2];
+} leslie_test_parts;
+
+static void leslie_test_parts_init(leslie_test_parts *p, float rate, int drum_shift) {
+    preamp_init(&p->pre);
+    preamp_fill_table(p->table, 3);
+    preamp_set_table(&p->pre, p->table);
+
+    crossover_init(&p->xover);
+
+    for (int side = 0; side < 2; side++) {
+        for (int band = 0; band < 2; band++) {
+            amfm_rotor *r = &p->rotors[side][band];
+            amfm_rotor_init(r, band == LESLIE_BASS ? drum_shift : 0);
+            amfm_rotor_set_tremolo_depth(r, band == LESLIE_BASS ? 0.3 : 0.1);
+            amfm_rotor_set_delay_depth(r, band == LESLIE_BASS ? 0.5 : 0.3);
+            amfm_rotor_set_directivity(r, 1500, 8000, 44100);
+            amfm_rotor_set_rotation_rate(r, rate);
+            amfm_rotor_set_phase(r, side == LESLIE_R ? 0.25 : 0);
+        }
+    }
+}
+
+#define LESLIE_TEST_BLOCKS (20)
+
+// leslie_test_run runs a chord through a fused cabinet and through
+// its parts one after another at the full rate, as the separate nodes
+// would. The fused cabinet's drums run at a quarter rate, so its
+// output is delayed by LESLIE_DRUM_DELAY and only close: this fails
+// if the error is over _max_err_ or its RMS over _max_rms_.
+static enum greatest_test_res leslie_test_run(float rate, int max_err, double max_rms) {
+    static leslie_test_parts fused, nodes;
+    static int16_t want[2][LESLIE_TEST_BLOCKS * 128], got[2][LESLIE_TEST_BLOCKS * 128];
+    leslie_test_parts_init(&fused, rate, LESLIE_DRUM_SHIFT);
+    leslie_test_parts_init(&nodes, rate, 0);
+
+    leslie_cabinet l;
+    leslie_init(&l);
+    l.preamp = &fused.pre;
+    l.crossover = &fused.xover;
+    for (int side = 0; side < 2; side++) {
+        for (int band = 0; band < 2; band++) {
+            l.rotors[side][band] = &fused.rotors[side][band];
+        }
+        l.gains[side][LESLIE_BASS] = LESLIE_GAIN_ONE * 7 / 10;
+        l.gains[side][LESLIE_TREBLE] = LESLIE_GAIN_ONE * 3 / 10;
+    }
+
+    int16_t in[128], pre[128], lo[128], hi[128], bass[128], treble[128];
+    for (int b = 0; b < LESLIE_TEST_BLOCKS; b++) {
+        for (int i = 0; i < 128; i++) {
+            float t = (float)(b * 128 + i) / 44100;
+            in[i] = (int16_t)(9000 * sinf(2 * (float)M_PI * 220 * t) + 9000 * sinf(2 * (float)M_PI * 2637 * t));
+        }
+
+        // The Leslie node writes the right side over its input.
+        memcpy(pre, in, sizeof(pre));
+        leslie_process(&l, in, in, &got[LESLIE_L][b * 128], 128);
+        memcpy(&got[LESLIE_R][b * 128], in, sizeof(in));
+
+        preamp_process(&nodes.pre, pre, pre, 128);
+        crossover_process(&nodes.xover, pre, lo, hi, 128);
+        for (int side = 0; side < 2; side++) {
+            memcpy(bass, lo, sizeof(bass));
+            memcpy(treble, hi, sizeof(treble));
+            amfm_rotor_process(&nodes.rotors[side][LESLIE_BASS], bass, 128);
+            amfm_rotor_process(&nodes.rotors[side][LESLIE_TREBLE], treble, 128);
+            for (int i = 0; i < 128; i++) {
+                want[side][b * 128 + i] = sat16((bass[i] * l.gains[side][0] + treble[i] * l.gains[side][1]) >> 12);
+            }
+        }
+    }
+
+    // Skip the first blocks, while the filters settle.
+    for (int side = 0; side < 2; side++) {
+        int err_max = 0;
+        double sum_sq = 0;
+        int n = 0;
+        for (int i = 4 * 128; i < LESLIE_TEST_BLOCKS * 128; i++) {
+            int err = abs(got[side][i] - want[side][i - LESLIE_DRUM_DELAY]);
+            err_max = err > err_max ? err : err_max;
+            sum_sq += (double)err * err;
+            n++;
+        }
+        ASSERT_IN_RANGE(0, err_max, max_err);
+        ASSERT(sqrt(sum_sq / n) <= max_rms);
+    }
+
+    PASS();
+}
+
+// test_leslie_matches_nodes ensures the quarter rate drums sound like
+// full rate ones, within about -55dB of a full scale chord.
+TEST test_leslie_matches_nodes() {
+    CHECK_CALL(leslie_test_run(6.66, 150, 60));
+    PASS();
+}
+
+// test_leslie_stopped ensures a stopped cabinet, its rotors holding
+// their delays, still comes out of both sides.
+TEST test_leslie_stopped() {
+    CHECK_CALL(leslie_test_run(0, 150, 60));
+    PASS();
+}
+
+// test_leslie_tail ensures a cabinet plays out its tail after the
+// input stops, then stops ringing and only turns its rotors.
+TEST test_leslie_tail() {
+    static leslie_test_parts parts;
+    leslie_test_parts_init(&parts, 6.66, LESLIE_DRUM_SHIFT);
+
+    leslie_cabinet l;
+    leslie_init(&l);
+    l.preamp = &parts.pre;
+    l.crossover = &parts.xover;
+    for (int side = 0; side < 2; side++) {
+        for (int band = 0; band < 2; band++) {
+            l.rotors[side][band] = &parts.rotors[side][band];
+        }
+    }
+
+    int16_t r[128], left[128];
+    for (int b = 0; b < 4; b++) {
+        for (int i = 0; i < 128; i++) {
+            r[i] = (int16_t)(9000 * sinf(2 * (float)M_PI * 220 * (float)(b * 128 + i) / 44100));
+        }
+        leslie_process(&l, r, r, left, 128);
+    }
+    ASSERT(leslie_ringing(&l));
+
+    // The first block of the tail still carries the delayed input.
+    leslie_tail(&l, r, left, 128);
+    ASSERT(leslie_ringing(&l));
+
+    int blocks = 1;
+    while (leslie_ringing(&l) && blocks < 100) {
+        leslie_tail(&l, r, left, 128);
+        blocks++;
+    }
+    ASSERT_FALSE(leslie_ringing(&l));
+    for (int i = 0; i < 128; i++) {
+        ASSERT_IN_RANGE(0, r[i], LESLIE_SILENCE);
+        ASSERT_IN_RANGE(0, left[i], LESLIE_SILENCE);
+    }
+
+    // Skipping turns the horns at the full rate and the drums at
+    // their own.
+    uint32_t horn = parts.rotors[LESLIE_R][LESLIE_TREBLE].phase;
+    uint32_t drum = parts.rotors[LESLIE_R][LESLIE_BASS].phase;
+    leslie_skip(&l, 128);
+    ASSERT_EQ_FMT(horn + 128 * parts.rotors[LESLIE_R][LESLIE_TREBLE].phaseIncr, parts.rotors[LESLIE_R][LESLIE_TREBLE].phase, "%u");
+    ASSERT_EQ_FMT(drum + 32 * parts.rotors[LESLIE_R][LESLIE_BASS].phaseIncr, parts.rotors[LESLIE_R][LESLIE_BASS].phase, "%u");
+
+    // Silence in is silence out once it's cleared.
+    memset(r, 0, sizeof(r));
+    leslie_process(&l, r, r, left, 128);
+    for (int i = 0; i < 128; i++) {
+        ASSERT_EQ_FMT(0, r[i], "%d");
+        ASSERT_EQ_FMT(0, left[i], "%d");
+    }
+
+    PASS();
+}
+
+GREATEST_SUITE(leslie_suite) {
+    RUN_TEST(test_leslie_matches_nodes);
+    RUN_TEST(test_leslie_stopped);
+    RUN_TEST(test_leslie_tail);
+}
+
+#endif
@@ -4,6 +4,8 @@
 extern "C" {
 #endif
 
+#include <string.h>
+
 #include "manual.h"
 
 // manual is here to maintain the mapping between physical keys on the
@@ -85,6 +87,19 @@ int tonewheel(int key, int drawbar) {
     return 0;
 }
 
+// pedal_tonewheel returns the number of the tonewheel connected to
+// pedal _key_ (1..25) at _drawbar_. The pedals are the only user of
+// tonewheels 1..12.
+int pedal_tonewheel(int key, int drawbar) {
+    switch (drawbar) {
+    case 1: // 16'
+        return key;
+    case 2: // 8'
+        return key + 12;
+    }
+    return 0;
+}
+
 // drawbar_volume returns the volume multiplier for a drawbar set to
 // _value_. It's scaled such that each drawbar stop doubles the power
 // output, normalized to 0.0..1.0. Turns out this is value / 8.
@@ -230,14 +245,171 @@ float resistance9(int key) {
     }
 }
 
-float remap(float v, float oldmin, float oldmax, float newmin, float newmax) {
-    return newmin + (v - oldmin) * (newmax - newmin) / (oldmax - oldmin);
+// drawbar_gains holds the gain of each drawbar setting (Q8). Each
+// stop roughly doubles the power output.
+static const uint16_t drawbar_gains[9] = {0, 362, 512, 724, 1280, 1448, 2048, 2895, 4096};
+
+uint16_t manual_drawbar_gain(uint8_t value, int continuous) {
+    if (!continuous) {
+        return drawbar_gains[value];
+    }
+
+    // Map 0..127 to stops 0..8 with 8 fractional bits.
+    uint32_t pos = ((uint32_t)value << 11) / 127;
+    uint32_t stop = pos >> 8;
+    if (stop >= 8) {
+        return drawbar_gains[8];
+    }
+    uint32_t frac = pos & 0xFF;
+    int32_t a = drawbar_gains[stop];
+    int32_t b = drawbar_gains[stop + 1];
+    return (uint16_t)(a + (((b - a) * (int32_t)frac) >> 8));
 }
 
-// manual_fill_volumes returns the current set of tonewheel volumes,
-// with values in the Q14 range. keys is an array of 61 keys on a
-// manual, zero indexed and nonzero if pressed. drawbars contains the
-// resistance at each of the 9 drawbars, also zero indexed.
+// manual_compress models the loading of a tonewheel generator: the
+// more busbar contacts draw on one tonewheel, the less each of them
+// gets. A tonewheel with summed drawbar gain g has volume
+//
+//   MANUAL_LEVEL_MAX * g / (g + 4096)
+//
+// so one key with its drawbar all the way out drives a tonewheel to
+// half of MANUAL_LEVEL_MAX, and big chords approach it but never get
+// past. Because MANUAL_LEVEL_MAX is bounded, so is the sum of all
+// tonewheel volumes.
+uint16_t manual_compress(uint32_t gain) {
+    uint64_t g = gain;
+    return (uint16_t)((MANUAL_LEVEL_MAX * g + ((g + 4096) >> 1)) / (g + 4096));
+}
+
+void manual_bus_init(manual_bus *bus) {
+    memset(bus, 0, sizeof(manual_bus));
+
+    // Every tonewheel starts dirty, so the first update silences
+    // whatever was playing before.
+    for (int t = 1; t < 92; t++) {
+        bus->dirty[t >> 5] |= 1 << (t & 31);
+    }
+}
+
+void manual_init(manual *m, manual_bus *bus) {
+    memset(m, 0, sizeof(manual));
+    m->num_keys = 61;
+    m->num_drawbars = 9;
+    m->bus = bus;
+}
+
+void manual_init_pedals(manual *m, manual_bus *bus) {
+    memset(m, 0, sizeof(manual));
+    m->pedals = 1;
+    m->num_keys = 25;
+    m->num_drawbars = 2;
+    m->bus = bus;
+}
+
+int manual_bus_next_dirty(manual_bus *bus, int tonewheel) {
+    for (int t = tonewheel; t < 92; t++) {
+        if (bus->dirty[t >> 5] & (1 << (t & 31))) {
+            return t;
+        }
+    }
+    return 0;
+}
+
+void manual_bus_clean(manual_bus *bus, int tonewheel) {
+    bus->dirty[tonewheel >> 5] &= ~(1 << (tonewheel & 31));
+}
+
+// manual_connect adds delta to the gain of the tonewheel connected to
+// _key_ at _drawbar_, and recompresses its volume. It returns the
+// tonewheel.
+static int manual_connect(manual *m, int key, int drawbar, int32_t delta) {
+    int t = m->pedals ? pedal_tonewheel(key, drawbar) : tonewheel(key, drawbar);
+    m->bus->gains[t] += delta;
+    m->bus->output[t] = manual_compress(m->bus->gains[t]);
+    m->bus->dirty[t >> 5] |= 1 << (t & 31);
+    return t;
+}
+
+int manual_contact(manual *m, int key, int drawbar, int closed) {
+    if (key < 1 || key > m->num_keys || drawbar < 1 || drawbar > m->num_drawbars) {
+        return 0;
+    }
+
+    uint16_t bit = 1 << drawbar;
+    if (!closed == !(m->contacts[key] & bit)) {
+        return 0;
+    }
+
+    m->contacts[key] ^= bit;
+    int32_t gain = m->gains[drawbar];
+    return manual_connect(m, key, drawbar, closed ? gain : -gain);
+}
+
+// manual_key_down presses _key_. Only the tonewheels connected to the
+// key are recalculated.
+void manual_key_down(manual *m, int key) {
+    if (key < 1 || key > m->num_keys || m->keys[key]) {
+        return;
+    }
+    m->keys[key] = 1;
+
+    for (int d = 1; d <= m->num_drawbars; d++) {
+        manual_contact(m, key, d, 1);
+    }
+}
+
+void manual_key_up(manual *m, int key) {
+    if (key < 1 || key > m->num_keys || !m->keys[key]) {
+        return;
+    }
+    m->keys[key] = 0;
+
+    for (int d = 1; d <= m->num_drawbars; d++) {
+        manual_contact(m, key, d, 0);
+    }
+}
+
+// manual_set_drawbar sets _drawbar_ to _value_. Only the tonewheels
+// connected to that drawbar on closed contacts are recalculated, at
+// most one per key.
+void manual_set_drawbar(manual *m, int drawbar, uint8_t value) {
+    uint8_t max = m->continuous ? 127 : 8;
+    if (drawbar < 1 || drawbar > m->num_drawbars || value > max || m->drawbars[drawbar] == value) {
+        return;
+    }
+
+    uint16_t gain = manual_drawbar_gain(value, m->continuous);
+    int32_t delta = (int32_t)gain - (int32_t)m->gains[drawbar];
+    m->drawbars[drawbar] = value;
+    m->gains[drawbar] = gain;
+    if (delta == 0) {
+        return;
+    }
+
+    uint16_t bit = 1 << drawbar;
+    for (int k = 1; k <= m->num_keys; k++) {
+        if (m->contacts[k] & bit) {
+            manual_connect(m, k, drawbar, delta);
+        }
+    }
+}
+
+void manual_set_continuous(manual *m, int continuous) {
+    if (!m->continuous == !continuous) {
+        return;
+    }
+
+    for (int d = 1; d <= m->num_drawbars; d++) {
+        manual_set_drawbar(m, d, 0);
+    }
+    m->continuous = continuous ? 1 : 0;
+}
+
+// manual_fill_volumes returns the current set of tonewheel volumes
+// for a manual in the given state, calculated from scratch. keys is
+// an array of 61 keys on a manual, one indexed and nonzero if
+// pressed. drawbars contains the setting (0..8) of each of the 9
+// drawbars, also one indexed. It returns the sum of the volumes.
 //
 // drawbars[1]: 16' (sub-octave)
 // drawbars[2]: 5 1/3' (5th)
@@ -249,39 +421,24 @@ float remap(float v, float oldmin, float oldmax, float newmin, float newmax) {
 // drawbars[8]: 1 1/3' (19th)
 // drawbars[9]: 1' (22nd)
 uint32_t manual_fill_volumes(uint8_t keys[62], uint8_t drawbars[10], uint16_t ret[92]) {
-    float drawvols[] = {0, 1.414, 2, 2.828, 5, 5.657, 8, 11.31, 16};
+    manual_bus bus;
+    manual m;
+    manual_bus_init(&bus);
+    manual_init(&m, &bus);
 
-    // The total possible gain per tonewheel, if all keys are down and
-    // all the stops are out.
-    float totals[92] = {0};
-
-    float gains[92] = {0};
+    for (int d = 1; d < 10; d++) {
+        manual_set_drawbar(&m, d, drawbars[d]);
+    }
     for (int k = 1; k < 62; k++) {
-        for (int d = 1; d < 10; d++) {
-            int t = tonewheel(k, d);
-            totals[t] += drawvols[8];
-            if (keys[k] == 0 || drawbars[d] == 0) {
-                continue;
-            }
-            gains[t] += drawvols[drawbars[d]];
+        if (keys[k]) {
+            manual_key_down(&m, k);
         }
     }
 
-    float sum = 0;
-    for (int t = 1; t < 92; t++) {
-        sum += totals[t];
-    }
-
-    // Normalize gains to set the range of the oscillator to 0.0 .. 1.0
     uint32_t total = 0;
     for (int t = 0; t < 92; t++) {
-        if (gains[t] == 0) {
-            ret[t] = 0;
-            continue;
-        }
-        uint32_t v = (uint32_t)remap(gains[t], 0, sum, (float)(1 << 11), (float)(1 << 18));
-        total += v;
-        ret[t] = (uint16_t)v;
+        ret[t] = bus.output[t];
+        total += bus.output[t];
     }
     return total;
 }
@@ -9,19 +9,103 @@ extern "C" {
 
 #include <stdint.h>
 
-// manual simulates an organ keyboard and its drawbars.
-typedef struct _manual {
-    uint8_t drawbars[9];
-    uint8_t keys[61];
+// MANUAL_LEVEL_MAX is the loudest a single tonewheel can be driven,
+// no matter how many keys are connected to it. It's chosen so all 91
+// tonewheels at once fit the oscillator's 16 bit output.
+#define MANUAL_LEVEL_MAX (2880)
+
+// manual_bus collects the tonewheel gains of every manual attached
+// to it. The upper manual, lower manual and pedals of an organ share
+// one bus, so its output has a single volume per tonewheel and each
+// tonewheel is rendered once no matter how many manuals use it.
+typedef struct _manual_bus {
+    // gains holds the summed drawbar gain (Q8) connected to each
+    // tonewheel. It's updated incrementally as keys and drawbars
+    // change.
+    uint32_t gains[92];
 
+    // output holds the tonewheel volumes, compressed from gains.
     uint16_t output[92];
+
+    // dirty has a bit set for each tonewheel whose output has changed
+    // since it was cleaned with manual_bus_clean.
+    uint32_t dirty[3];
+} manual_bus;
+
+// manual simulates an organ keyboard or pedalboard and its drawbars.
+// Keys, drawbars and tonewheels are all 1-indexed, to match the B3's
+// numbering.
+typedef struct _manual {
+    uint8_t pedals;
+    uint8_t num_keys;
+    uint8_t num_drawbars;
+
+    // continuous is nonzero if drawbars take the full 0..127 range of
+    // a MIDI CC instead of the B3's 0..8 stops.
+    uint8_t continuous;
+
+    uint8_t drawbars[10];
+    uint8_t keys[62];
+
+    // gains holds the gain (Q8) each drawbar adds to a tonewheel for
+    // every closed contact.
+    uint16_t gains[10];
+
+    // contacts has bit d set for each key whose drawbar d busbar
+    // contact is closed. A key's contacts usually follow the key, but
+    // can lag behind it; see keyclick.h.
+    uint16_t contacts[62];
+
+    manual_bus *bus;
 } manual;
 
+// manual_bus_init clears _bus_ and marks every tonewheel dirty.
+void manual_bus_init(manual_bus *bus);
+
+// manual_bus_next_dirty returns the first dirty tonewheel at or after
+// _tonewheel_, or 0 if there are none.
+int manual_bus_next_dirty(manual_bus *bus, int tonewheel);
+void manual_bus_clean(manual_bus *bus, int tonewheel);
+
+// manual_init sets up a 61 key manual with 9 drawbars on _bus_.
+void manual_init(manual *m, manual_bus *bus);
+
+// manual_init_pedals sets up a 25 key pedalboard with 2 drawbars (16'
+// and 8') on _bus_.
+void manual_init_pedals(manual *m, manual_bus *bus);
+
+// manual_key_down and manual_key_up press or release _key_ and all of
+// its contacts at once.
+void manual_key_down(manual *m, int key);
+void manual_key_up(manual *m, int key);
+
+// manual_contact closes or opens the single busbar contact for _key_
+// at _drawbar_. It returns the tonewheel connected to that contact.
+int manual_contact(manual *m, int key, int drawbar, int closed);
+
+// manual_set_drawbar sets _drawbar_ to _value_: 0..8, or 0..127 if
+// the manual is continuous.
+void manual_set_drawbar(manual *m, int drawbar, uint8_t value);
+
+// manual_set_continuous switches _m_ between stepped and continuous
+// drawbars. Every drawbar is pushed in, so set them again afterward.
+void manual_set_continuous(manual *m, int continuous);
+
+// manual_drawbar_gain returns the gain (Q8) of a drawbar at _value_,
+// 0..8 or, if _continuous_, 0..127. Continuous values interpolate
+// between the stops.
+uint16_t manual_drawbar_gain(uint8_t value, int continuous);
+
+// manual_compress maps a tonewheel's summed drawbar gain to its
+// volume. See manual.cpp for the curve.
+uint16_t manual_compress(uint32_t gain);
+
 uint32_t manual_fill_volumes(uint8_t keys[62], uint8_t drawbars[10], uint16_t ret[92]);
 uint8_t manual_quantize_drawbar(uint8_t val);
 
 int foldback(uint8_t tonewheel);
 int tonewheel(int key, int drawbar);
+int pedal_tonewheel(int key, int drawbar);
 
 #if defined(__cplusplus)
 }
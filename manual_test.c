@@ -11,7 +11,7 @@
 #include "manual.h"
 
 uint32_t total_volume(uint16_t volumes[92]) {
-    uint32_t sum;
+    uint32_t sum = 0;
     for (int i = 0; i < 92; i++) {
         sum += (uint32_t)volumes[i];
     }
@@ -175,7 +175,185 @@ TEST test_manual_drawbar_incr() {
     PASS();
 }
 
+TEST test_manual_compress() {
+    // summed drawbar gain (Q8) -> tonewheel volume
+    uint32_t gains[8] = {0, 362, 1280, 4096, 8192, 12288, 40960, 1 << 20};
+    uint16_t want[8] = {0, 234, 686, 1440, 1920, 2160, 2618, 2869};
+
+    for (int i = 0; i < 8; i++) {
+        ASSERT_EQ_FMT(want[i], manual_compress(gains[i]), "%d");
+    }
+
+    // The curve never exceeds its limit.
+    ASSERT(manual_compress(UINT32_MAX) <= MANUAL_LEVEL_MAX);
+
+    PASS();
+}
+
+// test_manual_compress_chord ensures tonewheels shared by several
+// keys are compressed, using the table in test_manual_compress.
+TEST test_manual_compress_chord() {
+    manual_bus bus;
+    manual m;
+    manual_bus_init(&bus);
+    manual_init(&m, &bus);
+    manual_set_drawbar(&m, 3, 8);
+
+    // Key 13 at 8' sounds tonewheel 25.
+    manual_key_down(&m, 13);
+    ASSERT_EQ_FMT(1440, bus.output[25], "%d");
+
+    // Tonewheel 13 is connected to key 13 at 16' and, through
+    // foldback, to key 1 at both 16' and 8'.
+    manual_set_drawbar(&m, 1, 8);
+    ASSERT_EQ_FMT(1440, bus.output[13], "%d");
+    manual_key_down(&m, 1);
+    ASSERT_EQ_FMT(2160, bus.output[13], "%d");
+    ASSERT_EQ_FMT(1440, bus.output[25], "%d");
+
+    PASS();
+}
+
+// test_manual_incremental ensures key and drawbar changes give the
+// same volumes as recalculating from scratch.
+TEST test_manual_incremental() {
+    manual_bus bus;
+    manual m;
+    manual_bus_init(&bus);
+    manual_init(&m, &bus);
+
+    uint8_t keys[62] = {0};
+    uint8_t drawbars[10] = {0};
+    uint16_t want[92] = {0};
+
+    // A deterministic jumble of key and drawbar changes.
+    uint32_t r = 1;
+    for (int i = 0; i < 2000; i++) {
+        r = r * 1103515245 + 12345;
+        int which = (r >> 16) % 70;
+        if (which < 61) {
+            int k = which + 1;
+            keys[k] = !keys[k];
+            if (keys[k]) {
+                manual_key_down(&m, k);
+            } else {
+                manual_key_up(&m, k);
+            }
+        } else {
+            int d = which - 60;
+            drawbars[d] = (r >> 8) % 9;
+            manual_set_drawbar(&m, d, drawbars[d]);
+        }
+
+        manual_fill_volumes(keys, drawbars, want);
+        ASSERT_MEM_EQ(want, bus.output, sizeof(want));
+    }
+
+    PASS();
+}
+
+// test_manual_continuous ensures a continuous drawbar sweeps its
+// gain smoothly between the stops, and that moving it gives the same
+// volumes as setting it on a fresh manual.
+TEST test_manual_continuous() {
+    ASSERT_EQ_FMT(0, manual_drawbar_gain(0, 1), "%d");
+    ASSERT_EQ_FMT(4096, manual_drawbar_gain(127, 1), "%d");
+    for (int v = 1; v < 128; v++) {
+        int step = manual_drawbar_gain(v, 1) - manual_drawbar_gain(v - 1, 1);
+        ASSERTm("gain went down", step >= 0);
+        ASSERTm("gain jumped", step <= 82);
+    }
+
+    manual_bus bus;
+    manual m;
+    manual_bus_init(&bus);
+    manual_init(&m, &bus);
+    manual_set_continuous(&m, 1);
+    manual_key_down(&m, 30);
+    manual_key_down(&m, 34);
+
+    for (int v = 0; v < 128; v++) {
+        manual_set_drawbar(&m, 3, v);
+
+        manual_bus want_bus;
+        manual want;
+        manual_bus_init(&want_bus);
+        manual_init(&want, &want_bus);
+        manual_set_continuous(&want, 1);
+        manual_set_drawbar(&want, 3, v);
+        manual_key_down(&want, 30);
+        manual_key_down(&want, 34);
+        ASSERT_MEM_EQ(want_bus.output, bus.output, sizeof(bus.output));
+    }
+
+    // Switching modes pushes every drawbar in.
+    manual_set_continuous(&m, 0);
+    for (int t = 0; t < 92; t++) {
+        ASSERT_EQ_FMT(0, bus.gains[t], "%d");
+    }
+
+    PASS();
+}
+
+TEST test_manual_pedals() {
+    manual_bus bus;
+    manual pedals;
+    manual_bus_init(&bus);
+    manual_init_pedals(&pedals, &bus);
+
+    manual_set_drawbar(&pedals, 1, 8);
+    manual_set_drawbar(&pedals, 2, 8);
+
+    // The pedals have two drawbars and 25 keys.
+    manual_set_drawbar(&pedals, 3, 8);
+    ASSERT_EQ_FMT(0, pedals.drawbars[3], "%d");
+    manual_key_down(&pedals, 26);
+    ASSERT_EQ_FMT(0, pedals.keys[26], "%d");
+
+    // Low C sounds tonewheels 1 (16') and 13 (8').
+    manual_key_down(&pedals, 1);
+    for (int t = 1; t < 92; t++) {
+        uint16_t want = (t == 1 || t == 13) ? 1440 : 0;
+        ASSERT_EQ_FMT(want, bus.output[t], "%d");
+    }
+
+    PASS();
+}
+
+// test_manual_shared_bus ensures manuals on one bus are summed before
+// compression, as if they were one bigger manual.
+TEST test_manual_shared_bus() {
+    manual_bus bus;
+    manual upper, lower, pedals;
+    manual_bus_init(&bus);
+    manual_init(&upper, &bus);
+    manual_init(&lower, &bus);
+    manual_init_pedals(&pedals, &bus);
+
+    manual_set_drawbar(&upper, 3, 8);
+    manual_set_drawbar(&lower, 3, 8);
+    manual_set_drawbar(&pedals, 2, 8);
+
+    // Upper key 13, lower key 13 and pedal 13 at 8' are all tonewheel 25.
+    manual_key_down(&upper, 13);
+    manual_key_down(&lower, 13);
+    manual_key_down(&pedals, 13);
+    ASSERT_EQ_FMT(manual_compress(3 * 4096), bus.output[25], "%d");
+
+    manual_key_up(&lower, 13);
+    manual_key_up(&pedals, 13);
+    ASSERT_EQ_FMT(1440, bus.output[25], "%d");
+
+    PASS();
+}
+
 GREATEST_SUITE(manual_suite) {
+    RUN_TEST(test_manual_pedals);
+    RUN_TEST(test_manual_shared_bus);
+    RUN_TEST(test_manual_compress);
+    RUN_TEST(test_manual_compress_chord);
+    RUN_TEST(test_manual_incremental);
+    RUN_TEST(test_manual_continuous);
     RUN_TEST(test_manual_drawbar_incr);
     RUN_TEST(test_manual_foldback);
     RUN_TEST(test_manual_tonewheel);
@@ -0,0 +1,53 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef MIXER_AUDIO_H
+#define MIXER_AUDIO_H
+
+#include <stdint.h>
+
+// mixer_gain converts a float gain to the Q12 the fused nodes mix
+// with, clamped to just under 8x so a sum of two products fits in 32
+// bits.
+static inline int32_t mixer_gain(float g) {
+    if (g > 7.999f) {
+        g = 7.999f;
+    } else if (g < -7.999f) {
+        g = -7.999f;
+    }
+    return (int32_t)(g * 4096);
+}
+
+// MixerGains has the controls of an AudioMixer4, setting gains in a
+// kernel's struct. Channels past _n_ have nothing connected, so their
+// gains are ignored.
+class MixerGains {
+  public:
+    MixerGains(int32_t *gains, unsigned n) : gains(gains), n(n) {
+    }
+
+    void gain(unsigned channel, float g) {
+        if (channel < n) {
+            gains[channel] = mixer_gain(g);
+        }
+    }
+
+  private:
+    int32_t *gains;
+    unsigned n;
+};
+
+// AmplifierGain has the controls of an AudioAmplifier.
+class AmplifierGain {
+  public:
+    AmplifierGain(int32_t *level) : level(level) {
+    }
+
+    void gain(float g) {
+        *level = mixer_gain(g);
+    }
+
+  private:
+    int32_t *level;
+};
+
+#endif
@@ -0,0 +1,154 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "monitor.h"
+
+// monitor_barrier keeps the compiler (and CPU) from moving memory
+// accesses across the sequence lock updates.
+#define monitor_barrier() __sync_synchronize()
+
+static void levels_clear(monitor_levels *l) {
+    memset(l, 0, sizeof(monitor_levels));
+}
+
+// levels_merge folds the levels in src into dst.
+static void levels_merge(monitor_levels *dst, const monitor_levels *src) {
+    dst->min = src->min < dst->min ? src->min : dst->min;
+    dst->max = src->max > dst->max ? src->max : dst->max;
+    dst->peak = src->peak > dst->peak ? src->peak : dst->peak;
+    dst->clips += src->clips;
+    dst->sumsq += src->sumsq;
+    dst->samples += src->samples;
+    for (int i = 0; i < MONITOR_HIST_LEN; i++) {
+        dst->hist[i] += src->hist[i];
+    }
+}
+
+// midpoint estimates the signal halfway between b and c with a cubic
+// through a, b, c and d. This catches most of the inter-sample peaks
+// that a sample peak meter misses.
+static inline int32_t midpoint(int32_t a, int32_t b, int32_t c, int32_t d) {
+    return (9 * (b + c) - (a + d)) >> 4;
+}
+
+static inline int32_t iabs(int32_t v) {
+    return v < 0 ? -v : v;
+}
+
+void monitor_init(monitor *m) {
+    memset(m, 0, sizeof(monitor));
+}
+
+void monitor_set_histogram(monitor *m, int enabled) {
+    m->hist_enabled = enabled ? 1 : 0;
+}
+
+void monitor_reset(monitor *m) {
+    m->reset_req = 1;
+}
+
+void monitor_update(monitor *m, const int16_t *block, size_t block_len) {
+    monitor_levels lv;
+    levels_clear(&lv);
+
+    // Measure the block. This loop has no data dependent branches so
+    // the compiler is free to vectorize it.
+    int32_t mn = 0;
+    int32_t mx = 0;
+    int32_t peak = 0;
+    uint32_t clips = 0;
+    uint64_t sumsq = 0;
+    for (size_t i = 0; i < block_len; i++) {
+        int32_t v = block[i];
+        mn = v < mn ? v : mn;
+        mx = v > mx ? v : mx;
+        peak = iabs(v) > peak ? iabs(v) : peak;
+        clips += (v >= MONITOR_CLIP) | (v <= -MONITOR_CLIP);
+        sumsq += (uint64_t)(v * v);
+    }
+
+    // The true peak estimate looks at the midpoint between each pair
+    // of samples, which needs the tail of the previous block.
+    int32_t a = m->tail[0];
+    int32_t b = m->tail[1];
+    int32_t c = m->tail[2];
+    for (size_t i = 0; i < block_len; i++) {
+        int32_t d = block[i];
+        int32_t mid = iabs(midpoint(a, b, c, d));
+        peak = mid > peak ? mid : peak;
+        a = b;
+        b = c;
+        c = d;
+    }
+    m->tail[0] = (int16_t)a;
+    m->tail[1] = (int16_t)b;
+    m->tail[2] = (int16_t)c;
+
+    if (m->hist_enabled) {
+        for (size_t i = 0; i < block_len; i++) {
+            uint32_t mag = (uint32_t)iabs(block[i]);
+            int bucket = mag == 0 ? 0 : 32 - __builtin_clz(mag);
+            lv.hist[bucket < MONITOR_HIST_LEN ? bucket : MONITOR_HIST_LEN - 1]++;
+        }
+    }
+
+    lv.min = (int16_t)mn;
+    lv.max = (int16_t)mx;
+    lv.peak = peak;
+    lv.clips = clips;
+    lv.sumsq = sumsq;
+    lv.samples = (uint32_t)block_len;
+
+    // Publish. An odd sequence number tells readers a write is in
+    // progress.
+    m->seq++;
+    monitor_barrier();
+
+    if (m->reset_req) {
+        m->reset_req = 0;
+        levels_clear(&m->levels.interval);
+    }
+
+    m->levels.block = lv;
+    levels_merge(&m->levels.interval, &lv);
+    levels_merge(&m->levels.ever, &lv);
+
+    monitor_barrier();
+    m->seq++;
+}
+
+void monitor_read(monitor *m, monitor_snapshot *snap) {
+    uint32_t seq;
+    do {
+        seq = m->seq;
+        monitor_barrier();
+        memcpy(snap, &m->levels, sizeof(monitor_snapshot));
+        monitor_barrier();
+    } while ((seq & 1) || seq != m->seq);
+}
+
+uint32_t monitor_rms(const monitor_levels *l) {
+    if (l->samples == 0) {
+        return 0;
+    }
+
+    // Integer square root of the mean square, one bit at a time.
+    uint64_t ms = l->sumsq / l->samples;
+    uint32_t root = 0;
+    for (uint32_t bit = 1 << 15; bit > 0; bit >>= 1) {
+        uint32_t trial = root | bit;
+        if ((uint64_t)trial * trial <= ms) {
+            root = trial;
+        }
+    }
+    return root;
+}
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,86 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Samples at or beyond +/-MONITOR_CLIP are counted as clipped.
+#define MONITOR_CLIP (32767)
+
+// The histogram has one bucket per bit of sample magnitude: bucket n
+// counts samples with 2^(n-1) <= |v| < 2^n, and bucket 0 counts
+// zeros. Magnitudes of 2^15 share the top bucket.
+#define MONITOR_HIST_LEN (16)
+
+// monitor_levels summarizes the samples seen over some span of time.
+typedef struct _monitor_levels {
+    int16_t min;
+    int16_t max;
+
+    // peak is the largest magnitude seen, including an estimate of
+    // the inter-sample (true) peak. It can exceed 32767.
+    int32_t peak;
+
+    // clips counts samples at or beyond +/-MONITOR_CLIP.
+    uint32_t clips;
+
+    // sumsq and samples are kept so RMS can be calculated outside of
+    // the audio path; see monitor_rms.
+    uint64_t sumsq;
+    uint32_t samples;
+
+    uint32_t hist[MONITOR_HIST_LEN];
+} monitor_levels;
+
+// monitor_snapshot is a consistent copy of a monitor's levels.
+typedef struct _monitor_snapshot {
+    monitor_levels block;    // the most recent block
+    monitor_levels interval; // since the last monitor_reset
+    monitor_levels ever;     // since monitor_init
+} monitor_snapshot;
+
+// monitor measures the levels of an audio signal. It has a single
+// writer (monitor_update, called from the audio interrupt) and any
+// number of readers (monitor_read). Readers never block the writer:
+// the levels are published through a sequence lock, and readers
+// retry if the writer ran while they were copying.
+typedef struct _monitor {
+    volatile uint32_t seq;
+    volatile uint8_t reset_req;
+    uint8_t hist_enabled;
+
+    // The last three samples of the previous block, oldest first, for
+    // the true peak estimate.
+    int16_t tail[3];
+
+    monitor_snapshot levels;
+} monitor;
+
+void monitor_init(monitor *m);
+void monitor_set_histogram(monitor *m, int enabled);
+
+// monitor_update measures one block of audio and publishes the
+// result. It's safe to call from an interrupt.
+void monitor_update(monitor *m, const int16_t *block, size_t block_len);
+
+// monitor_reset asks the writer to clear the interval levels. This
+// takes effect at the start of the next monitor_update.
+void monitor_reset(monitor *m);
+
+// monitor_read copies the current levels into snap without tearing.
+void monitor_read(monitor *m, monitor_snapshot *snap);
+
+// monitor_rms returns the RMS level of l, in sample units.
+uint32_t monitor_rms(const monitor_levels *l);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
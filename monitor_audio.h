@@ -5,74 +5,84 @@
 
 #include <Audio.h>
 
+#include "monitor.h"
+
 // Monitor is an audio device that monitors the output levels of an
 // audio channel. It's useful for seeing how much headroom is
 // available in the 16 bit space.
-class Monitor : public AudioStream {
+//
+// Monitor is a tap: it has no outputs, so connect it alongside the
+// signal path rather than inline. It's cheap enough to leave running
+// (roughly 1k cycles per block, well under 1% CPU on a Teensy 3.6).
+//
+// MonitorCore holds the levels and their readers, without an
+// AudioStream, so the Organ node can monitor its tonewheels inline.
+class MonitorCore {
   public:
-    Monitor() : AudioStream(1, inputQueueArray) {
-    }
-
     void init() {
-	min_vol = 0;
-	max_vol = 0;
-	min_vol_ever = 0;
-	max_vol_ever = 0;
+        monitor_init(&mon);
     }
 
-    void update() {
-        audio_block_t *in = receiveReadOnly(0);
-        if (in == NULL) {
-            return;
-        }
-
-	for (int i=0; i<AUDIO_BLOCK_SAMPLES; i++) {
-	    int16_t v = in->data[i];
-	    if (v < min_vol) {
-		min_vol = v;
-		if (v < min_vol_ever) {
-		    min_vol_ever = v;
-		}
-	    }
-	    if (v > max_vol) {
-		max_vol = v;
-		if (v > max_vol_ever) {
-		    max_vol_ever = v;
-		}
-	    }
-	}
-
-        transmit(in, 0);
-        release(in);
+    // setHistogram enables the 16 bucket log-magnitude histogram,
+    // which costs a little more per block.
+    void setHistogram(bool enabled) {
+        monitor_set_histogram(&mon, enabled);
     }
 
+    // reset clears the levels reported in snapshot's interval.
     void reset() {
-	min_vol = 0;
-	max_vol = 0;
+        monitor_reset(&mon);
+    }
+
+    // snapshot copies all of the current levels at once. Prefer this
+    // to the volumeUsage accessors when reporting several values.
+    void snapshot(monitor_snapshot *snap) {
+        monitor_read(&mon, snap);
     }
 
     int volumeUsageMin() {
-	return min_vol;
+        monitor_snapshot snap;
+        snapshot(&snap);
+        return snap.interval.min;
     }
 
     int volumeUsageMax() {
-	return max_vol;
+        monitor_snapshot snap;
+        snapshot(&snap);
+        return snap.interval.max;
     }
 
     int volumeUsageMinEver() {
-	return max_vol_ever;
+        monitor_snapshot snap;
+        snapshot(&snap);
+        return snap.ever.min;
     }
 
     int volumeUsageMaxEver() {
-	return max_vol_ever;
+        monitor_snapshot snap;
+        snapshot(&snap);
+        return snap.ever.max;
     }
 
-  private:
-    int min_vol;
-    int max_vol;
-    int min_vol_ever;
-    int max_vol_ever;
+    monitor mon;
+};
 
+class Monitor : public AudioStream, public MonitorCore {
+  public:
+    Monitor() : AudioStream(1, inputQueueArray) {
+    }
+
+    void update() {
+        audio_block_t *in = receiveReadOnly(0);
+        if (in == NULL) {
+            return;
+        }
+
+        monitor_update(&mon, in->data, AUDIO_BLOCK_SAMPLES);
+        release(in);
+    }
+
+  private:
     audio_block_t *inputQueueArray[1];
 };
 
@@ -0,0 +1,151 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifdef ROTO_TEST
+
+#include <string.h>
+
+#include "greatest.h"
+
+#include "monitor.h"
+
+TEST test_monitor_min_max() {
+    monitor m;
+    monitor_init(&m);
+
+    int16_t block[4] = {100, -200, 300, -50};
+    monitor_update(&m, block, 4);
+
+    monitor_snapshot snap;
+    monitor_read(&m, &snap);
+
+    ASSERT_EQ_FMT(-200, snap.block.min, "%d");
+    ASSERT_EQ_FMT(300, snap.block.max, "%d");
+    ASSERT_EQ_FMT(-200, snap.ever.min, "%d");
+    ASSERT_EQ_FMT(300, snap.ever.max, "%d");
+    ASSERT_EQ_FMT(4, snap.ever.samples, "%d");
+
+    PASS();
+}
+
+TEST test_monitor_rms() {
+    monitor m;
+    monitor_init(&m);
+
+    // A square wave's RMS is its amplitude.
+    int16_t block[8] = {1000, -1000, 1000, -1000, 1000, -1000, 1000, -1000};
+    monitor_update(&m, block, 8);
+
+    monitor_snapshot snap;
+    monitor_read(&m, &snap);
+    ASSERT_EQ_FMT(1000, monitor_rms(&snap.block), "%d");
+
+    PASS();
+}
+
+TEST test_monitor_clips() {
+    monitor m;
+    monitor_init(&m);
+
+    int16_t block[6] = {32767, -32768, -32767, 32766, 0, -32766};
+    monitor_update(&m, block, 6);
+    monitor_update(&m, block, 6);
+
+    monitor_snapshot snap;
+    monitor_read(&m, &snap);
+    ASSERT_EQ_FMT(3, snap.block.clips, "%d");
+    ASSERT_EQ_FMT(6, snap.ever.clips, "%d");
+
+    PASS();
+}
+
+// test_monitor_true_peak ensures a sine sampled away from its crests
+// reports a peak above its largest sample.
+TEST test_monitor_true_peak() {
+    monitor m;
+    monitor_init(&m);
+
+    // fs/4 sine of amplitude 20000, sampled 45 degrees off its peaks.
+    int16_t block[16];
+    for (int i = 0; i < 16; i += 4) {
+        block[i] = 14142;
+        block[i + 1] = 14142;
+        block[i + 2] = -14142;
+        block[i + 3] = -14142;
+    }
+    monitor_update(&m, block, 16);
+
+    monitor_snapshot snap;
+    monitor_read(&m, &snap);
+    ASSERT_EQ_FMT(14142, snap.block.max, "%d");
+    ASSERTm("true peak not above sample peak", snap.block.peak > 14142);
+    ASSERTm("true peak overshoot", snap.block.peak <= 20000);
+
+    PASS();
+}
+
+TEST test_monitor_histogram() {
+    monitor m;
+    monitor_init(&m);
+
+    int16_t block[6] = {0, 1, -1, 2, 1000, -32768};
+
+    // Off by default.
+    monitor_update(&m, block, 6);
+
+    monitor_snapshot snap;
+    monitor_read(&m, &snap);
+    for (int i = 0; i < MONITOR_HIST_LEN; i++) {
+        ASSERT_EQ_FMT(0, snap.block.hist[i], "%d");
+    }
+
+    monitor_set_histogram(&m, 1);
+    monitor_update(&m, block, 6);
+    monitor_read(&m, &snap);
+
+    ASSERT_EQ_FMT(1, snap.block.hist[0], "%d");  // 0
+    ASSERT_EQ_FMT(2, snap.block.hist[1], "%d");  // +/-1
+    ASSERT_EQ_FMT(1, snap.block.hist[2], "%d");  // 2
+    ASSERT_EQ_FMT(1, snap.block.hist[10], "%d"); // 1000
+    ASSERT_EQ_FMT(1, snap.block.hist[15], "%d"); // 32768
+
+    PASS();
+}
+
+TEST test_monitor_reset() {
+    monitor m;
+    monitor_init(&m);
+
+    int16_t loud[2] = {20000, -20000};
+    int16_t quiet[2] = {10, -10};
+
+    monitor_update(&m, loud, 2);
+    monitor_reset(&m);
+
+    // The reset is applied by the writer on its next update.
+    monitor_snapshot snap;
+    monitor_read(&m, &snap);
+    ASSERT_EQ_FMT(20000, snap.interval.max, "%d");
+
+    monitor_update(&m, quiet, 2);
+    monitor_read(&m, &snap);
+    ASSERT_EQ_FMT(10, snap.interval.max, "%d");
+    ASSERT_EQ_FMT(-10, snap.interval.min, "%d");
+    ASSERT_EQ_FMT(20000, snap.ever.max, "%d");
+    ASSERT_EQ_FMT(-20000, snap.ever.min, "%d");
+
+    // The sequence lock is even whenever no write is in progress.
+    ASSERT_EQ_FMT(0, m.seq & 1, "%d");
+
+    PASS();
+}
+
+GREATEST_SUITE(monitor_suite) {
+    RUN_TEST(test_monitor_min_max);
+    RUN_TEST(test_monitor_rms);
+    RUN_TEST(test_monitor_clips);
+    RUN_TEST(test_monitor_true_peak);
+    RUN_TEST(test_monitor_histogram);
+    RUN_TEST(test_monitor_reset);
+}
+
+#endif
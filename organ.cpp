@@ -0,0 +1,70 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "organ.h"
+#include "sample.h"
+
+void organ_init(organ_console *o) {
+    memset(o, 0, sizeof(organ_console));
+    o->mix[0] = ORGAN_GAIN_ONE;
+    o->mix[1] = ORGAN_GAIN_ONE;
+    o->swell = ORGAN_GAIN_ONE;
+}
+
+void organ_process(organ_console *o, int16_t *block, size_t len) {
+    int16_t perc[TONEWHEEL_OSC_BLOCK_MAX];
+
+    tonewheel_osc_fill(o->tonewheels, block, len);
+    if (o->monitor != NULL) {
+        monitor_update(o->monitor, block, len);
+    }
+
+    vibrato_fn vib = vibrato_select(o->vibrato);
+    if (vib != NULL) {
+        vib(o->vibrato, o->vibrato_ring, block, block, len);
+    } else {
+        vibrato_bypass(o->vibrato, o->vibrato_ring, block, len);
+    }
+
+    tonewheel_osc_fill(o->percussion, perc, len);
+    envelope_process(o->percussion_env, perc, len);
+
+    // Mix and swell. The mix saturates like an AudioMixer4's output
+    // before the swell scales it.
+    int32_t g0 = o->mix[0];
+    int32_t g1 = o->mix[1];
+    int32_t swell = o->swell;
+    for (size_t i = 0; i < len; i++) {
+        int32_t mix = sat16((block[i] * g0 + perc[i] * g1) >> 12);
+        block[i] = sat16((mix * swell) >> 12);
+    }
+}
+
+int organ_skip(organ_console *o, size_t len) {
+    if (!tonewheel_osc_silent(o->tonewheels) || !tonewheel_osc_silent(o->percussion) || !envelope_resting(o->percussion_env)) {
+        o->idle = 0;
+        return 0;
+    }
+
+    // The vibrato ring still holds the end of the last block. It
+    // would play out as a short blip when the next note starts, so
+    // clear it once.
+    if (!o->idle) {
+        memset(o->vibrato_ring, 0, VIBRATO_RING_LEN * sizeof(int16_t));
+        o->idle = 1;
+    }
+
+    tonewheel_osc_skip(o->tonewheels, len);
+    tonewheel_osc_skip(o->percussion, len);
+    vibrato_skip(o->vibrato, len);
+    return 1;
+}
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,70 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef ORGAN_H
+#define ORGAN_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "envelope.h"
+#include "monitor.h"
+#include "tonewheel_osc.h"
+#include "vibrato.h"
+
+// ORGAN_GAIN_ONE is unity for the mix and swell gains, which are Q12
+// so a swell of up to 8x fits.
+#define ORGAN_GAIN_ONE (1 << 12)
+
+// organ_console is the whole of roto's Hammond B-3 as one block of
+// work: the tonewheels through the vibrato scanner, the percussion
+// tonewheels through their envelope, mixed and sent through the swell
+// pedal. It does what the TonewheelOsc, Vibrato, AudioEffectEnvelope,
+// AudioMixer4 and AudioAmplifier nodes do, but keeps the block in one
+// buffer and a stack scratch instead of passing it through the audio
+// library's pool.
+//
+// The parts are owned elsewhere; organ_console only points at them.
+typedef struct _organ_console {
+    tonewheel_osc *tonewheels;
+    vibrato_scanner *vibrato;
+    int16_t *vibrato_ring;
+
+    // monitor, if not NULL, measures the tonewheels before the
+    // vibrato.
+    monitor *monitor;
+
+    tonewheel_osc *percussion;
+    envelope *percussion_env;
+
+    // mix holds the gains (Q12) of the tonewheels and the percussion,
+    // and swell the gain of their sum.
+    int32_t mix[2];
+    int32_t swell;
+
+    // idle is set while organ_skip is skipping blocks.
+    uint8_t idle;
+} organ_console;
+
+// organ_init points _o_ at nothing, with unity gains.
+void organ_init(organ_console *o);
+
+// organ_process renders _len_ samples, at most
+// TONEWHEEL_OSC_BLOCK_MAX, into _block_.
+void organ_process(organ_console *o, int16_t *block, size_t len);
+
+// organ_skip checks whether the next _len_ samples are silence: no
+// wheel is sounding or about to, and the percussion envelope is at
+// rest. If so it moves the clocks and the vibrato scanner past them
+// and returns nonzero, and the block needn't be rendered or sent at
+// all. Otherwise it returns 0; call organ_process.
+int organ_skip(organ_console *o, size_t len);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
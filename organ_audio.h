@@ -0,0 +1,73 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef ORGAN_AUDIO_H
+#define ORGAN_AUDIO_H
+
+#include <Audio.h>
+
+#include "envelope_audio.h"
+#include "mixer_audio.h"
+#include "monitor_audio.h"
+#include "organ.h"
+#include "tonewheel_osc_audio.h"
+#include "vibrato_audio.h"
+
+// Organ is the Hammond B-3 half of roto's graph in a single node:
+// tonewheels, monitor, vibrato, percussion, percussion envelope,
+// mixer and swell. Its members have the same controls as the nodes
+// they replace, so the sketch can bind its old names to them.
+//
+// The separate graph allocates a block for each of the tonewheels,
+// vibrato, percussion, envelope, mixer and swell every cycle; Organ
+// allocates one.
+class Organ : public AudioStream {
+  public:
+    Organ() : AudioStream(0, NULL), organOut(console.mix, 2), swell(&console.swell) {
+        organ_init(&console);
+        console.vibrato = &vibrato.vib;
+        console.vibrato_ring = vibrato.buf;
+        console.monitor = &tonewheelsMonitor.mon;
+        console.percussion_env = &percussionEnv.env;
+    }
+
+    void update() {
+        // The oscillators are created by their init().
+        if (tonewheels.osc == NULL || percussion.osc == NULL) {
+            return;
+        }
+        console.tonewheels = tonewheels.osc;
+        console.percussion = percussion.osc;
+
+        // Silence isn't sent: the Leslie treats no block as zeros.
+        if (organ_skip(&console, AUDIO_BLOCK_SAMPLES)) {
+            return;
+        }
+
+        audio_block_t *block = allocate();
+        if (block == NULL) {
+            return;
+        }
+
+        organ_process(&console, block->data, AUDIO_BLOCK_SAMPLES);
+
+        transmit(block, 0);
+        release(block);
+    }
+
+  private:
+    // console is first so it's set up before the gains bind to it.
+    organ_console console;
+
+  public:
+    TonewheelOscCore tonewheels;
+    MonitorCore tonewheelsMonitor;
+    VibratoCore vibrato;
+
+    TonewheelOscCore percussion;
+    EnvelopeCore percussionEnv;
+
+    MixerGains organOut;
+    AmplifierGain swell;
+};
+
+#endif
@@ -0,0 +1,229 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifdef ROTO_TEST
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "greatest.h"
+
+#include "organ.h"
+#include "preamp.h"
+#include "sample.h"
+
+// organ_test_parts is everything an organ_console points at.
+typedef struct {
+    tonewheel_osc *tonewheels;
+    vibrato_scanner vib;
+    int16_t ring[VIBRATO_RING_LEN];
+    monitor mon;
+    tonewheel_osc *percussion;
+    envelope env;
+} organ_test_parts;
+
+static void organ_test_parts_init(organ_test_parts *p) {
+    memset(p, 0, sizeof(organ_test_parts));
+    p->tonewheels = tonewheel_osc_new();
+    p->percussion = tonewheel_osc_new();
+    tonewheel_osc_set_volume(p->tonewheels, 13, 20000);
+    tonewheel_osc_set_volume(p->tonewheels, 49, 30000);
+    tonewheel_osc_set_volume(p->percussion, 61, 40000);
+
+    vibrato_init(&p->vib, 2, 1);
+    monitor_init(&p->mon);
+
+    envelope_init(&p->env, 44100);
+    envelope_set(&p->env, 0, envelope_samples(0.1, 44100), 0, envelope_samples(300, 44100), 0, 0);
+    envelope_note_on(&p->env);
+}
+
+// test_organ_matches_nodes ensures the fused organ renders the same
+// samples as its parts run one after another, as the separate nodes
+// would.
+TEST test_organ_matches_nodes() {
+    static organ_test_parts fused, nodes;
+    organ_test_parts_init(&fused);
+    organ_test_parts_init(&nodes);
+
+    organ_console o;
+    organ_init(&o);
+    o.tonewheels = fused.tonewheels;
+    o.vibrato = &fused.vib;
+    o.vibrato_ring = fused.ring;
+    o.monitor = &fused.mon;
+    o.percussion = fused.percussion;
+    o.percussion_env = &fused.env;
+    o.mix[1] = ORGAN_GAIN_ONE / 2;
+    o.swell = ORGAN_GAIN_ONE * 5 / 2;
+
+    int16_t got[128], want[128], perc[128];
+    for (int b = 0; b < 20; b++) {
+        organ_process(&o, got, 128);
+
+        tonewheel_osc_fill(nodes.tonewheels, want, 128);
+        monitor_update(&nodes.mon, want, 128);
+        vibrato_select(&nodes.vib)(&nodes.vib, nodes.ring, want, want, 128);
+        tonewheel_osc_fill(nodes.percussion, perc, 128);
+        envelope_process(&nodes.env, perc, 128);
+        for (int i = 0; i < 128; i++) {
+            int32_t mix = sat16((want[i] * 4096 + perc[i] * 2048) >> 12);
+            want[i] = sat16((mix * 10240) >> 12);
+        }
+
+        ASSERT_MEM_EQ(want, got, sizeof(want));
+    }
+
+    monitor_snapshot got_snap, want_snap;
+    monitor_read(&fused.mon, &got_snap);
+    monitor_read(&nodes.mon, &want_snap);
+    ASSERT_EQ_FMT(want_snap.ever.max, got_snap.ever.max, "%d");
+
+    free(fused.tonewheels);
+    free(fused.percussion);
+    free(nodes.tonewheels);
+    free(nodes.percussion);
+    PASS();
+}
+
+// test_organ_no_monitor ensures the monitor is optional.
+TEST test_organ_no_monitor() {
+    static organ_test_parts parts;
+    organ_test_parts_init(&parts);
+
+    organ_console o;
+    organ_init(&o);
+    o.tonewheels = parts.tonewheels;
+    o.vibrato = &parts.vib;
+    o.vibrato_ring = parts.ring;
+    o.percussion = parts.percussion;
+    o.percussion_env = &parts.env;
+
+    int16_t block[128];
+    organ_process(&o, block, 128);
+
+    int peak = 0;
+    for (int i = 0; i < 128; i++) {
+        peak = abs(block[i]) > peak ? abs(block[i]) : peak;
+    }
+    ASSERT(peak > 0);
+
+    free(parts.tonewheels);
+    free(parts.percussion);
+    PASS();
+}
+
+// test_organ_skip ensures the console skips blocks once its keys are
+// up and the percussion has faded, and that the vibrato scanner keeps
+// moving meanwhile.
+TEST test_organ_skip() {
+    static organ_test_parts parts;
+    organ_test_parts_init(&parts);
+
+    organ_console o;
+    organ_init(&o);
+    o.tonewheels = parts.tonewheels;
+    o.vibrato = &parts.vib;
+    o.vibrato_ring = parts.ring;
+    o.percussion = parts.percussion;
+    o.percussion_env = &parts.env;
+
+    int16_t block[128];
+    ASSERT_FALSE(organ_skip(&o, 128));
+    organ_process(&o, block, 128);
+    ASSERT_FALSE(organ_skip(&o, 128));
+
+    tonewheel_osc_set_volume(parts.tonewheels, 13, 0);
+    tonewheel_osc_set_volume(parts.tonewheels, 49, 0);
+    tonewheel_osc_set_volume(parts.percussion, 61, 0);
+    envelope_note_off(&parts.env);
+    ASSERT_FALSE(organ_skip(&o, 128));
+    organ_process(&o, block, 128);
+    ASSERT(organ_skip(&o, 128));
+    for (int i = 0; i < VIBRATO_RING_LEN; i++) {
+        ASSERT_EQ_FMT(0, parts.ring[i], "%d");
+    }
+
+    uint32_t clock = parts.tonewheels->clock;
+    uint32_t scan = parts.vib.scan_phase;
+    ASSERT(organ_skip(&o, 128));
+    ASSERT_EQ_FMT(clock + 128, parts.tonewheels->clock, "%u");
+    ASSERT(parts.vib.scan_phase != scan);
+
+    // A key wakes it up.
+    tonewheel_osc_set_volume(parts.tonewheels, 49, 30000);
+    ASSERT_FALSE(organ_skip(&o, 128));
+    organ_process(&o, block, 128);
+
+    int peak = 0;
+    for (int i = 0; i < 128; i++) {
+        peak = abs(block[i]) > peak ? abs(block[i]) : peak;
+    }
+    ASSERT(peak > 0);
+
+    free(parts.tonewheels);
+    free(parts.percussion);
+    PASS();
+}
+
+// test_organ_recall recalls a whole registration the way roto does:
+// every changed wheel as one set of ramps, and a new preamp curve. One
+// block later all of it has taken effect, even with keyclick contacts
+// queued ahead of it.
+TEST test_organ_recall() {
+    static organ_test_parts parts;
+    static int16_t table[PREAMP_TABLE_LEN + 1], recalled[PREAMP_TABLE_LEN + 1];
+    organ_test_parts_init(&parts);
+
+    organ_console o;
+    organ_init(&o);
+    o.tonewheels = parts.tonewheels;
+    o.vibrato = &parts.vib;
+    o.vibrato_ring = parts.ring;
+    o.percussion = parts.percussion;
+    o.percussion_env = &parts.env;
+
+    preamp_curve pre;
+    preamp_init(&pre);
+    preamp_fill_table(table, 1);
+    preamp_fill_table(recalled, 5);
+    preamp_set_table(&pre, table);
+
+    int16_t block[128];
+    organ_process(&o, block, 128);
+    preamp_process(&pre, block, block, 128);
+
+    // A key's contacts close over the next two blocks.
+    uint32_t now = parts.tonewheels->clock;
+    for (int i = 0; i < 9; i++) {
+        ASSERT(tonewheel_osc_schedule(parts.tonewheels, now + 128 + i * 20, 30 + i, 5000));
+    }
+
+    uint16_t volumes[92] = {0};
+    uint32_t wheels[3] = {0};
+    for (int t = 1; t < 92; t += 2) {
+        volumes[t] = (uint16_t)(1000 + t);
+        wheels[t >> 5] |= 1 << (t & 31);
+    }
+    ASSERT(tonewheel_osc_schedule_ramps(parts.tonewheels, now, volumes, wheels));
+    preamp_set_table(&pre, recalled);
+
+    organ_process(&o, block, 128);
+    preamp_process(&pre, block, block, 128);
+    for (int t = 1; t < 92; t += 2) {
+        ASSERT_EQ_FMT(volumes[t], parts.tonewheels->volumes[t], "%d");
+    }
+    ASSERT_EQ(recalled, pre.table);
+
+    free(parts.tonewheels);
+    free(parts.percussion);
+    PASS();
+}
+
+GREATEST_SUITE(organ_suite) {
+    RUN_TEST(test_organ_matches_nodes);
+    RUN_TEST(test_organ_no_monitor);
+    RUN_TEST(test_organ_skip);
+    RUN_TEST(test_organ_recall);
+}
+
+#endif
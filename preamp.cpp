@@ -0,0 +1,77 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include "preamp.h"
+
+void preamp_init(preamp_curve *p) {
+    p->table = NULL;
+    p->next = NULL;
+}
+
+void preamp_fill_table(int16_t table[PREAMP_TABLE_LEN + 1], float k) {
+    if (k <= 0) {
+        k = 0.0001;
+    }
+
+    float scale = 32767.0f / atanf(k);
+    for (int i = 0; i <= PREAMP_TABLE_LEN; i++) {
+        float x = (float)(i - PREAMP_TABLE_LEN / 2) / (PREAMP_TABLE_LEN / 2);
+        table[i] = (int16_t)lrintf(atanf(k * x) * scale);
+    }
+}
+
+void preamp_set_table(preamp_curve *p, const int16_t *table) {
+    p->next = table;
+}
+
+// preamp_lookup interpolates _table_ at _x_.
+static inline int32_t preamp_lookup(const int16_t *table, int32_t x) {
+    uint32_t index = (uint32_t)(x + 32768);
+    uint32_t i = index >> (16 - PREAMP_TABLE_BITS);
+    int32_t frac = index & ((1 << (16 - PREAMP_TABLE_BITS)) - 1);
+
+    int32_t a = table[i];
+    int32_t b = table[i + 1];
+    return a + (((b - a) * frac) >> (16 - PREAMP_TABLE_BITS));
+}
+
+void preamp_process(preamp_curve *p, const int16_t *in, int16_t *out, size_t len) {
+    const int16_t *table = p->table;
+    const int16_t *next = p->next;
+
+    if (next != table && table != NULL && len > 0) {
+        // Crossfade to the new curve across this block.
+        int32_t fade = 0;
+        int32_t fade_incr = 32768 / len;
+        for (size_t i = 0; i < len; i++) {
+            int32_t a = preamp_lookup(table, in[i]);
+            int32_t b = preamp_lookup(next, in[i]);
+            out[i] = a + (((b - a) * fade) >> 15);
+            fade += fade_incr;
+        }
+        p->table = next;
+        return;
+    }
+
+    p->table = table = next;
+    if (table == NULL) {
+        if (out != in) {
+            memcpy(out, in, sizeof(int16_t) * len);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        out[i] = preamp_lookup(table, in[i]);
+    }
+}
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,48 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef PREAMP_H
+#define PREAMP_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The preamp's transfer curve is a table of PREAMP_TABLE_LEN + 1
+// points across the int16 range, interpolated linearly. 1024
+// segments keep the curve within about 20 LSB of atan at the highest
+// drive, at 2kB a table.
+#define PREAMP_TABLE_BITS (10)
+#define PREAMP_TABLE_LEN (1 << PREAMP_TABLE_BITS)
+
+// preamp_curve is the Leslie preamp distortion: y(n) = atan(k*x(n)) /
+// atan(k), read from a table built by preamp_fill_table.
+//
+// Tables are owned by the caller and switched with preamp_set_table,
+// which takes effect at the start of the next block: that block
+// crossfades from the old curve to the new one, so a change in drive
+// doesn't click. A table must stay untouched while it's current or
+// next.
+typedef struct _preamp_curve {
+    const int16_t *table;
+    const int16_t *volatile next;
+} preamp_curve;
+
+// preamp_init starts with no table, which passes audio through until
+// one is set.
+void preamp_init(preamp_curve *p);
+
+// preamp_fill_table fills _table_ with the curve for drive _k_.
+void preamp_fill_table(int16_t table[PREAMP_TABLE_LEN + 1], float k);
+
+void preamp_set_table(preamp_curve *p, const int16_t *table);
+
+void preamp_process(preamp_curve *p, const int16_t *in, int16_t *out, size_t len);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
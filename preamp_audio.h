@@ -4,65 +4,80 @@
 #define PREAMP_AUDIO_H
 
 #include <Audio.h>
-#include <math.h>
+
+#include "preamp.h"
 
 // Simulate the Leslie preamp. I got this from here:
 // http://www.willpirkle.com/Downloads/Rotary%20Speaker%20Sim%20App%20Note.pdf
 //
 // There's a link to a book for the equation, but I haven't read it.
 
-// Preamp implements the preamp distortion of a Leslie speaker cabinet.
-class Preamp : public AudioStream {
+// PreampCore holds the preamp distortion of a Leslie speaker cabinet
+// and its controls, without an AudioStream, so the Leslie node can
+// own one.
+class PreampCore {
   public:
-    Preamp() : AudioStream(1, inputQueueArray) {
+    PreampCore() {
+        preamp_init(&pre);
     }
 
+    // setK builds the curve for drive _k_ and switches to it at the
+    // next block. It costs about a thousand atanf calls; use setTable
+    // with a table built ahead of time where that's too slow.
     void setK(float k) {
-        if (k <= 0) {
-            k = 0.0001;
-        }
+        setTable(buildTable(k));
+    }
 
-        // y(n) = atan(k*x(n)) / atan(k)
-        float invAtank = 1.0 / atan(k) * (float)(1 << 15);
-        for (int i = 0; i < 65536; i++) {
-            float kscale = k / (float)(1 << 15);
-            lookup[i] = atan((float)(i - 32768) * kscale) * invAtank;
+    // buildTable fills a table that's neither current nor next with
+    // the curve for drive _k_, without switching to it. Pass it to
+    // setTable before the next buildTable call, which may reuse it.
+    const int16_t *buildTable(float k) {
+        // One of the three tables is always neither current nor next.
+        int16_t *table = tables[0];
+        for (int i = 0; i < 3; i++) {
+            if (tables[i] != pre.table && tables[i] != pre.next) {
+                table = tables[i];
+                break;
+            }
         }
+
+        preamp_fill_table(table, k);
+        return table;
     }
 
-    void update(void) {
-        audio_block_t *in = receiveReadOnly(0);
-        if (in == NULL) {
-            return;
-        }
+    // setTable switches to a curve from preamp_fill_table at the next
+    // block. _table_ must stay untouched while it's in use.
+    void setTable(const int16_t *table) {
+        preamp_set_table(&pre, table);
+    }
 
-        audio_block_t *out = allocate();
-        if (out == NULL) {
-            release(in);
-            return;
-        }
+    preamp_curve pre;
 
-        int16_t *src = in->data;
-        int16_t *dst = out->data;
-        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
-            int32_t index = (int32_t)(src[i]) + 32768;
+  private:
+    int16_t tables[3][PREAMP_TABLE_LEN + 1];
+};
 
-            if (index < 0) {
-                index = 0;
-            } else if (index > 65535) {
-                index = 65535;
-            }
-            dst[i] = lookup[index];
+// Preamp implements the preamp distortion of a Leslie speaker cabinet.
+class Preamp : public AudioStream, public PreampCore {
+  public:
+    Preamp() : AudioStream(1, inputQueueArray) {
+    }
+
+    void update(void) {
+        // Preamp is the swell's only consumer, so the block is
+        // processed in place without a copy.
+        audio_block_t *block = receiveWritable(0);
+        if (block == NULL) {
+            return;
         }
 
-        transmit(out, 0);
-        release(out);
-        release(in);
+        preamp_process(&pre, block->data, block->data, AUDIO_BLOCK_SAMPLES);
+
+        transmit(block, 0);
+        release(block);
     }
 
   private:
-    int16_t lookup[65536];
-
     audio_block_t *inputQueueArray[1];
 };
 
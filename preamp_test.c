@@ -0,0 +1,88 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifdef ROTO_TEST
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "greatest.h"
+
+#include "preamp.h"
+
+// test_preamp_curve ensures the interpolated table stays close to
+// atan at the highest drive the organ uses.
+TEST test_preamp_curve() {
+    static int16_t table[PREAMP_TABLE_LEN + 1];
+    float k = 50;
+    preamp_fill_table(table, k);
+    ASSERT_EQ_FMT(-32767, table[0], "%d");
+    ASSERT_EQ_FMT(0, table[PREAMP_TABLE_LEN / 2], "%d");
+    ASSERT_EQ_FMT(32767, table[PREAMP_TABLE_LEN], "%d");
+
+    preamp_curve p;
+    preamp_init(&p);
+    preamp_set_table(&p, table);
+
+    static int16_t in[1024], out[1024];
+    int max_err = 0;
+    for (int32_t x = -32768; x < 32768; x += 1024) {
+        for (int i = 0; i < 1024; i++) {
+            in[i] = x + i;
+        }
+        preamp_process(&p, in, out, 1024);
+        for (int i = 0; i < 1024; i++) {
+            int want = (int)lrintf(atanf(k * in[i] / 32768.0f) * 32767.0f / atanf(k));
+            int err = abs(want - out[i]);
+            max_err = err > max_err ? err : max_err;
+        }
+    }
+
+    // Measured at 17.
+    ASSERT_IN_RANGE(0, max_err, 24);
+
+    PASS();
+}
+
+// test_preamp_crossfade ensures a new table fades in across one block.
+TEST test_preamp_crossfade() {
+    static int16_t soft[PREAMP_TABLE_LEN + 1], hard[PREAMP_TABLE_LEN + 1];
+    preamp_fill_table(soft, 1);
+    preamp_fill_table(hard, 50);
+
+    // With no table, audio passes through.
+    preamp_curve p;
+    preamp_init(&p);
+    int16_t in[128], out[128];
+    for (int i = 0; i < 128; i++) {
+        in[i] = 4000;
+    }
+    preamp_process(&p, in, out, 128);
+    ASSERT_EQ_FMT(4000, out[0], "%d");
+
+    // The first table is used as is.
+    preamp_set_table(&p, soft);
+    preamp_process(&p, in, out, 128);
+    int lo = out[0];
+    ASSERT(lo > 4000 && lo < 6000);
+
+    preamp_set_table(&p, hard);
+    preamp_process(&p, in, out, 128);
+    ASSERT_EQ_FMT(lo, out[0], "%d");
+    for (int i = 1; i < 128; i++) {
+        ASSERT(out[i] >= out[i - 1]);
+    }
+
+    preamp_process(&p, in, out, 128);
+    int hi = out[0];
+    ASSERT(hi > 20000);
+    ASSERT_EQ(hard, p.table);
+
+    PASS();
+}
+
+GREATEST_SUITE(preamp_suite) {
+    RUN_TEST(test_preamp_curve);
+    RUN_TEST(test_preamp_crossfade);
+}
+
+#endif
@@ -0,0 +1,173 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__arm__)
+// Cortex-M debug registers.
+#define DEMCR (*(volatile uint32_t *)0xE000EDFC)
+#define DEMCR_TRCENA (1 << 24)
+#define DWT_CTRL (*(volatile uint32_t *)0xE0001000)
+#define DWT_CTRL_CYCCNTENA (1 << 0)
+#define DWT_CYCCNT (*(volatile uint32_t *)0xE0001004)
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+#include "profile.h"
+
+#define profile_barrier() __sync_synchronize()
+
+static uint32_t profile_budget = 0;
+static profile *profile_list = NULL;
+
+uint32_t profile_cycles(void) {
+#if defined(__arm__)
+    return DWT_CYCCNT;
+#elif defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#endif
+}
+
+void profile_cycles_enable(void) {
+#if defined(__arm__)
+    DEMCR |= DEMCR_TRCENA;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+#endif
+}
+
+void profile_init(profile *p, const char *name) {
+    memset(p, 0, sizeof(profile));
+    p->name = name;
+    p->min = UINT32_MAX;
+}
+
+void profile_set_budget(uint32_t cycles) {
+    profile_budget = cycles;
+}
+
+void profile_register(profile *p) {
+    p->next = profile_list;
+    profile_list = p;
+}
+
+void profile_reset(profile *p) {
+    p->reset_req = 1;
+}
+
+void profile_record(profile *p, uint32_t cycles) {
+    p->seq++;
+    profile_barrier();
+
+    if (p->reset_req) {
+        p->reset_req = 0;
+        p->min = UINT32_MAX;
+        p->max = 0;
+        p->sum = 0;
+        p->count = 0;
+        p->over = 0;
+    }
+
+    p->min = cycles < p->min ? cycles : p->min;
+    p->max = cycles > p->max ? cycles : p->max;
+    p->sum += cycles;
+    p->over += (profile_budget != 0 && cycles > profile_budget);
+    p->ring[p->count & (PROFILE_RING_LEN - 1)] = cycles;
+    p->count++;
+
+    profile_barrier();
+    p->seq++;
+}
+
+void profile_read(profile *p, profile_stats *stats) {
+    profile copy;
+    uint32_t seq;
+    do {
+        seq = p->seq;
+        profile_barrier();
+        memcpy(&copy, p, sizeof(profile));
+        profile_barrier();
+    } while ((seq & 1) || seq != p->seq);
+
+    memset(stats, 0, sizeof(profile_stats));
+    if (copy.count == 0) {
+        return;
+    }
+
+    stats->count = copy.count;
+    stats->min = copy.min;
+    stats->max = copy.max;
+    stats->mean = (uint32_t)(copy.sum / copy.count);
+    stats->over = copy.over;
+
+    // Unroll the ring, oldest first.
+    uint32_t n = copy.count < PROFILE_RING_LEN ? copy.count : PROFILE_RING_LEN;
+    for (uint32_t i = 0; i < n; i++) {
+        stats->recent[i] = copy.ring[(copy.count - n + i) & (PROFILE_RING_LEN - 1)];
+    }
+
+    // p99 of the ring: insertion sort a copy and take the sample
+    // that 99% of blocks are at or below.
+    uint32_t sorted[PROFILE_RING_LEN];
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t v = stats->recent[i];
+        uint32_t j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+    stats->p99 = sorted[(n * 99 + 99) / 100 - 1];
+}
+
+int profile_format(const char *name, const profile_stats *stats, char *buf, size_t buf_len) {
+    return snprintf(buf, buf_len, "%s: n=%lu min=%lu mean=%lu p99=%lu max=%lu over=%lu",
+                    name,
+                    (unsigned long)stats->count,
+                    (unsigned long)stats->min,
+                    (unsigned long)stats->mean,
+                    (unsigned long)stats->p99,
+                    (unsigned long)stats->max,
+                    (unsigned long)stats->over);
+}
+
+void profile_dump(void (*write)(const char *line, void *ctx), void *ctx, int recent) {
+    // profile_stats is too big for some stacks; there is only one
+    // dumper so a static is fine.
+    static profile_stats stats;
+    char line[128];
+
+    for (profile *p = profile_list; p != NULL; p = p->next) {
+        profile_read(p, &stats);
+        profile_format(p->name, &stats, line, sizeof(line));
+        write(line, ctx);
+
+        if (!recent) {
+            continue;
+        }
+
+        uint32_t n = stats.count < PROFILE_RING_LEN ? stats.count : PROFILE_RING_LEN;
+        for (uint32_t i = 0; i < n; i += 8) {
+            int len = snprintf(line, sizeof(line), "  %s[-%lu]:", p->name, (unsigned long)(n - i));
+            for (uint32_t j = i; j < i + 8 && j < n && len < (int)sizeof(line); j++) {
+                len += snprintf(line + len, sizeof(line) - len, " %lu", (unsigned long)stats.recent[j]);
+            }
+            write(line, ctx);
+        }
+    }
+}
+
+#if defined(__cplusplus)
+}
+#endif
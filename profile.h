@@ -0,0 +1,92 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Each profile keeps the cycle counts of its last PROFILE_RING_LEN
+// blocks. This must be a power of two. At 128 samples per block, 128
+// blocks covers about 0.37s of audio.
+#ifndef PROFILE_RING_LEN
+#define PROFILE_RING_LEN (128)
+#endif
+
+// profile records the cycles spent in one section of code, usually
+// one AudioStream's update(). Like monitor, it has a single writer
+// (profile_record, called from the audio interrupt) and readers that
+// copy it through a sequence lock. Nothing is formatted on the
+// writer's side.
+typedef struct _profile {
+    const char *name;
+
+    volatile uint32_t seq;
+    volatile uint8_t reset_req;
+
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t count;
+
+    // over counts the blocks that took longer than the budget set
+    // with profile_set_budget.
+    uint32_t over;
+
+    uint32_t ring[PROFILE_RING_LEN];
+
+    struct _profile *next;
+} profile;
+
+// profile_stats is a summary of a profile, computed by the reader.
+// p99 is taken over the blocks still in the ring.
+typedef struct _profile_stats {
+    uint32_t count;
+    uint32_t min;
+    uint32_t mean;
+    uint32_t p99;
+    uint32_t max;
+    uint32_t over;
+
+    // recent holds the ring oldest first; only the last
+    // min(count, PROFILE_RING_LEN) entries are valid.
+    uint32_t recent[PROFILE_RING_LEN];
+} profile_stats;
+
+// profile_cycles returns a free running cycle counter: the DWT cycle
+// counter on Cortex-M, the TSC on x86 hosts and nanoseconds elsewhere.
+uint32_t profile_cycles(void);
+
+// profile_cycles_enable turns on the Cortex-M cycle counter. It does
+// nothing on hosts.
+void profile_cycles_enable(void);
+
+void profile_init(profile *p, const char *name);
+void profile_record(profile *p, uint32_t cycles);
+void profile_reset(profile *p);
+void profile_read(profile *p, profile_stats *stats);
+
+// profile_set_budget sets the per-block cycle budget used for the
+// over counts of every profile.
+void profile_set_budget(uint32_t cycles);
+
+// profile_register adds p to the list dumped by profile_dump.
+void profile_register(profile *p);
+
+// profile_format writes one line summarizing stats to buf.
+int profile_format(const char *name, const profile_stats *stats, char *buf, size_t buf_len);
+
+// profile_dump formats every registered profile, passing each line
+// to write. Call it from loop(), never from the audio path. If
+// recent is nonzero, each profile's ring follows its summary.
+void profile_dump(void (*write)(const char *line, void *ctx), void *ctx, int recent);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
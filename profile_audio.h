@@ -0,0 +1,43 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef PROFILE_AUDIO_H
+#define PROFILE_AUDIO_H
+
+#include <Audio.h>
+
+#include "profile.h"
+
+// Profiled wraps any AudioStream, timing each call to its update()
+// with the cycle counter. The wrapped node behaves exactly like the
+// original, so Profiled<AudioMixer4> can be used anywhere an
+// AudioMixer4 is.
+//
+// Recording costs a few dozen cycles per block; the summary and ring
+// are only formatted when profile_dump is called from loop().
+template <class T>
+class Profiled : public T {
+  public:
+    Profiled(const char *name) : T() {
+        profile_init(&prof, name);
+        profile_register(&prof);
+    }
+
+    void update(void) {
+        uint32_t start = profile_cycles();
+        T::update();
+        profile_record(&prof, profile_cycles() - start);
+    }
+
+    void profileStats(profile_stats *stats) {
+        profile_read(&prof, stats);
+    }
+
+    void profileReset() {
+        profile_reset(&prof);
+    }
+
+  private:
+    profile prof;
+};
+
+#endif
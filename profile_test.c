@@ -0,0 +1,128 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifdef ROTO_TEST
+
+#include <string.h>
+
+#include "greatest.h"
+
+#include "profile.h"
+
+TEST test_profile_stats() {
+    static profile p;
+    static profile_stats stats;
+    profile_init(&p, "test");
+
+    // 1..100 cycles.
+    for (uint32_t i = 1; i <= 100; i++) {
+        profile_record(&p, i);
+    }
+
+    profile_read(&p, &stats);
+    ASSERT_EQ_FMT(100, stats.count, "%d");
+    ASSERT_EQ_FMT(1, stats.min, "%d");
+    ASSERT_EQ_FMT(50, stats.mean, "%d");
+    ASSERT_EQ_FMT(99, stats.p99, "%d");
+    ASSERT_EQ_FMT(100, stats.max, "%d");
+
+    // Recent blocks are oldest first.
+    ASSERT_EQ_FMT(1, stats.recent[0], "%d");
+    ASSERT_EQ_FMT(100, stats.recent[99], "%d");
+
+    PASS();
+}
+
+// test_profile_ring ensures the ring keeps only the most recent
+// blocks, while min/mean/max cover everything since the reset.
+TEST test_profile_ring() {
+    static profile p;
+    static profile_stats stats;
+    profile_init(&p, "test");
+
+    profile_record(&p, 1000);
+    for (uint32_t i = 0; i < PROFILE_RING_LEN; i++) {
+        profile_record(&p, 10);
+    }
+
+    profile_read(&p, &stats);
+    ASSERT_EQ_FMT(1000, stats.max, "%d");
+    ASSERT_EQ_FMT(10, stats.p99, "%d");
+    for (uint32_t i = 0; i < PROFILE_RING_LEN; i++) {
+        ASSERT_EQ_FMT(10, stats.recent[i], "%d");
+    }
+
+    PASS();
+}
+
+TEST test_profile_budget() {
+    static profile p;
+    static profile_stats stats;
+    profile_init(&p, "test");
+
+    profile_set_budget(100);
+    profile_record(&p, 99);
+    profile_record(&p, 100);
+    profile_record(&p, 101);
+    profile_set_budget(0);
+    profile_record(&p, 1000);
+
+    profile_read(&p, &stats);
+    ASSERT_EQ_FMT(1, stats.over, "%d");
+
+    PASS();
+}
+
+TEST test_profile_reset() {
+    static profile p;
+    static profile_stats stats;
+    profile_init(&p, "test");
+
+    profile_record(&p, 1000);
+    profile_reset(&p);
+    profile_record(&p, 10);
+
+    profile_read(&p, &stats);
+    ASSERT_EQ_FMT(1, stats.count, "%d");
+    ASSERT_EQ_FMT(10, stats.max, "%d");
+
+    PASS();
+}
+
+TEST test_profile_format() {
+    static profile_stats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.count = 3;
+    stats.min = 1;
+    stats.mean = 2;
+    stats.p99 = 3;
+    stats.max = 4;
+    stats.over = 5;
+
+    char buf[128];
+    profile_format("vibrato", &stats, buf, sizeof(buf));
+    ASSERT_STR_EQ("vibrato: n=3 min=1 mean=2 p99=3 max=4 over=5", buf);
+
+    PASS();
+}
+
+TEST test_profile_cycles() {
+    uint32_t start = profile_cycles();
+    volatile int sink = 0;
+    for (int i = 0; i < 10000; i++) {
+        sink += i;
+    }
+    ASSERTm("cycle counter did not advance", profile_cycles() != start);
+
+    PASS();
+}
+
+GREATEST_SUITE(profile_suite) {
+    RUN_TEST(test_profile_stats);
+    RUN_TEST(test_profile_ring);
+    RUN_TEST(test_profile_budget);
+    RUN_TEST(test_profile_reset);
+    RUN_TEST(test_profile_format);
+    RUN_TEST(test_profile_cycles);
+}
+
+#endif
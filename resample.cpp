@@ -0,0 +1,73 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "resample.h"
+#include "sample.h"
+
+// The cubic midpoint taps, Q15: -1/16, 9/16, 9/16, -1/16.
+#define HALFBAND_OUTER (-2048)
+#define HALFBAND_INNER (18432)
+
+void halfband_init(halfband *hb) {
+    memset(hb, 0, sizeof(halfband));
+}
+
+void halfband_interpolate(halfband *hb, const int16_t *in, size_t in_len, int16_t *out) {
+    int32_t x0 = hb->hist[0];
+    int32_t x1 = hb->hist[1];
+    int32_t x2 = hb->hist[2];
+
+    for (size_t i = 0; i < in_len; i++) {
+        int32_t x3 = in[i];
+
+        int32_t mid = HALFBAND_OUTER * (x0 + x3) + HALFBAND_INNER * (x1 + x2);
+        out[2 * i] = sat16((mid + (1 << 14)) >> 15);
+        out[2 * i + 1] = x2;
+
+        x0 = x1;
+        x1 = x2;
+        x2 = x3;
+    }
+
+    hb->hist[0] = x0;
+    hb->hist[1] = x1;
+    hb->hist[2] = x2;
+}
+
+void polyphase4_init(polyphase4 *p) {
+    memset(p, 0, sizeof(polyphase4));
+}
+
+void polyphase4_interpolate(polyphase4 *p, const int16_t *in, size_t in_len, int16_t *out) {
+    int32_t x0 = p->last;
+
+    for (size_t i = 0; i < in_len; i++) {
+        int32_t x1 = in[i];
+        int32_t d = x1 - x0;
+
+        out[4 * i] = x0 + ((d + 4) >> 3);
+        out[4 * i + 1] = x0 + ((3 * d + 4) >> 3);
+        out[4 * i + 2] = x0 + ((5 * d + 4) >> 3);
+        out[4 * i + 3] = x0 + ((7 * d + 4) >> 3);
+
+        x0 = x1;
+    }
+
+    p->last = x0;
+}
+
+void decimate4(const int16_t *in, size_t in_len, int16_t *out) {
+    for (size_t i = 0; i < in_len / 4; i++) {
+        int32_t sum = in[4 * i] + in[4 * i + 1] + in[4 * i + 2] + in[4 * i + 3];
+        out[i] = (sum + 2) >> 2;
+    }
+}
+
+#if defined(__cplusplus)
+}
+#endif
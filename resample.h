@@ -0,0 +1,62 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// halfband is a 2x upsampler for signals well below the input's
+// Nyquist frequency. Each output pair is a 4-tap cubic midpoint
+// between two inputs, then the later of them; the images it leaves
+// are about 80dB down for content under 1/32 of the input rate.
+//
+// It delays its output by 1.5 input samples (3 output samples).
+typedef struct _halfband {
+    int16_t hist[3];
+} halfband;
+
+void halfband_init(halfband *hb);
+
+// halfband_interpolate writes 2 * _in_len_ samples to _out_. _out_
+// must not overlap _in_.
+void halfband_interpolate(halfband *hb, const int16_t *in, size_t in_len, int16_t *out);
+
+// polyphase4 is the 4x upsampler back from decimate4, for signals
+// far below the input's Nyquist frequency, like the crossover's bass.
+// Each input gives four outputs on the line from the one before it,
+// 1/8, 3/8, 5/8 and 7/8 of the way along: a 2-tap polyphase filter
+// whose taps are eighths, so it's shifts and adds, no multiplies. Its
+// images are sinc^2 shaped; for content at 1/50 of the input rate (the
+// drums' 220Hz) they're about 70dB down.
+//
+// It delays its output by 0.875 input samples (3.5 output samples),
+// so after decimate4 the round trip is a whole 2 samples.
+typedef struct _polyphase4 {
+    int16_t last;
+} polyphase4;
+
+void polyphase4_init(polyphase4 *p);
+
+// polyphase4_interpolate writes 4 * _in_len_ samples to _out_. _out_
+// must not overlap _in_.
+void polyphase4_interpolate(polyphase4 *p, const int16_t *in, size_t in_len, int16_t *out);
+
+// decimate4 writes _in_len_ / 4 samples to _out_, each the mean of
+// four inputs. That's only an anti-aliasing filter for signals that
+// are already lowpassed, like the crossover's bass: its nulls fall on
+// multiples of the output rate, which alias to DC. _in_len_ must be a
+// multiple of 4; _out_ may be _in_.
+//
+// Output i is centered on input 4i + 1.5.
+void decimate4(const int16_t *in, size_t in_len, int16_t *out);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
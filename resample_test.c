@@ -0,0 +1,124 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifdef ROTO_TEST
+
+#include "greatest.h"
+
+#include "resample.h"
+
+TEST test_halfband_dc() {
+    halfband hb;
+    halfband_init(&hb);
+
+    int16_t in[8] = {1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000};
+    int16_t out[16];
+    halfband_interpolate(&hb, in, 8, out);
+
+    // The first few outputs are still filling the history.
+    for (int i = 6; i < 16; i++) {
+        ASSERT_EQ_FMT(1000, out[i], "%d");
+    }
+
+    PASS();
+}
+
+// test_halfband_ramp ensures the midpoints of a straight line are
+// exact, and the output is delayed by 1.5 inputs.
+TEST test_halfband_ramp() {
+    halfband hb;
+    halfband_init(&hb);
+
+    int16_t in[16];
+    for (int i = 0; i < 16; i++) {
+        in[i] = 100 * i;
+    }
+
+    int16_t out[32];
+    halfband_interpolate(&hb, in, 16, out);
+    for (int i = 6; i < 32; i++) {
+        ASSERT_EQ_FMT(50 * (i - 3), out[i], "%d");
+    }
+
+    PASS();
+}
+
+TEST test_halfband_saturate() {
+    halfband hb;
+    halfband_init(&hb);
+
+    int16_t in[4] = {-32768, 32767, 32767, -32768};
+    int16_t out[8];
+    halfband_interpolate(&hb, in, 4, out);
+
+    // The midpoint between the two peaks overshoots.
+    ASSERT_EQ_FMT(32767, out[6], "%d");
+
+    PASS();
+}
+
+// test_polyphase4_ramp ensures the points along a straight line are
+// exact, and the output is delayed by 0.875 inputs.
+TEST test_polyphase4_ramp() {
+    polyphase4 p;
+    polyphase4_init(&p);
+
+    int16_t in[16];
+    for (int i = 0; i < 16; i++) {
+        in[i] = 200 * i;
+    }
+
+    int16_t out[64];
+    polyphase4_interpolate(&p, in, 16, out);
+    for (int i = 4; i < 64; i++) {
+        ASSERT_EQ_FMT(50 * i - 175, out[i], "%d");
+    }
+
+    PASS();
+}
+
+// test_polyphase4_range ensures full scale steps stay in range: each
+// output is between two inputs, so none needs saturating.
+TEST test_polyphase4_range() {
+    polyphase4 p;
+    polyphase4_init(&p);
+
+    int16_t in[4] = {-32768, 32767, 32767, -32768};
+    int16_t out[16];
+    polyphase4_interpolate(&p, in, 4, out);
+    for (int i = 4; i < 16; i++) {
+        int a = in[i / 4 - 1], b = in[i / 4];
+        ASSERT(out[i] >= (a < b ? a : b) && out[i] <= (a < b ? b : a));
+    }
+    ASSERT_EQ_FMT(-32768 + 8192, out[4], "%d");
+    ASSERT_EQ_FMT(32767 - 8192, out[12], "%d");
+
+    PASS();
+}
+
+// test_decimate4_ramp ensures each output is the mean of four inputs,
+// centered 1.5 inputs after the first.
+TEST test_decimate4_ramp() {
+    int16_t in[16];
+    for (int i = 0; i < 16; i++) {
+        in[i] = 100 * i;
+    }
+
+    int16_t out[4];
+    decimate4(in, 16, out);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ_FMT(100 * (4 * i) + 150, out[i], "%d");
+    }
+
+    PASS();
+}
+
+GREATEST_SUITE(resample_suite) {
+    RUN_TEST(test_halfband_dc);
+    RUN_TEST(test_halfband_ramp);
+    RUN_TEST(test_halfband_saturate);
+    RUN_TEST(test_polyphase4_ramp);
+    RUN_TEST(test_polyphase4_range);
+    RUN_TEST(test_decimate4_ramp);
+}
+
+#endif
@@ -0,0 +1,110 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "reverb.h"
+#include "sample.h"
+
+// Mutually prime delays between 12ms and 23ms at 44.1kHz.
+static const uint16_t reverb_lens[REVERB_LINES] = {557, 743, 877, 1013};
+
+// trunc_shift is x >> shift, rounded toward zero.
+static inline int32_t trunc_shift(int32_t x, int shift) {
+    return (x + ((x >> 31) & ((1 << shift) - 1))) >> shift;
+}
+
+void reverb_init(reverb *r) {
+    memset(r, 0, sizeof(reverb));
+    memcpy(r->lens, reverb_lens, sizeof(reverb_lens));
+
+    // Silent until reverb_set.
+    r->damping = r->damping_target = 32767;
+}
+
+void reverb_set(reverb *r, uint16_t feedback, uint16_t damping, uint16_t wet) {
+    r->feedback_target = feedback > 32767 ? 32767 : feedback;
+    r->damping_target = damping > 32767 ? 32767 : damping;
+    r->wet_target = wet > 32767 ? 32767 : wet;
+}
+
+void reverb_process(reverb *r, const int16_t *in_l, const int16_t *in_r, int16_t *out_l, int16_t *out_r, size_t len) {
+    const uint32_t mask = REVERB_LINE_LEN - 1;
+
+    // Block rate smoothing.
+    r->feedback += (r->feedback_target - r->feedback) / 8;
+    r->damping += (r->damping_target - r->damping) / 8;
+
+    int32_t wet = r->wet << 8;
+    int32_t wet_incr = ((r->wet_target << 8) - wet) / (int32_t)len;
+    r->wet = r->wet_target;
+
+    // Q14, so a full scale Hadamard sum times the feedback fits in
+    // 32 bits.
+    int32_t feedback = r->feedback >> 1;
+    int32_t damping = r->damping;
+    uint32_t wp = r->wp;
+    int32_t live = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        int32_t d[REVERB_LINES];
+        for (int j = 0; j < REVERB_LINES; j++) {
+            // The lowpass state is Q16 so it can settle all the way
+            // to zero.
+            int32_t x = (int32_t)r->lines[j][(wp - r->lens[j]) & mask] << 16;
+            int32_t s = r->damp_state[j];
+            s += (int32_t)(((int64_t)damping * (x - (int64_t)s)) >> 15);
+            r->damp_state[j] = s;
+            d[j] = trunc_shift(s, 16);
+        }
+
+        // Hadamard mix. Its 1/2 scale and the feedback are applied
+        // together, truncating toward zero so the tail always decays
+        // to silence.
+        int32_t a = d[0] + d[1];
+        int32_t b = d[0] - d[1];
+        int32_t c = d[2] + d[3];
+        int32_t e = d[2] - d[3];
+
+        int32_t dl = in_l[i] >> 1;
+        int32_t dr = in_r[i] >> 1;
+
+        int16_t w0 = sat16(trunc_shift((a + c) * feedback, 15) + dl);
+        int16_t w1 = sat16(trunc_shift((b + e) * feedback, 15) + dr);
+        int16_t w2 = sat16(trunc_shift((a - c) * feedback, 15) + dl);
+        int16_t w3 = sat16(trunc_shift((b - e) * feedback, 15) + dr);
+        r->lines[0][wp & mask] = w0;
+        r->lines[1][wp & mask] = w1;
+        r->lines[2][wp & mask] = w2;
+        r->lines[3][wp & mask] = w3;
+        live |= w0 | w1 | w2 | w3 | d[0] | d[1] | d[2] | d[3];
+
+        int32_t w = wet >> 8;
+        out_l[i] = sat16(in_l[i] + ((w * (d[0] + d[2])) >> 16));
+        out_r[i] = sat16(in_r[i] + ((w * (d[1] + d[3])) >> 16));
+
+        wet += wet_incr;
+        wp++;
+    }
+
+    r->wp = wp;
+
+    // Every read is from the last REVERB_LINE_LEN writes, so after
+    // that many quiet samples the lines are all zero.
+    if (live) {
+        r->quiet = 0;
+    } else if (r->quiet < REVERB_LINE_LEN) {
+        r->quiet += len;
+    }
+}
+
+int reverb_silent(const reverb *r) {
+    return r->quiet >= REVERB_LINE_LEN;
+}
+
+#if defined(__cplusplus)
+}
+#endif
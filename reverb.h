@@ -0,0 +1,74 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef REVERB_H
+#define REVERB_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The reverb has four delay lines. Each has a power of two buffer, so
+// reads and writes wrap with a mask.
+#define REVERB_LINES (4)
+#define REVERB_LINE_LEN (1024)
+
+// reverb is a small stereo feedback delay network: four delay lines
+// mixed through a Hadamard matrix, each with a one-pole lowpass to
+// darken the tail. It's all fixed point and allocation free, sized
+// for a Teensy:
+//
+// Memory: 8kB of delay lines (4 x 1024 x int16) plus about 40 bytes
+// of state. For comparison, each Preamp table is 2kB and a Preamp
+// keeps three; each AmFm rotor is about 1.8kB, a 256 byte ring and
+// three 257 entry int16 tables.
+//
+// Cycles: about 7k per 128 sample block on the host bench (make
+// bench). Expect 8-9k on a Cortex-M4, under 2% of a Teensy 3.6;
+// statusProfile() reports the real number.
+//
+// Parameters change at block rate. Each block, feedback and damping
+// move 1/8 of the way to their targets, and the wet level ramps
+// linearly across the block, so turning a knob doesn't zipper.
+typedef struct _reverb {
+    int16_t lines[REVERB_LINES][REVERB_LINE_LEN];
+    uint16_t lens[REVERB_LINES];
+    uint32_t wp;
+
+    // The Q16 state of each line's lowpass.
+    int32_t damp_state[REVERB_LINES];
+
+    // Q15 parameters and their targets.
+    int32_t feedback, feedback_target;
+    int32_t damping, damping_target;
+    int32_t wet, wet_target;
+
+    // quiet counts the samples since anything but zero was written to
+    // or read from a line.
+    uint32_t quiet;
+} reverb;
+
+void reverb_init(reverb *r);
+
+// reverb_set sets the targets for _feedback_ (the gain around each
+// line), _damping_ (the lowpass coefficient in each line; 32767 is no
+// damping) and _wet_ (the reverb level added to the dry signal), all
+// Q15.
+void reverb_set(reverb *r, uint16_t feedback, uint16_t damping, uint16_t wet);
+
+// reverb_process adds reverb to a block of stereo input. The outputs
+// may be the same buffers as the inputs.
+void reverb_process(reverb *r, const int16_t *in_l, const int16_t *in_r, int16_t *out_l, int16_t *out_r, size_t len);
+
+// reverb_silent returns nonzero once the tail has decayed all the way:
+// every line holds zeros, so silent input would come out silent. The
+// reverb needn't be run until its input returns.
+int reverb_silent(const reverb *r);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,118 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef REVERB_AUDIO_H
+#define REVERB_AUDIO_H
+
+#include <Audio.h>
+#include <math.h>
+
+#include "reverb.h"
+
+// Reverb is a small stereo room, cheap enough for the Teensy. Connect
+// the right and left Leslie microphones to inputs 0 and 1; outputs 0
+// and 1 are the same channels with the room added. See reverb.h for
+// its memory and CPU budget.
+class Reverb : public AudioStream {
+  public:
+    Reverb() : AudioStream(2, inputQueueArray) {
+    }
+
+    void init() {
+        reverb_init(&rev);
+        decaySec = 1.0;
+        dampingHz = 4000;
+        wetLevel = 0;
+        apply();
+    }
+
+    // decay sets the time for the tail to fall by 60dB.
+    void decay(float sec) {
+        decaySec = sec;
+        apply();
+    }
+
+    // damping sets the cutoff of the lowpass in each delay line;
+    // lower is a darker, softer room.
+    void damping(float hz) {
+        dampingHz = hz;
+        apply();
+    }
+
+    // wet sets the level of the room added to the dry signal, 0..1.
+    void wet(float level) {
+        wetLevel = level;
+        apply();
+    }
+
+    void update() {
+        audio_block_t *inR = receiveWritable(0);
+        audio_block_t *inL = receiveWritable(1);
+
+        // Once the room has died away too, silence is passed on as
+        // no blocks at all.
+        if (inR == NULL && inL == NULL && reverb_silent(&rev)) {
+            return;
+        }
+
+        // The room keeps ringing after its input stops.
+        if (inR == NULL) {
+            inR = allocate();
+            if (inR) {
+                memset(inR->data, 0, sizeof(inR->data));
+            }
+        }
+        if (inL == NULL) {
+            inL = allocate();
+            if (inL) {
+                memset(inL->data, 0, sizeof(inL->data));
+            }
+        }
+        if (inR == NULL || inL == NULL) {
+            if (inR) {
+                release(inR);
+            }
+            if (inL) {
+                release(inL);
+            }
+            return;
+        }
+
+        reverb_process(&rev, inL->data, inR->data, inL->data, inR->data, AUDIO_BLOCK_SAMPLES);
+
+        transmit(inR, 0);
+        transmit(inL, 1);
+        release(inR);
+        release(inL);
+    }
+
+  private:
+    // apply converts the float parameters to the reverb's Q15 targets.
+    // The reverb glides to them over the next few blocks.
+    void apply() {
+        // Each trip around the network takes the mean line length,
+        // about 18ms.
+        float trip = 797.5 / AUDIO_SAMPLE_RATE_EXACT;
+        float fb = decaySec > 0 ? powf(10.0, -3.0 * trip / decaySec) : 0;
+        float k = 1.0 - expf(-2.0 * M_PI * dampingHz / AUDIO_SAMPLE_RATE_EXACT);
+
+        reverb_set(&rev, toQ15(fb), toQ15(k), toQ15(wetLevel));
+    }
+
+    static uint16_t toQ15(float v) {
+        if (v <= 0) {
+            return 0;
+        } else if (v >= 1) {
+            return 32767;
+        }
+        return (uint16_t)(v * 32767);
+    }
+
+    reverb rev;
+    float decaySec;
+    float dampingHz;
+    float wetLevel;
+
+    audio_block_t *inputQueueArray[2];
+};
+
+#endif
@@ -0,0 +1,153 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifdef ROTO_TEST
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "greatest.h"
+
+#include "reverb.h"
+
+// reverb_energy returns the summed magnitude of _blocks_ blocks of
+// the reverb's response to silence.
+static int64_t reverb_energy(reverb *r, int blocks) {
+    int16_t zero[128] = {0};
+    int16_t l[128], rr[128];
+    int64_t sum = 0;
+    for (int b = 0; b < blocks; b++) {
+        reverb_process(r, zero, zero, l, rr, 128);
+        for (int i = 0; i < 128; i++) {
+            sum += abs(l[i]) + abs(rr[i]);
+        }
+    }
+    return sum;
+}
+
+static void reverb_impulse(reverb *r) {
+    int16_t in[128] = {0};
+    int16_t l[128], rr[128];
+    in[0] = 20000;
+    reverb_process(r, in, in, l, rr, 128);
+}
+
+TEST test_reverb_dry() {
+    static reverb r;
+    reverb_init(&r);
+
+    // With no wet level, the input passes through untouched.
+    int16_t in[128], l[128], rr[128];
+    for (int i = 0; i < 128; i++) {
+        in[i] = (i * 977) % 20000 - 10000;
+    }
+    reverb_process(&r, in, in, l, rr, 128);
+    ASSERT_MEM_EQ(in, l, sizeof(in));
+    ASSERT_MEM_EQ(in, rr, sizeof(in));
+
+    PASS();
+}
+
+// test_reverb_decay ensures the tail rings and dies away, and lasts
+// longer with more feedback.
+TEST test_reverb_decay() {
+    static reverb r;
+
+    reverb_init(&r);
+    reverb_set(&r, 26000, 20000, 16384);
+    reverb_energy(&r, 16); // let the parameters settle
+    reverb_impulse(&r);
+
+    // Once the echoes have built up, each stretch is quieter than the
+    // last.
+    reverb_energy(&r, 10);
+    int64_t early = reverb_energy(&r, 10);
+    int64_t late = reverb_energy(&r, 10);
+    ASSERT(early > 0);
+    ASSERT(late < early);
+
+    // Fixed point rounding doesn't leave it ringing forever.
+    reverb_energy(&r, 2000);
+    ASSERT_EQ(0, reverb_energy(&r, 10));
+
+    reverb_init(&r);
+    reverb_set(&r, 31000, 20000, 16384);
+    reverb_energy(&r, 16);
+    reverb_impulse(&r);
+    reverb_energy(&r, 20);
+    ASSERT(reverb_energy(&r, 10) > late);
+
+    PASS();
+}
+
+// test_reverb_smoothing ensures parameters glide to their targets
+// rather than jumping.
+TEST test_reverb_smoothing() {
+    static reverb r;
+    reverb_init(&r);
+
+    reverb_set(&r, 32000, 32767, 32767);
+    reverb_energy(&r, 1);
+    ASSERT_EQ_FMT(4000, r.feedback, "%d");
+    ASSERT_EQ_FMT(32767, r.wet, "%d");
+
+    reverb_energy(&r, 100);
+    ASSERT_IN_RANGE(32000, r.feedback, 8);
+
+    PASS();
+}
+
+TEST test_reverb_saturate() {
+    static reverb r;
+    reverb_init(&r);
+    reverb_set(&r, 32767, 32767, 32767);
+
+    int16_t in[128], l[128], rr[128];
+    for (int b = 0; b < 100; b++) {
+        for (int i = 0; i < 128; i++) {
+            in[i] = (i & 1) ? 32767 : -32768;
+        }
+        reverb_process(&r, in, in, l, rr, 128);
+    }
+
+    // Full scale in at full feedback clips rather than wrapping.
+    for (int i = 0; i < 128; i++) {
+        ASSERT((l[i] > 0) == (in[i] > 0) || l[i] == 0);
+    }
+
+    PASS();
+}
+
+// test_reverb_silent ensures the reverb reports silence only once its
+// tail has died away completely.
+TEST test_reverb_silent() {
+    static reverb r;
+    reverb_init(&r);
+    reverb_set(&r, 26000, 20000, 16384);
+    reverb_energy(&r, 16);
+    ASSERT(reverb_silent(&r));
+
+    reverb_impulse(&r);
+    ASSERT_FALSE(reverb_silent(&r));
+
+    int blocks = 0;
+    while (!reverb_silent(&r) && blocks < 2000) {
+        reverb_energy(&r, 1);
+        blocks++;
+    }
+    ASSERT(reverb_silent(&r));
+
+    // It's silent because silence in is silence out.
+    ASSERT_EQ_FMT(0, (int)reverb_energy(&r, 8), "%d");
+
+    PASS();
+}
+
+GREATEST_SUITE(reverb_suite) {
+    RUN_TEST(test_reverb_dry);
+    RUN_TEST(test_reverb_decay);
+    RUN_TEST(test_reverb_smoothing);
+    RUN_TEST(test_reverb_saturate);
+    RUN_TEST(test_reverb_silent);
+}
+
+#endif
@@ -6,71 +6,116 @@
 #include <SerialFlash.h>
 
 #include "amfm_audio.h"
+#include "controls.h"
+#include "crossover_audio.h"
+#include "eventlog.h"
+#include "keyclick.h"
+#include "leslie_audio.h"
 #include "manual.h"
 #include "monitor_audio.h"
+#include "organ_audio.h"
 #include "preamp_audio.h"
+#include "profile_audio.h"
+#include "reverb_audio.h"
 #include "tonewheel_osc_audio.h"
 #include "vibrato_audio.h"
 
+// Every node in the graph is wrapped in Profiled so its update()
+// cycles can be dumped with statusProfile().
+
+// With FUSED_NODES, the organ and the Leslie are one node each, which
+// pass far fewer blocks through the audio library's pool. Set it to 0
+// for the graph of separate nodes, to profile them one by one.
+#define FUSED_NODES (1)
+
+#if FUSED_NODES
+Profiled<Organ> organ("organ");
+Profiled<Leslie> leslie("leslie");
+
+AudioConnection patchCord0(organ, 0, leslie, 0);
+
+// The fused nodes' parts, under the names of the nodes they replace.
+TonewheelOscCore &tonewheels = organ.tonewheels;
+MonitorCore &tonewheelsMonitor = organ.tonewheelsMonitor;
+VibratoCore &vibrato = organ.vibrato;
+TonewheelOscCore &percussion = organ.percussion;
+EnvelopeCore &percussionEnv = organ.percussionEnv;
+MixerGains &organOut = organ.organOut;
+AmplifierGain &swell = organ.swell;
+
+PreampCore &preamp = leslie.preamp;
+CrossoverCore &crossover = leslie.crossover;
+AmFmCore &leslieBassR = leslie.leslieBassR;
+AmFmCore &leslieTrebleR = leslie.leslieTrebleR;
+AmFmCore &leslieBassL = leslie.leslieBassL;
+AmFmCore &leslieTrebleL = leslie.leslieTrebleL;
+MixerGains &leslieR = leslie.leslieR;
+MixerGains &leslieL = leslie.leslieL;
+#else
 // Hammond B-3.
-AudioMixer4 organOut;
-TonewheelOsc tonewheels;
-Monitor tonewheelsMonitor;
-Vibrato vibrato;
+Profiled<AudioMixer4> organOut("organOut");
+Profiled<TonewheelOsc> tonewheels("tonewheels");
+Profiled<Monitor> tonewheelsMonitor("tonewheelsMonitor");
+Profiled<Vibrato> vibrato("vibrato");
 
 AudioConnection patchCord0(tonewheels, 0, tonewheelsMonitor, 0);
-AudioConnection patchCord1(tonewheelsMonitor, 0, vibrato, 0);
+AudioConnection patchCord1(tonewheels, 0, vibrato, 0);
 AudioConnection patchCord2(vibrato, 0, organOut, 0);
 
-TonewheelOsc percussion;
-AudioEffectEnvelope percussionEnv;
+Profiled<TonewheelOsc> percussion("percussion");
+Profiled<AudioEffectEnvelope> percussionEnv("percussionEnv");
 
 AudioConnection patchCord3(percussion, 0, percussionEnv, 0);
 AudioConnection patchCord4(percussionEnv, 0, organOut, 1);
 
-AudioAmplifier swell;
+Profiled<AudioAmplifier> swell("swell");
 AudioConnection patchCord5(organOut, 0, swell, 0);
 
-// This antialias filter is here to band limit the organ signal, in
-// case key click transients are too high frequency, and also to give
-// a slight reduction in key click.
-AudioFilterBiquad antialias;
-AudioConnection patchCord6(swell, 0, antialias, 0);
-
 // Leslie 122
-Preamp preamp;
-AudioFilterStateVariable crossover;
-AmFm leslieBassR;
-AmFm leslieTrebleR;
-AudioMixer4 leslieR;
-AmFm leslieBassL;
-AmFm leslieTrebleL;
-AudioMixer4 leslieL;
-
-AudioConnection patchCord7(antialias, 0, preamp, 0);
+Profiled<Preamp> preamp("preamp");
+Profiled<Crossover> crossover("crossover");
+Profiled<AmFm> leslieBassR("leslieBassR");
+Profiled<AmFm> leslieTrebleR("leslieTrebleR");
+Profiled<AudioMixer4> leslieR("leslieR");
+Profiled<AmFm> leslieBassL("leslieBassL");
+Profiled<AmFm> leslieTrebleL("leslieTrebleL");
+Profiled<AudioMixer4> leslieL("leslieL");
+
+AudioConnection patchCord7(swell, 0, preamp, 0);
 AudioConnection patchCord8(preamp, 0, crossover, 0);
 
 AudioConnection patchCord9(crossover, 0, leslieBassR, 0);
-AudioConnection patchCord10(crossover, 2, leslieTrebleR, 0);
+AudioConnection patchCord10(crossover, 1, leslieTrebleR, 0);
 AudioConnection patchCord11(leslieBassR, 0, leslieR, 0);
 AudioConnection patchCord12(leslieTrebleR, 0, leslieR, 1);
 
 AudioConnection patchCord13(crossover, 0, leslieBassL, 0);
-AudioConnection patchCord14(crossover, 2, leslieTrebleL, 0);
+AudioConnection patchCord14(crossover, 1, leslieTrebleL, 0);
 AudioConnection patchCord15(leslieBassL, 0, leslieL, 0);
 AudioConnection patchCord16(leslieTrebleL, 0, leslieL, 1);
+#endif
+
+// Room
+Profiled<Reverb> room("room");
+#if FUSED_NODES
+AudioConnection patchCord17(leslie, 0, room, 0);
+AudioConnection patchCord18(leslie, 1, room, 1);
+#else
+AudioConnection patchCord17(leslieR, 0, room, 0);
+AudioConnection patchCord18(leslieL, 0, room, 1);
+#endif
 
 // Teensy audio board output.
-AudioOutputI2S i2s1;
+Profiled<AudioOutputI2S> i2s1("i2s1");
 AudioControlSGTL5000 audioShield;
-AudioConnection patchCord17(leslieR, 0, i2s1, 0);
-AudioConnection patchCord18(leslieL, 0, i2s1, 1);
+AudioConnection patchCord19(room, 0, i2s1, 0);
+AudioConnection patchCord20(room, 1, i2s1, 1);
 
 #ifdef AUDIO_INTERFACE
 // If the board is configured for USB audio, mirror the i2s output to USB.
-AudioOutputUSB usbAudio;
-AudioConnection patchCord19(leslieR, 0, usbAudio, 0);
-AudioConnection patchCord20(leslieL, 0, usbAudio, 1);
+Profiled<AudioOutputUSB> usbAudio("usbAudio");
+AudioConnection patchCord21(room, 0, usbAudio, 0);
+AudioConnection patchCord22(room, 1, usbAudio, 1);
 #endif
 
 // MIDI state. keys[n] will be nonzero if a key is down (value being
@@ -85,6 +130,15 @@ uint8_t midiControl[127] = {0};
 
 #define MANUAL_KEY_0 (35)
 #define MANUAL_KEY_61 (MANUAL_KEY_0 + 61)
+#define PEDAL_KEY_0 (35)
+#define PEDAL_KEY_25 (PEDAL_KEY_0 + 25)
+
+// Each manual listens on its own MIDI channel, and notes on any other
+// channel are ignored. Drawbar CCs on a channel set that manual's
+// drawbars; all other CCs are global.
+#define UPPER_CHANNEL (1)
+#define LOWER_CHANNEL (2)
+#define PEDAL_CHANNEL (3)
 
 #define CC_SWELL (11)
 #define CC_RESET (46)
@@ -100,23 +154,59 @@ uint8_t midiControl[127] = {0};
 #define CC_VIBRATO (107)
 #define CC_SPEAKER_DRIVE (111)
 
+// The upper manual, lower manual and pedals all sum into organBus,
+// which sets the volumes of the single tonewheel oscillator. The
+// percussion oscillator is driven by percussionManual: the upper
+// manual's keys with their own drawbars.
+manual_bus organBus;
+manual upper;
+manual lower;
+manual pedals;
+
+manual_bus percussionBus;
+manual percussionManual;
+
+// Key presses on the organ manuals close their busbar contacts
+// through click, which schedules each tonewheel's volume change on
+// the oscillator at its own sample. Contacts spread over 3ms and
+// bounce for up to 0.5ms.
+keyclick click;
+#define CLICK_SPREAD (132)
+#define CLICK_BOUNCE (22)
+
+// With CONTINUOUS_DRAWBARS, the organ manuals' drawbars follow their
+// CCs at full resolution and sweep smoothly; set it to 0 for the
+// B3's nine stops.
+#define CONTINUOUS_DRAWBARS (1)
+
+// Drawbar CC values for the lower manual and pedals. The upper
+// manual's are in midiControl.
+uint8_t lowerDrawbars[10] = {0};
+uint8_t pedalDrawbars[3] = {0};
+
 // numKeysDown is used to keep the percussion effect single triggered:
 // only the first key down affects the percussion setting.
 uint8_t numKeysDown = 0;
 
+// handleControlChange routes CCs through ccRoutes, which collects the
+// groups of parameters they affect. flushControls recomputes each
+// dirty group at most once per audio block.
+controls ccRoutes;
+uint32_t controlsFlushed = 0;
+
+// MIDI handlers log to midiLog rather than Serial, which can block.
+// loop() drains it when there's room in the serial buffer.
+eventlog midiLog;
+
 void handleNoteOn(byte chan, byte note, byte vel);
 void handleNoteOff(byte chan, byte note, byte vel);
 void handleControlChange(byte chan, byte ctrl, byte val);
 
-// reset restores everything to just-booted state:
-// 1) it thinks all keys are up
-// 2) drawbar registration is set to 888800000
-// 3) percussion is off, vibrato is set to C1
-// 4) the Leslie is set to slow
-void reset() {
-    // Release all keys and reset all control settings.
-    memset(midiKeys, 0, 127);
+// defaultControls sets the controls to their just-booted state.
+void defaultControls() {
     memset(midiControl, 0, 127);
+    memset(lowerDrawbars, 0, sizeof(lowerDrawbars));
+    memset(pedalDrawbars, 0, sizeof(pedalDrawbars));
 
     // Set drawbars to Green Onions.
     midiControl[CC_DRAWBAR_0 + 1] = 127;
@@ -124,8 +214,38 @@ void reset() {
     midiControl[CC_DRAWBAR_0 + 3] = 127;
     midiControl[CC_DRAWBAR_0 + 4] = 127;
 
+    // Lower manual at 008800000, pedals at 8/0.
+    lowerDrawbars[3] = 127;
+    lowerDrawbars[4] = 127;
+    pedalDrawbars[1] = 127;
+
     // Minimal drive by default.
     midiControl[CC_SPEAKER_DRIVE] = 0;
+}
+
+// reset restores everything to just-booted state:
+// 1) it thinks all keys are up
+// 2) drawbar registration is set to 888800000
+// 3) percussion is off, vibrato is set to C1
+// 4) the Leslie is set to slow
+void reset() {
+    // Release all keys and reset all control settings.
+    memset(midiKeys, 0, 127);
+    numKeysDown = 0;
+    defaultControls();
+
+    manual_bus_init(&organBus);
+    manual_init(&upper, &organBus);
+    manual_init(&lower, &organBus);
+    manual_init_pedals(&pedals, &organBus);
+    manual_set_continuous(&upper, CONTINUOUS_DRAWBARS);
+    manual_set_continuous(&lower, CONTINUOUS_DRAWBARS);
+    manual_set_continuous(&pedals, CONTINUOUS_DRAWBARS);
+
+    manual_bus_init(&percussionBus);
+    manual_init(&percussionManual, &percussionBus);
+
+    keyclick_init(&click, CLICK_SPREAD, CLICK_BOUNCE);
 
     // Reset Leslie rotation position. Our R microphone leads the L by
     // 90 degrees.
@@ -134,7 +254,7 @@ void reset() {
     leslieBassR.setPhase(0.25);
     leslieTrebleR.setPhase(0.25);
 
-    updateLeslieAmplifier();
+    updateLeslieAmplifier(driveCurve());
     updateLeslieRotation();
     updatePercussionEnvelope();
     updateTonewheelVolumes();
@@ -152,8 +272,10 @@ enum {
     FULL_POLYPHONY,
 };
 
-void preset(int conf) {
-    reset();
+// presetControls sets the controls for preset _conf_, starting from
+// defaultControls.
+void presetControls(int conf) {
+    defaultControls();
 
     switch (conf) {
     case NO_TONEWHEEL:
@@ -210,48 +332,173 @@ void preset(int conf) {
         midiControl[CC_SPEAKER_DRIVE] = 127;
         break;
     case FULL_POLYPHONY:
-        // cheating around what sounds like some overflow / sign errors
-        midiControl[CC_DRAWBAR_0 + 1] = 0;
-        midiControl[CC_DRAWBAR_0 + 2] = 0;
-        midiControl[CC_DRAWBAR_0 + 3] = 0;
-        midiControl[CC_DRAWBAR_0 + 4] = 0;
-        midiControl[CC_DRAWBAR_0 + 5] = 0;
+        midiControl[CC_DRAWBAR_0 + 1] = 127;
+        midiControl[CC_DRAWBAR_0 + 2] = 127;
+        midiControl[CC_DRAWBAR_0 + 3] = 127;
+        midiControl[CC_DRAWBAR_0 + 4] = 127;
+        midiControl[CC_DRAWBAR_0 + 5] = 127;
         midiControl[CC_DRAWBAR_0 + 6] = 127;
         midiControl[CC_DRAWBAR_0 + 7] = 127;
         midiControl[CC_DRAWBAR_0 + 8] = 127;
         midiControl[CC_DRAWBAR_0 + 9] = 127;
         midiControl[CC_ROTARY_SPEED] = 0;
-        fullPolyphony();
         break;
     }
+}
 
-    updateLeslieAmplifier();
-    updateLeslieRotation();
-    updatePercussionEnvelope();
-    updateTonewheelVolumes();
-    updateVibrato();
+// Registration is what a preset recalls: the controls listed in
+// registrationCCs, the lower manual and pedal drawbars, and which of
+// presetCurves is the preamp curve for its drive, built ahead of time
+// so recalling it costs no atanf.
+const uint8_t registrationCCs[] = {
+    CC_DRAWBAR_0 + 1,
+    CC_DRAWBAR_0 + 2,
+    CC_DRAWBAR_0 + 3,
+    CC_DRAWBAR_0 + 4,
+    CC_DRAWBAR_0 + 5,
+    CC_DRAWBAR_0 + 6,
+    CC_DRAWBAR_0 + 7,
+    CC_DRAWBAR_0 + 8,
+    CC_DRAWBAR_0 + 9,
+    CC_PERCUSSION,
+    CC_PERCUSSION_FAST,
+    CC_PERCUSSION_SOFT,
+    CC_PERCUSSION_THIRD,
+    CC_VIBRATO,
+    CC_VIBRATO_MODE,
+    CC_ROTARY_STOP,
+    CC_ROTARY_SPEED,
+    CC_SPEAKER_DRIVE,
+};
+
+struct Registration {
+    uint8_t controls[sizeof(registrationCCs)];
+    uint8_t lowerDrawbars[10];
+    uint8_t pedalDrawbars[3];
+    uint8_t curve;
+};
+
+#define NUM_PRESETS (FULL_POLYPHONY + 1)
+Registration presets[NUM_PRESETS];
+
+// presetCurves holds one preamp curve per distinct drive among the
+// presets, at 2kB each; most presets share the default drive. A
+// preset whose drive finds no room gets NO_PRESET_CURVE, and its
+// curve is built on recall instead.
+#define NUM_PRESET_CURVES (2)
+#define NO_PRESET_CURVE (0xff)
+int16_t presetCurves[NUM_PRESET_CURVES][PREAMP_TABLE_LEN + 1];
+uint8_t presetCurveDrives[NUM_PRESET_CURVES];
+uint8_t numPresetCurves = 0;
+
+// presetCurve returns the index in presetCurves of the curve for
+// _drive_, building it if there's room.
+uint8_t presetCurve(uint8_t drive) {
+    for (uint8_t i = 0; i < numPresetCurves; i++) {
+        if (presetCurveDrives[i] == drive) {
+            return i;
+        }
+    }
+    if (numPresetCurves == NUM_PRESET_CURVES) {
+        return NO_PRESET_CURVE;
+    }
+
+    uint8_t i = numPresetCurves++;
+    preamp_fill_table(presetCurves[i], driveK(drive));
+    presetCurveDrives[i] = drive;
+    return i;
+}
+
+// storePreset saves the current controls to preset _conf_.
+void storePreset(int conf) {
+    Registration *r = &presets[conf];
+    for (size_t i = 0; i < sizeof(registrationCCs); i++) {
+        r->controls[i] = midiControl[registrationCCs[i]];
+    }
+    memcpy(r->lowerDrawbars, lowerDrawbars, sizeof(lowerDrawbars));
+    memcpy(r->pedalDrawbars, pedalDrawbars, sizeof(pedalDrawbars));
+    r->curve = presetCurve(midiControl[CC_SPEAKER_DRIVE]);
+}
+
+// stagedTable is the preamp curve of a recalled preset, waiting for
+// flushControls to switch to it instead of building one with buildTable.
+const int16_t *stagedTable = NULL;
+
+// recallPreset switches to preset _conf_ without touching the keys.
+// It only stages the controls: flushControls applies all of them
+// together at one block boundary, where the tonewheels and the
+// preamp crossfade to their new settings.
+void recallPreset(int conf) {
+    const Registration *r = &presets[conf];
+    for (size_t i = 0; i < sizeof(registrationCCs); i++) {
+        midiControl[registrationCCs[i]] = r->controls[i];
+    }
+    memcpy(lowerDrawbars, r->lowerDrawbars, sizeof(lowerDrawbars));
+    memcpy(pedalDrawbars, r->pedalDrawbars, sizeof(pedalDrawbars));
+
+    stagedTable = NULL;
+    if (r->curve != NO_PRESET_CURVE) {
+        stagedTable = presetCurves[r->curve];
+    }
+    controls_mark(&ccRoutes, CONTROL_TONEWHEELS | CONTROL_PERCUSSION | CONTROL_LESLIE_ROTATION | CONTROL_VIBRATO | CONTROL_DRIVE);
+}
+
+// initPresets fills the preset bank. Call it before reset().
+void initPresets() {
+    for (int conf = 0; conf < NUM_PRESETS; conf++) {
+        presetControls(conf);
+        storePreset(conf);
+    }
+}
+
+// preset recalls preset _conf_. FULL_POLYPHONY also holds down every
+// key.
+void preset(int conf) {
+    recallPreset(conf);
+    if (conf == FULL_POLYPHONY) {
+        fullPolyphony();
+    }
 }
 
 void setup() {
     Serial.begin(115200);
 
-    AudioMemory(10);
+    // Count any block over its share of the CPU as an overrun: one
+    // block is 128 samples at 44.1kHz.
+    profile_cycles_enable();
+    profile_set_budget((uint32_t)(F_CPU / (44100.0 / AUDIO_BLOCK_SAMPLES)));
+
+    AudioMemory(12);
 
     leslieBassR.init();
     leslieTrebleR.init();
     leslieBassL.init();
     leslieTrebleL.init();
 
+    // A small, dark room, mostly dry.
+    room.init();
+    room.decay(1.2);
+    room.damping(4000);
+    room.wet(0.15);
+
+    // The horns beam their highs; the drums only a little.
+    leslieBassR.setDirectivity(1500, 8000);
+    leslieTrebleR.setDirectivity(2500, 14000);
+    leslieBassL.setDirectivity(1500, 8000);
+    leslieTrebleL.setDirectivity(2500, 14000);
+
     tonewheels.init();
+    tonewheelsMonitor.init();
     percussion.init();
     vibrato.init();
 
+    initPresets();
     reset();
 
     swell.gain(1.0);
 
-    organOut.gain(0, 0.50); // tonewheels + vibrato
-    organOut.gain(1, 0.50); // percussionEnv
+    organOut.gain(0, 1.0); // tonewheels + vibrato
+    organOut.gain(1, 1.0); // percussionEnv
     organOut.gain(2, 0);
     organOut.gain(3, 0);
 
@@ -260,18 +507,12 @@ void setup() {
     leslieL.gain(0, 0.70); // bass
     leslieL.gain(1, 0.30); // treble
 
-    // The antialias filter is here for two purposes:
-    //
-    // 1) To band limit the output of the organ, just in case it
-    // produces something above our Nyquist frequency (22050 Hz)
-    //
-    // 2) To cut the transients when turning on new tonewheels,
-    // reducing key click.
-    antialias.setLowpass(0, 2150, 0.707);
-
     audioShield.enable();
     audioShield.volume(0.5);
 
+    eventlog_init(&midiLog);
+    routeControls();
+
     usbMIDI.begin();
     usbMIDI.setHandleControlChange(handleControlChange);
     usbMIDI.setHandleNoteOn(handleNoteOn);
@@ -281,10 +522,138 @@ void setup() {
 int count = 0;
 void loop() {
     usbMIDI.read();
+    flushControls();
+    runKeyclick();
+    drainLog();
     if ((count++ % 500000) == 0) {
         status();
         statusVolume();
     }
+
+    // Send 'p' for a profile summary, 'P' to include recent blocks.
+    if (Serial.available()) {
+        int c = Serial.read();
+        if (c == 'p' || c == 'P') {
+            statusProfile(c == 'P');
+        }
+    }
+}
+
+// drainLog prints logged MIDI events, but only as many as fit in the
+// serial transmit buffer, so it never blocks loop().
+void drainLog() {
+    char line[64];
+    eventlog_entry e;
+
+    while (Serial.availableForWrite() > (int)sizeof(line)) {
+        if (!eventlog_pop(&midiLog, &e)) {
+            break;
+        }
+        eventlog_format(&e, line, sizeof(line));
+        Serial.println(line);
+    }
+}
+
+// routeControls sets up the CC routing table.
+void routeControls() {
+    controls_init(&ccRoutes);
+    for (int i = CC_DRAWBAR_0 + 1; i <= CC_DRAWBAR_9; i++) {
+        controls_route(&ccRoutes, i, CONTROL_TONEWHEELS);
+    }
+    controls_route(&ccRoutes, CC_PERCUSSION, CONTROL_PERCUSSION | CONTROL_TONEWHEELS);
+    controls_route(&ccRoutes, CC_PERCUSSION_THIRD, CONTROL_TONEWHEELS);
+    controls_route(&ccRoutes, CC_PERCUSSION_FAST, CONTROL_PERCUSSION);
+    controls_route(&ccRoutes, CC_PERCUSSION_SOFT, CONTROL_PERCUSSION);
+    controls_route(&ccRoutes, CC_ROTARY_STOP, CONTROL_LESLIE_ROTATION);
+    controls_route(&ccRoutes, CC_ROTARY_SPEED, CONTROL_LESLIE_ROTATION);
+    controls_route(&ccRoutes, CC_VIBRATO, CONTROL_VIBRATO);
+    controls_route(&ccRoutes, CC_VIBRATO_MODE, CONTROL_VIBRATO);
+    controls_route(&ccRoutes, CC_SPEAKER_DRIVE, CONTROL_DRIVE);
+    controls_route(&ccRoutes, CC_SWELL, CONTROL_SWELL);
+}
+
+// flushControls applies the control groups dirtied by CCs, once per
+// audio block no matter how many CCs arrived. Every group lands in the
+// same block: the audio update is held off while they're applied, and
+// if the tonewheel schedule can't take every changed wheel, nothing
+// is applied until a later block where it can. The preamp curve is
+// built before that, so the audio update is only held off for the
+// cheap swaps.
+void flushControls() {
+    uint32_t now = tonewheels.clock();
+    if (now == controlsFlushed) {
+        return;
+    }
+    controlsFlushed = now;
+
+    uint8_t dirty = controls_take(&ccRoutes);
+    if (dirty == 0) {
+        return;
+    }
+
+    const int16_t *driveTable = NULL;
+    if (dirty & CONTROL_DRIVE) {
+        driveTable = driveCurve();
+    }
+
+    AudioNoInterrupts();
+    if ((dirty & CONTROL_TONEWHEELS) && !updateTonewheelVolumes()) {
+        AudioInterrupts();
+        controls_mark(&ccRoutes, dirty);
+        return;
+    }
+    if (dirty & CONTROL_PERCUSSION) {
+        updatePercussionEnvelope();
+    }
+    if (dirty & CONTROL_LESLIE_ROTATION) {
+        updateLeslieRotation();
+    }
+    if (dirty & CONTROL_VIBRATO) {
+        updateVibrato();
+    }
+    if (dirty & CONTROL_DRIVE) {
+        updateLeslieAmplifier(driveTable);
+    }
+    if (dirty & CONTROL_SWELL) {
+        swell.gain(remap((float)midiControl[CC_SWELL], 0, 127, 0, 2.5));
+    }
+    AudioInterrupts();
+}
+
+// clickNow is the sample time new key presses start at: the block
+// after the one about to be rendered, so every contact can be placed
+// on its exact sample.
+uint32_t clickNow() {
+    return tonewheels.clock() + AUDIO_BLOCK_SAMPLES;
+}
+
+void scheduleContact(uint32_t time, int tonewheel, uint16_t volume, void *ctx) {
+    tonewheels.schedule(time, tonewheel, volume);
+    manual_bus_clean(&organBus, tonewheel);
+}
+
+// runKeyclick applies the contacts due by the end of the next block.
+// Drawbar changes waiting on flushControls are left for it, so they
+// land with the rest of their group.
+void runKeyclick() {
+    keyclick_run(&click, clickNow() + AUDIO_BLOCK_SAMPLES, tonewheels.scheduleRoom(), scheduleContact, NULL);
+    if (!(ccRoutes.dirty & CONTROL_TONEWHEELS)) {
+        publishTonewheelVolumes();
+    }
+}
+
+// publishTonewheelVolumes schedules every organBus tonewheel changed
+// outside of keyclick, such as by a drawbar or preset, as soon as
+// possible. Each ramps to its new volume across a block rather than
+// stepping, and they all start in the same block. If the schedule
+// can't take them all, they stay dirty for the next call and it
+// returns false.
+bool publishTonewheelVolumes() {
+    if (!tonewheels.scheduleRamps(tonewheels.clock(), organBus.output, organBus.dirty)) {
+        return false;
+    }
+    memset(organBus.dirty, 0, sizeof(organBus.dirty));
+    return true;
 }
 
 int note2key(byte note) {
@@ -293,7 +662,7 @@ int note2key(byte note) {
 
 void fullPolyphony() {
     for (int n = 0; n < 128; n++) {
-        handleNoteOn(1, n, 127);
+        handleNoteOn(UPPER_CHANNEL, n, 127);
     }
 }
 
@@ -305,21 +674,35 @@ void randomDrawbars() {
 }
 
 void handleNoteOn(byte chan, byte note, byte velocity) {
-    Serial.print("Note on: ");
-    Serial.print(note);
-    Serial.print("\n");
+    EVENTLOG(EVENTLOG_INFO, &midiLog, millis(), EVENT_NOTE_ON, chan, note, velocity);
 
     // MIDI notes always have the high bit unset, but just in case.
     if (note & 0x80) {
         return;
     }
 
+    if (chan == LOWER_CHANNEL) {
+        if (note > MANUAL_KEY_0 && note <= MANUAL_KEY_61) {
+            keyclick_key_down(&click, &lower, note - MANUAL_KEY_0, clickNow());
+        }
+        return;
+    } else if (chan == PEDAL_CHANNEL) {
+        if (note > PEDAL_KEY_0 && note <= PEDAL_KEY_25) {
+            keyclick_key_down(&click, &pedals, note - PEDAL_KEY_0, clickNow());
+        }
+        return;
+    } else if (chan != UPPER_CHANNEL) {
+        return;
+    }
+
     midiKeys[note] = velocity;
     if (note <= MANUAL_KEY_0 || note > MANUAL_KEY_61) {
         return;
     }
 
-    updateTonewheelVolumes();
+    keyclick_key_down(&click, &upper, note2key(note), clickNow());
+    manual_key_down(&percussionManual, note2key(note));
+    percussion.setVolumes(percussionBus.output);
 
     if (++numKeysDown == 1 && midiControl[CC_PERCUSSION]) {
         percussionEnv.noteOn();
@@ -327,14 +710,26 @@ void handleNoteOn(byte chan, byte note, byte velocity) {
 }
 
 void handleNoteOff(byte chan, byte note, byte vel) {
-    Serial.print("Note off: ");
-    Serial.print(note);
-    Serial.print("\n");
+    EVENTLOG(EVENTLOG_INFO, &midiLog, millis(), EVENT_NOTE_OFF, chan, note, vel);
 
     if (note & 0x80) {
         return;
     }
 
+    if (chan == LOWER_CHANNEL) {
+        if (note > MANUAL_KEY_0 && note <= MANUAL_KEY_61) {
+            keyclick_key_up(&click, &lower, note - MANUAL_KEY_0, clickNow());
+        }
+        return;
+    } else if (chan == PEDAL_CHANNEL) {
+        if (note > PEDAL_KEY_0 && note <= PEDAL_KEY_25) {
+            keyclick_key_up(&click, &pedals, note - PEDAL_KEY_0, clickNow());
+        }
+        return;
+    } else if (chan != UPPER_CHANNEL) {
+        return;
+    }
+
     midiKeys[note] = 0;
     if (note <= MANUAL_KEY_0 || note > MANUAL_KEY_61) {
         return;
@@ -344,7 +739,9 @@ void handleNoteOff(byte chan, byte note, byte vel) {
         percussionEnv.noteOff();
     }
 
-    updateTonewheelVolumes();
+    keyclick_key_up(&click, &upper, note2key(note), clickNow());
+    manual_key_up(&percussionManual, note2key(note));
+    percussion.setVolumes(percussionBus.output);
 }
 
 void updateReset() {
@@ -388,43 +785,70 @@ void updatePercussionEnvelope() {
     }
 
     if (midiControl[CC_PERCUSSION_SOFT]) {
-        organOut.gain(1, 0.25);
+        organOut.gain(1, 0.5);
     } else {
-        organOut.gain(1, 0.50);
+        organOut.gain(1, 1.0);
     }
 }
 
-uint8_t bars[10] = {0};
-uint16_t volumes[92] = {0};
-uint8_t percBars[10] = {0};
-uint16_t percVolumes[92] = {0};
+// drawbarValue maps a drawbar CC to an organ manual's drawbar.
+uint8_t drawbarValue(uint8_t val) {
+    return CONTINUOUS_DRAWBARS ? val : manual_quantize_drawbar(val);
+}
 
-void updateTonewheelVolumes() {
+// updateTonewheelVolumes applies the drawbars. It returns false if
+// the tonewheels' schedule is too full to take the change yet.
+bool updateTonewheelVolumes() {
     for (int i = 1; i < 10; i++) {
-        bars[i] = manual_quantize_drawbar(midiControl[CC_DRAWBAR_0 + i]);
+        manual_set_drawbar(&upper, i, drawbarValue(midiControl[CC_DRAWBAR_0 + i]));
+        manual_set_drawbar(&lower, i, drawbarValue(lowerDrawbars[i]));
+    }
+    for (int i = 1; i < 3; i++) {
+        manual_set_drawbar(&pedals, i, drawbarValue(pedalDrawbars[i]));
     }
 
+    uint8_t second = 0;
+    uint8_t third = 0;
     if (midiControl[CC_PERCUSSION]) {
-        bars[9] = 0;
+        // Percussion takes over the 1' drawbar.
+        manual_set_drawbar(&upper, 9, 0);
         if (midiControl[CC_PERCUSSION_THIRD]) {
-            percBars[5] = manual_quantize_drawbar(127);
+            third = manual_quantize_drawbar(127);
         } else {
-            percBars[4] = manual_quantize_drawbar(127);
+            second = manual_quantize_drawbar(127);
         }
     }
+    manual_set_drawbar(&percussionManual, 4, second);
+    manual_set_drawbar(&percussionManual, 5, third);
 
-    manual_fill_volumes(&midiKeys[MANUAL_KEY_0], percBars, percVolumes);
-    percussion.setVolumes(percVolumes);
+    if (!publishTonewheelVolumes()) {
+        return false;
+    }
+    percussion.setVolumes(percussionBus.output);
+    return true;
+}
 
-    manual_fill_volumes(&midiKeys[MANUAL_KEY_0], bars, volumes);
-    tonewheels.setVolumes(volumes);
+// driveK maps the speaker drive CC to the preamp's k.
+float driveK(uint8_t val) {
+    return remap((float)val, 0, 127, 5.0, 50.0);
 }
 
-void updateLeslieAmplifier() {
-    float k = remap((float)midiControl[CC_SPEAKER_DRIVE], 0, 127, 5.0, 50.0);
-    preamp.setK(k);
+// driveCurve returns the preamp curve for the current drive: a
+// recalled preset's, or else one built into a spare preamp table,
+// which takes about a thousand atanf calls.
+const int16_t *driveCurve() {
+    if (stagedTable != NULL) {
+        return stagedTable;
+    }
+    return preamp.buildTable(driveK(midiControl[CC_SPEAKER_DRIVE]));
+}
+
+// updateLeslieAmplifier switches the preamp to _table_, from
+// driveCurve.
+void updateLeslieAmplifier(const int16_t *table) {
+    preamp.setTable(table);
+    stagedTable = NULL;
     crossover.frequency(800);
-    crossover.resonance(0.707);
 }
 
 void updateLeslieRotation() {
@@ -474,38 +898,39 @@ void handleControlChange(byte chan, byte ctrl, byte val) {
         return;
     }
 
-    Serial.print("Control Change, ch=");
-    Serial.print(chan, DEC);
-    Serial.print(", control=");
-    Serial.print(ctrl, DEC);
-    Serial.print(", value=");
-    Serial.print(val, DEC);
-    Serial.println();
+    EVENTLOG(EVENTLOG_INFO, &midiLog, millis(), EVENT_CONTROL_CHANGE, chan, ctrl, val);
 
     if (ctrl & 0x80) {
         return;
     }
 
+    // Drawbars on the lower manual and pedal channels.
+    if (ctrl > CC_DRAWBAR_0 && ctrl <= CC_DRAWBAR_9) {
+        if (chan == LOWER_CHANNEL) {
+            lowerDrawbars[ctrl - CC_DRAWBAR_0] = val;
+            controls_change(&ccRoutes, ctrl);
+            return;
+        } else if (chan == PEDAL_CHANNEL) {
+            if (ctrl - CC_DRAWBAR_0 < 3) {
+                pedalDrawbars[ctrl - CC_DRAWBAR_0] = val;
+                controls_change(&ccRoutes, ctrl);
+            }
+            return;
+        }
+    }
+
     midiControl[ctrl] = val;
 
-    if (ctrl == CC_SWELL) {
-        swell.gain(remap((float)val, 0, 127, 0, 2.5));
-    } else if (ctrl == CC_RESET) {
+    // A drive change replaces a recalled preset's curve still waiting
+    // for flushControls.
+    if (ctrl == CC_SPEAKER_DRIVE) {
+        stagedTable = NULL;
+    }
+    if (ctrl == CC_RESET) {
         updateReset();
-    } else if (ctrl == CC_PERCUSSION) {
-        updatePercussionEnvelope();
-        updateTonewheelVolumes();
-    } else if (ctrl == CC_PERCUSSION_FAST) {
-        updatePercussionEnvelope();
-    } else if (ctrl == CC_PERCUSSION_SOFT) {
-        updatePercussionEnvelope();
-    } else if (ctrl > CC_DRAWBAR_0 && ctrl <= CC_DRAWBAR_9) {
-        updateTonewheelVolumes();
-    } else if (ctrl == CC_ROTARY_STOP || ctrl == CC_ROTARY_SPEED) {
-        updateLeslieRotation();
-    } else if (ctrl == CC_VIBRATO || ctrl == CC_VIBRATO_MODE) {
-        updateVibrato();
+        return;
     }
+    controls_change(&ccRoutes, ctrl);
 }
 
 void showKeys() {
@@ -530,6 +955,19 @@ void showVolumes(uint16_t volumes[92]) {
 
 void status() {
     Serial.print("CPU: ");
+#if FUSED_NODES
+    Serial.print("organ=");
+    Serial.print(organ.processorUsage());
+    Serial.print(",");
+    Serial.print(organ.processorUsageMax());
+    Serial.print("  ");
+
+    Serial.print("leslie=");
+    Serial.print(leslie.processorUsage());
+    Serial.print(",");
+    Serial.print(leslie.processorUsageMax());
+    Serial.print("  ");
+#else
     Serial.print("tonewheels=");
     Serial.print(tonewheels.processorUsage());
     Serial.print(",");
@@ -541,12 +979,7 @@ void status() {
     Serial.print(",");
     Serial.print(vibrato.processorUsageMax());
     Serial.print("  ");
-
-    Serial.print("antialias=");
-    Serial.print(antialias.processorUsage());
-    Serial.print(",");
-    Serial.print(antialias.processorUsageMax());
-    Serial.print("  ");
+#endif
 
     Serial.print("all=");
     Serial.print(AudioProcessorUsage());
@@ -559,19 +992,48 @@ void status() {
     Serial.print(",");
     Serial.print(AudioMemoryUsageMax());
     Serial.print("    ");
+
+    Serial.print("Log dropped: ");
+    Serial.print(midiLog.dropped);
     Serial.println();
 }
 
+void printProfileLine(const char *line, void *ctx) {
+    Serial.println(line);
+}
+
+// statusProfile prints cycle counts for every node in the graph. Each
+// line has the min, mean, p99 and max cycles per block, and the
+// number of blocks that overran the budget set in setup().
+void statusProfile(bool recent) {
+    profile_dump(printProfileLine, NULL, recent);
+}
+
 void statusVolume() {
+    monitor_snapshot snap;
+    tonewheelsMonitor.snapshot(&snap);
+
     Serial.print("Volume: ");
     Serial.print("tonewheels=");
-    Serial.print(tonewheelsMonitor.volumeUsageMin());
+    Serial.print(snap.interval.min);
+    Serial.print(",");
+    Serial.print(snap.interval.max);
+    Serial.print("    ");
+    Serial.print(snap.ever.min);
     Serial.print(",");
-    Serial.print(tonewheelsMonitor.volumeUsageMax());
+    Serial.print(snap.ever.max);
     Serial.print("    ");
-    Serial.print(tonewheelsMonitor.volumeUsageMinEver());
+
+    Serial.print("rms=");
+    Serial.print(monitor_rms(&snap.interval));
+    Serial.print(" peak=");
+    Serial.print(snap.interval.peak);
+    Serial.print(",");
+    Serial.print(snap.ever.peak);
+    Serial.print(" clips=");
+    Serial.print(snap.interval.clips);
     Serial.print(",");
-    Serial.print(tonewheelsMonitor.volumeUsageMaxEver());
+    Serial.print(snap.ever.clips);
     Serial.println();
 
     tonewheelsMonitor.reset();
@@ -0,0 +1,657 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+// roto_bench times the audio kernels offline. Each line reports the
+// cycles spent per 128 sample block, as measured by profile_cycles.
+// Run it with `make bench`.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "amfm.h"
+#include "conv.h"
+#include "leslie.h"
+#include "manual.h"
+#include "organ.h"
+#include "profile.h"
+#include "resample.h"
+#include "reverb.h"
+#include "tonewheel_osc.h"
+#include "vibrato.h"
+
+#define BENCH_BLOCK_LEN (128)
+#define BENCH_BLOCKS (4000)
+
+static profile bench_prof;
+static profile_stats bench_stats;
+
+static void bench_start(const char *name) {
+    profile_init(&bench_prof, name);
+}
+
+static void bench_report() {
+    char line[128];
+    profile_read(&bench_prof, &bench_stats);
+    profile_format(bench_prof.name, &bench_stats, line, sizeof(line));
+    printf("%s\n", line);
+}
+
+// chord_volumes fills volumes for a three note chord with the first
+// four drawbars out (888800000).
+static void chord_volumes(uint16_t volumes[92]) {
+    uint8_t keys[62] = {0};
+    uint8_t drawbars[10] = {0, 8, 8, 8, 8, 0, 0, 0, 0, 0};
+
+    keys[25] = 1;
+    keys[29] = 1;
+    keys[32] = 1;
+    manual_fill_volumes(keys, drawbars, volumes);
+}
+
+// bench_tonewheel_leak times tonewheel_osc_fill at each crosstalk
+// matrix density.
+static void bench_tonewheel_leak() {
+    static const char *names[] = {
+        "tonewheel_osc_fill leak=0",
+        "tonewheel_osc_fill leak=1",
+        "tonewheel_osc_fill leak=2",
+        "tonewheel_osc_fill leak=3",
+        "tonewheel_osc_fill leak=4",
+    };
+
+    uint16_t volumes[92];
+    int16_t block[BENCH_BLOCK_LEN];
+
+    chord_volumes(volumes);
+
+    for (int density = 0; density <= TONEWHEEL_OSC_LEAK_MAX; density++) {
+        tonewheel_osc *osc = tonewheel_osc_new();
+        tonewheel_osc_leak_b3(osc, density, 328);
+        for (int t = 1; t < 92; t++) {
+            tonewheel_osc_set_volume(osc, t, volumes[t]);
+        }
+
+        bench_start(names[density]);
+        for (int i = 0; i < BENCH_BLOCKS; i++) {
+            uint32_t start = profile_cycles();
+            tonewheel_osc_fill(osc, block, BENCH_BLOCK_LEN);
+            profile_record(&bench_prof, profile_cycles() - start);
+        }
+        bench_report();
+
+        free(osc);
+    }
+}
+
+// bench_tonewheel_multirate times tonewheel_osc_fill for a bass
+// heavy registration (16' and 8', 808000000) at each low wheel rate.
+static void bench_tonewheel_multirate() {
+    static const char *names[] = {
+        "tonewheel_osc_fill 16'+8' full rate",
+        "tonewheel_osc_fill 16'+8' low 1/2",
+        "tonewheel_osc_fill 16'+8' low 1/4",
+    };
+
+    uint8_t keys[62] = {0};
+    uint8_t drawbars[10] = {0, 8, 0, 8, 0, 0, 0, 0, 0, 0};
+    uint16_t volumes[92];
+    int16_t block[BENCH_BLOCK_LEN];
+
+    keys[1] = 1;
+    keys[8] = 1;
+    keys[13] = 1;
+    keys[17] = 1;
+    keys[20] = 1;
+    keys[25] = 1;
+    manual_fill_volumes(keys, drawbars, volumes);
+
+    for (int shift = 0; shift <= 2; shift++) {
+        tonewheel_osc *osc = tonewheel_osc_new();
+        tonewheel_osc_set_multirate(osc, shift);
+        for (int t = 1; t < 92; t++) {
+            tonewheel_osc_set_volume(osc, t, volumes[t]);
+        }
+
+        bench_start(names[shift]);
+        for (int i = 0; i < BENCH_BLOCKS; i++) {
+            uint32_t start = profile_cycles();
+            tonewheel_osc_fill(osc, block, BENCH_BLOCK_LEN);
+            profile_record(&bench_prof, profile_cycles() - start);
+        }
+        bench_report();
+
+        free(osc);
+    }
+}
+
+// bench_amfm times amfm_update against amfm_update_ctl and
+// amfm_update_dir for a horn at fast speed, and reports how far apart
+// the first two's outputs are. The last mode is the kernel roto.ino's
+// rotors select: tremolo and directivity, without delay.
+static void bench_amfm() {
+    static const char *names[] = {
+        "amfm_update",
+        "amfm_update_ctl",
+        "amfm_update_dir",
+        "amfm_select tremolo+dir",
+    };
+
+    static int16_t volume[257], offset[257], coef[257];
+    static int16_t ring[4][512];
+    static int16_t src[BENCH_BLOCK_LEN];
+    static int16_t out[4][BENCH_BLOCKS][BENCH_BLOCK_LEN];
+
+    // 10% tremolo, 1.18ms of delay at 6.66Hz.
+    fill_sinemod(volume, (int16_t)(32767 * 0.9), 32767, 0);
+    volume[256] = volume[0];
+    fill_sinemod(offset, 0, (int16_t)(44.1 * 1.18 * 256), 0);
+    offset[256] = offset[0];
+    fill_directivity(coef, 2500, 14000, 44100);
+    coef[256] = coef[0];
+    uint32_t phase_incr = (uint32_t)(6.66 * 97391.55 + 0.5);
+
+    amfm_fn tremolo_dir = amfm_select(AMFM_TREMOLO | AMFM_DIRECTIVITY);
+    for (int mode = 0; mode < 4; mode++) {
+        uint32_t wp = 0;
+        uint32_t phase = 0;
+        uint32_t src_phase = 0;
+        int32_t lp = 0;
+
+        bench_start(names[mode]);
+        for (int i = 0; i < BENCH_BLOCKS; i++) {
+            // A 1kHz sine at half scale.
+            for (int j = 0; j < BENCH_BLOCK_LEN; j++) {
+                src[j] = isin_S4(src_phase) * 4;
+                src_phase += 743;
+            }
+
+            uint32_t start = profile_cycles();
+            if (mode == 0) {
+                amfm_update(out[mode][i], src, BENCH_BLOCK_LEN, ring[mode], 512, &wp, volume, offset, phase_incr, &phase);
+            } else if (mode == 1) {
+                amfm_update_ctl(out[mode][i], src, BENCH_BLOCK_LEN, ring[mode], 512, &wp, volume, offset, phase_incr, &phase, AMFM_CTL_SHIFT);
+            } else if (mode == 2) {
+                amfm_update_dir(out[mode][i], src, BENCH_BLOCK_LEN, ring[mode], 512, &wp, volume, offset, coef, &lp, phase_incr, &phase, AMFM_CTL_SHIFT);
+            } else {
+                tremolo_dir(out[mode][i], src, BENCH_BLOCK_LEN, ring[mode], 512, &wp, volume, offset, coef, &lp, phase_incr, &phase, AMFM_CTL_SHIFT);
+            }
+            profile_record(&bench_prof, profile_cycles() - start);
+        }
+        bench_report();
+    }
+
+    int max_err = 0;
+    double sum_sq = 0;
+    for (int i = 0; i < BENCH_BLOCKS; i++) {
+        for (int j = 0; j < BENCH_BLOCK_LEN; j++) {
+            int err = abs(out[0][i][j] - out[1][i][j]);
+            max_err = err > max_err ? err : max_err;
+            sum_sq += (double)err * err;
+        }
+    }
+    printf("amfm_update_ctl error: max=%d rms=%.2f\n", max_err, sqrt(sum_sq / (BENCH_BLOCKS * BENCH_BLOCK_LEN)));
+}
+
+// bench_stopped times a stopped rotor's tremolo and directivity, the
+// kernel CC_ROTARY_STOP leaves running, with the general kernel and
+// the stopped one.
+static void bench_stopped() {
+    static int16_t volume[257], offset[257], coef[257];
+    static int16_t ring[512];
+    static int16_t block[BENCH_BLOCK_LEN];
+
+    fill_sinemod(volume, (int16_t)(32767 * 0.9), 32767, 0);
+    volume[256] = volume[0];
+    memset(offset, 0, sizeof(offset));
+    fill_directivity(coef, 2500, 14000, 44100);
+    coef[256] = coef[0];
+
+    for (int stopped = 0; stopped < 2; stopped++) {
+        int parts = AMFM_TREMOLO | AMFM_DIRECTIVITY;
+        amfm_fn fn = stopped ? amfm_select_stopped(parts) : amfm_select(parts);
+        uint32_t wp = 0;
+        uint32_t phase = 0x40000000;
+        uint32_t src_phase = 0;
+        int32_t lp = 0;
+
+        bench_start(stopped ? "amfm stopped tremolo+dir" : "amfm general tremolo+dir, stopped");
+        for (int i = 0; i < BENCH_BLOCKS; i++) {
+            for (int j = 0; j < BENCH_BLOCK_LEN; j++) {
+                block[j] = isin_S4(src_phase) * 4;
+                src_phase += 743;
+            }
+
+            uint32_t start = profile_cycles();
+            fn(block, block, BENCH_BLOCK_LEN, ring, 512, &wp, volume, offset, coef, &lp, 0, &phase, AMFM_CTL_SHIFT);
+            profile_record(&bench_prof, profile_cycles() - start);
+        }
+        bench_report();
+    }
+}
+
+// bench_f32 times the int16 kernels against their float versions on
+// the same input. Build with BENCHFLAGS="-O3 -mavx2" to see what the
+// vectorizer makes of each.
+static void bench_f32() {
+    uint16_t volumes[92];
+    static int16_t block[BENCH_BLOCK_LEN], src[BENCH_BLOCK_LEN];
+    static float block_f[BENCH_BLOCK_LEN], src_f[BENCH_BLOCK_LEN];
+
+    chord_volumes(volumes);
+    for (int f32 = 0; f32 <= 1; f32++) {
+        tonewheel_osc *osc = tonewheel_osc_new();
+        for (int t = 1; t < 92; t++) {
+            tonewheel_osc_set_volume(osc, t, volumes[t]);
+        }
+
+        bench_start(f32 ? "tonewheel_osc_fill_f32" : "tonewheel_osc_fill int16");
+        for (int i = 0; i < BENCH_BLOCKS; i++) {
+            uint32_t start = profile_cycles();
+            if (f32) {
+                tonewheel_osc_fill_f32(osc, block_f, BENCH_BLOCK_LEN);
+            } else {
+                tonewheel_osc_fill(osc, block, BENCH_BLOCK_LEN);
+            }
+            profile_record(&bench_prof, profile_cycles() - start);
+        }
+        bench_report();
+
+        free(osc);
+    }
+
+    // A 1kHz sine at half scale for the effects.
+    uint32_t src_phase = 0;
+    for (int j = 0; j < BENCH_BLOCK_LEN; j++) {
+        src[j] = isin_S4(src_phase) * 4;
+        src_f[j] = src[j] / 32768.0f;
+        src_phase += 743;
+    }
+
+    static int16_t volume[257], offset[257];
+    static int16_t ring[512];
+    static float ring_f[512];
+    fill_sinemod(volume, (int16_t)(32767 * 0.9), 32767, 0);
+    volume[256] = volume[0];
+    fill_sinemod(offset, 0, (int16_t)(44.1 * 1.18 * 256), 0);
+    offset[256] = offset[0];
+    uint32_t phase_incr = (uint32_t)(6.66 * 97391.55 + 0.5);
+
+    for (int f32 = 0; f32 <= 1; f32++) {
+        uint32_t wp = 0;
+        uint32_t phase = 0;
+
+        bench_start(f32 ? "amfm_update_ctl_f32" : "amfm_update_ctl int16");
+        for (int i = 0; i < BENCH_BLOCKS; i++) {
+            uint32_t start = profile_cycles();
+            if (f32) {
+                amfm_update_ctl_f32(block_f, src_f, BENCH_BLOCK_LEN, ring_f, 512, &wp, volume, offset, phase_incr, &phase, AMFM_CTL_SHIFT);
+            } else {
+                amfm_update_ctl(block, src, BENCH_BLOCK_LEN, ring, 512, &wp, volume, offset, phase_incr, &phase, AMFM_CTL_SHIFT);
+            }
+            profile_record(&bench_prof, profile_cycles() - start);
+        }
+        bench_report();
+    }
+
+    for (int f32 = 0; f32 <= 1; f32++) {
+        vibrato_scanner v;
+        vibrato_init(&v, 1, 1);
+        memset(ring, 0, sizeof(ring));
+        memset(ring_f, 0, sizeof(ring_f));
+
+        bench_start(f32 ? "vibrato_update_f32 C3" : "vibrato_update int16 C3");
+        for (int i = 0; i < BENCH_BLOCKS; i++) {
+            uint32_t start = profile_cycles();
+            if (f32) {
+                vibrato_update_f32(&v, ring_f, src_f, block_f, BENCH_BLOCK_LEN);
+            } else {
+                vibrato_update(&v, ring, src, block, BENCH_BLOCK_LEN);
+            }
+            profile_record(&bench_prof, profile_cycles() - start);
+        }
+        bench_report();
+    }
+}
+
+// bench_svf_mult is the Teensy audio library's MULT for its state
+// variable filter: a rounded 32x32 multiply keeping the high word,
+// shifted up by 2.
+static inline int32_t bench_svf_mult(int32_t a, int32_t b) {
+    return (int32_t)(((int64_t)a * b + 0x80000000LL) >> 32) << 2;
+}
+
+static inline int16_t bench_svf_out(int32_t x) {
+    x >>= 13;
+    return x > 32767 ? 32767 : (x < -32768 ? -32768 : x);
+}
+
+// bench_svf is the fixed point update of AudioFilterStateVariable, the
+// stock filter the crossover replaced: a Chamberlin filter run twice
+// a sample, with all three of its outputs.
+static void bench_svf(int32_t state[3], const int16_t *in, int16_t *lp, int16_t *bp, int16_t *hp, size_t len) {
+    const int32_t fmult = (int32_t)(sinf((float)M_PI * 800 / (44100 * 2)) * 2147483647.0f);
+    const int32_t damp = (int32_t)((1.0f / 0.707f) * 1073741824.0f);
+    int32_t inputprev = state[0], lowpass = state[1], bandpass = state[2];
+
+    for (size_t i = 0; i < len; i++) {
+        int32_t input = (int32_t)in[i] << 12;
+        lowpass = lowpass + bench_svf_mult(fmult, bandpass);
+        int32_t highpass = ((input + inputprev) >> 1) - lowpass - bench_svf_mult(damp, bandpass);
+        inputprev = input;
+        bandpass = bandpass + bench_svf_mult(fmult, highpass);
+        int32_t lowpasstmp = lowpass, bandpasstmp = bandpass, highpasstmp = highpass;
+        lowpass = lowpass + bench_svf_mult(fmult, bandpass);
+        highpass = input - lowpass - bench_svf_mult(damp, bandpass);
+        bandpass = bandpass + bench_svf_mult(fmult, highpass);
+        lp[i] = bench_svf_out(lowpass + lowpasstmp);
+        bp[i] = bench_svf_out(bandpass + bandpasstmp);
+        hp[i] = bench_svf_out(highpass + highpasstmp);
+    }
+
+    state[0] = inputprev;
+    state[1] = lowpass;
+    state[2] = bandpass;
+}
+
+// bench_crossover times the Leslie's crossover on a full band signal,
+// against the state variable filter it replaced.
+static void bench_crossover() {
+    static crossover_filter c;
+    static int32_t svf[3];
+    static int16_t in[BENCH_BLOCK_LEN], lo[BENCH_BLOCK_LEN], hi[BENCH_BLOCK_LEN], band[BENCH_BLOCK_LEN];
+
+    crossover_init(&c);
+
+    for (int stock = 0; stock <= 1; stock++) {
+        bench_start(stock ? "svf (stock crossover)" : "crossover_process");
+        for (int i = 0; i < BENCH_BLOCKS; i++) {
+            for (int j = 0; j < BENCH_BLOCK_LEN; j++) {
+                in[j] = rand() % 20000 - 10000;
+            }
+            uint32_t start = profile_cycles();
+            if (stock) {
+                bench_svf(svf, in, lo, band, hi, BENCH_BLOCK_LEN);
+            } else {
+                crossover_process(&c, in, lo, hi, BENCH_BLOCK_LEN);
+            }
+            profile_record(&bench_prof, profile_cycles() - start);
+        }
+        bench_report();
+    }
+}
+
+// bench_drum times a drum rotor at the full rate against one at the
+// quarter rate the Leslie runs it, including the resampling.
+static void bench_drum() {
+    static amfm_rotor r;
+    static polyphase4 up;
+    static int16_t block[BENCH_BLOCK_LEN], drum[BENCH_BLOCK_LEN / 4];
+
+    for (int shift = 0; shift <= LESLIE_DRUM_SHIFT; shift += LESLIE_DRUM_SHIFT) {
+        amfm_rotor_init(&r, shift);
+        amfm_rotor_set_tremolo_depth(&r, 0.3);
+        amfm_rotor_set_delay_depth(&r, 0.5);
+        amfm_rotor_set_directivity(&r, 1500, 8000, 44100);
+        amfm_rotor_set_rotation_rate(&r, 5.7);
+        polyphase4_init(&up);
+
+        uint32_t src_phase = 0;
+        bench_start(shift ? "drum rotor 11kHz" : "drum rotor 44.1kHz");
+        for (int i = 0; i < BENCH_BLOCKS; i++) {
+            // A 200Hz sine at half scale.
+            for (int j = 0; j < BENCH_BLOCK_LEN; j++) {
+                block[j] = isin_S4(src_phase) * 4;
+                src_phase += 149;
+            }
+
+            uint32_t start = profile_cycles();
+            if (shift) {
+                decimate4(block, BENCH_BLOCK_LEN, drum);
+                amfm_rotor_process(&r, drum, BENCH_BLOCK_LEN / 4);
+                polyphase4_interpolate(&up, drum, BENCH_BLOCK_LEN / 4, block);
+            } else {
+                amfm_rotor_process(&r, block, BENCH_BLOCK_LEN);
+            }
+            profile_record(&bench_prof, profile_cycles() - start);
+        }
+        bench_report();
+    }
+}
+
+// bench_fused times the fused organ and Leslie kernels against the
+// same kernels run one after another, as the separate nodes run them.
+// The separate path copies where the graph would: the tonewheels'
+// block is shared with the monitor and the crossover's outputs with
+// both sides. It doesn't count the audio library's allocations.
+static void bench_fused() {
+    static uint16_t volumes[92];
+    static int16_t ring[VIBRATO_RING_LEN], table[PREAMP_TABLE_LEN + 1];
+    static int16_t block[BENCH_BLOCK_LEN], perc[BENCH_BLOCK_LEN], vib[BENCH_BLOCK_LEN];
+    static int16_t lo[BENCH_BLOCK_LEN], hi[BENCH_BLOCK_LEN], left[BENCH_BLOCK_LEN];
+    static int16_t bands[4][BENCH_BLOCK_LEN];
+    static vibrato_scanner v;
+    static monitor mon;
+    static envelope env;
+    static preamp_curve pre;
+    static crossover_filter xover;
+    static amfm_rotor rotors[2][2];
+
+    chord_volumes(volumes);
+    preamp_fill_table(table, 3);
+
+    for (int fused = 1; fused >= 0; fused--) {
+        tonewheel_osc *tonewheels = tonewheel_osc_new();
+        tonewheel_osc *percussion = tonewheel_osc_new();
+        tonewheel_osc_leak_b3(tonewheels, 3, 328);
+        tonewheel_osc_set_multirate(tonewheels, 2);
+        tonewheel_osc_set_volumes(tonewheels, volumes);
+        tonewheel_osc_set_volume(percussion, 61, 40000);
+
+        memset(ring, 0, sizeof(ring));
+        vibrato_init(&v, 1, 1);
+        monitor_init(&mon);
+        envelope_init(&env, 44100);
+        preamp_init(&pre);
+        preamp_set_table(&pre, table);
+        crossover_init(&xover);
+        for (int side = 0; side < 2; side++) {
+            for (int band = 0; band < 2; band++) {
+                amfm_rotor *r = &rotors[side][band];
+                amfm_rotor_init(r, fused && band == LESLIE_BASS ? LESLIE_DRUM_SHIFT : 0);
+                amfm_rotor_set_tremolo_depth(r, band == LESLIE_BASS ? 0.3 : 0.1);
+                amfm_rotor_set_directivity(r, 1500, 8000, 44100);
+                amfm_rotor_set_rotation_rate(r, band == LESLIE_BASS ? 5.7 : 6.66);
+            }
+        }
+
+        organ_console o;
+        organ_init(&o);
+        o.tonewheels = tonewheels;
+        o.vibrato = &v;
+        o.vibrato_ring = ring;
+        o.monitor = &mon;
+        o.percussion = percussion;
+        o.percussion_env = &env;
+
+        leslie_cabinet l;
+        leslie_init(&l);
+        l.preamp = &pre;
+        l.crossover = &xover;
+        for (int side = 0; side < 2; side++) {
+            for (int band = 0; band < 2; band++) {
+                l.rotors[side][band] = &rotors[side][band];
+            }
+        }
+
+        bench_start(fused ? "organ+leslie fused" : "organ+leslie separate");
+        for (int i = 0; i < BENCH_BLOCKS; i++) {
+            if (i % 100 == 0) {
+                envelope_note_on(&env);
+            }
+
+            uint32_t start = profile_cycles();
+            if (fused) {
+                organ_process(&o, block, BENCH_BLOCK_LEN);
+                leslie_process(&l, block, block, left, BENCH_BLOCK_LEN);
+            } else {
+                tonewheel_osc_fill(tonewheels, block, BENCH_BLOCK_LEN);
+                monitor_update(&mon, block, BENCH_BLOCK_LEN);
+                memcpy(vib, block, sizeof(vib));
+                vibrato_select(&v)(&v, ring, vib, vib, BENCH_BLOCK_LEN);
+                tonewheel_osc_fill(percussion, perc, BENCH_BLOCK_LEN);
+                envelope_process(&env, perc, BENCH_BLOCK_LEN);
+                for (int j = 0; j < BENCH_BLOCK_LEN; j++) {
+                    int32_t mix = vib[j] + perc[j];
+                    block[j] = mix > 32767 ? 32767 : (mix < -32768 ? -32768 : mix);
+                }
+
+                preamp_process(&pre, block, block, BENCH_BLOCK_LEN);
+                crossover_process(&xover, block, lo, hi, BENCH_BLOCK_LEN);
+                for (int side = 0; side < 2; side++) {
+                    memcpy(bands[side * 2], lo, sizeof(lo));
+                    memcpy(bands[side * 2 + 1], hi, sizeof(hi));
+                    amfm_rotor_process(&rotors[side][LESLIE_BASS], bands[side * 2], BENCH_BLOCK_LEN);
+                    amfm_rotor_process(&rotors[side][LESLIE_TREBLE], bands[side * 2 + 1], BENCH_BLOCK_LEN);
+                }
+                for (int j = 0; j < BENCH_BLOCK_LEN; j++) {
+                    int32_t r = bands[0][j] + bands[1][j];
+                    int32_t lt = bands[2][j] + bands[3][j];
+                    block[j] = r > 32767 ? 32767 : (r < -32768 ? -32768 : r);
+                    left[j] = lt > 32767 ? 32767 : (lt < -32768 ? -32768 : lt);
+                }
+            }
+            profile_record(&bench_prof, profile_cycles() - start);
+        }
+        bench_report();
+
+        // Then lift every key and time the blocks after the tails
+        // have died away, as the nodes run them.
+        if (fused) {
+            memset(volumes, 0, sizeof(volumes));
+            tonewheel_osc_set_volumes(tonewheels, volumes);
+            tonewheel_osc_set_volume(percussion, 61, 0);
+            envelope_note_off(&env);
+
+            bench_start("organ+leslie idle");
+            for (int i = 0; i < BENCH_BLOCKS; i++) {
+                uint32_t start = profile_cycles();
+                if (!organ_skip(&o, BENCH_BLOCK_LEN)) {
+                    organ_process(&o, block, BENCH_BLOCK_LEN);
+                    leslie_process(&l, block, block, left, BENCH_BLOCK_LEN);
+                } else if (leslie_ringing(&l)) {
+                    leslie_tail(&l, block, left, BENCH_BLOCK_LEN);
+                } else {
+                    leslie_skip(&l, BENCH_BLOCK_LEN);
+                }
+                profile_record(&bench_prof, profile_cycles() - start);
+            }
+            bench_report();
+            chord_volumes(volumes);
+        }
+
+        free(tonewheels);
+        free(percussion);
+    }
+}
+
+static void bench_reverb() {
+    static reverb r;
+    int16_t l[BENCH_BLOCK_LEN], rr[BENCH_BLOCK_LEN];
+
+    reverb_init(&r);
+    reverb_set(&r, 26000, 14000, 6000);
+
+    bench_start("reverb_process");
+    for (int i = 0; i < BENCH_BLOCKS; i++) {
+        for (int j = 0; j < BENCH_BLOCK_LEN; j++) {
+            l[j] = rand() % 20000 - 10000;
+            rr[j] = rand() % 20000 - 10000;
+        }
+        uint32_t start = profile_cycles();
+        reverb_process(&r, l, rr, l, rr, BENCH_BLOCK_LEN);
+        profile_record(&bench_prof, profile_cycles() - start);
+    }
+    bench_report();
+}
+
+static double bench_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// bench_sleep_until sleeps until bench_seconds() reaches _t_.
+static void bench_sleep_until(double t) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)t;
+    ts.tv_nsec = (long)((t - (double)ts.tv_sec) * 1e9);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+    }
+}
+
+// bench_conv reports the realtime factor (time spent in conv_process /
+// audio time; lower is better) of conv for 0.5s and 2s impulse
+// responses, with the tail inline and on its own thread. Block cycles
+// show the cost seen by the audio callback. Blocks are paced at real
+// time, as they'd arrive from the audio device, so late counts the
+// tail jobs that really missed their period.
+static void bench_conv() {
+    static const float ir_secs[] = {0.5f, 2.0f};
+    static const size_t tail_blocks[] = {1024, 4096};
+    static float in[CONV_BLOCK];
+    static float out[CONV_BLOCK];
+    const double secs = 3.0;
+    const int blocks = (int)(secs * 44100 / CONV_BLOCK);
+
+    for (size_t i = 0; i < sizeof(ir_secs) / sizeof(ir_secs[0]); i++) {
+        size_t ir_len = (size_t)(ir_secs[i] * 44100);
+        float *ir = (float *)malloc(sizeof(float) * ir_len);
+        for (size_t j = 0; j < ir_len; j++) {
+            ir[j] = ((float)rand() / RAND_MAX - 0.5f) * expf(-(float)j / (ir_len / 6.9f));
+        }
+
+        for (size_t t = 0; t < sizeof(tail_blocks) / sizeof(tail_blocks[0]); t++) {
+            for (int threaded = 0; threaded <= 1; threaded++) {
+                char name[96];
+                snprintf(name, sizeof(name), "conv ir=%.1fs tail=%d %s", ir_secs[i], (int)tail_blocks[t], threaded ? "threaded" : "inline");
+
+                conv *c = conv_new(ir, ir_len, tail_blocks[t], threaded);
+                bench_start(name);
+                double start = bench_seconds();
+                double busy = 0;
+                for (int b = 0; b < blocks; b++) {
+                    for (int j = 0; j < CONV_BLOCK; j++) {
+                        in[j] = (float)rand() / RAND_MAX - 0.5f;
+                    }
+                    bench_sleep_until(start + (double)b * CONV_BLOCK / 44100);
+
+                    double t0 = bench_seconds();
+                    uint32_t cycles = profile_cycles();
+                    conv_process(c, in, out);
+                    profile_record(&bench_prof, profile_cycles() - cycles);
+                    busy += bench_seconds() - t0;
+                }
+                bench_report();
+                printf("  rtf=%.4f late=%u\n", busy / secs, (unsigned)c->late);
+                conv_free(c);
+            }
+        }
+        free(ir);
+    }
+}
+
+int main(void) {
+    bench_tonewheel_leak();
+    bench_tonewheel_multirate();
+    bench_amfm();
+    bench_stopped();
+    bench_f32();
+    bench_crossover();
+    bench_drum();
+    bench_fused();
+    bench_reverb();
+    bench_conv();
+    return 0;
+}
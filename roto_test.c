@@ -5,8 +5,23 @@
 #include "greatest.h"
 
 extern SUITE(amfm_suite);
+extern SUITE(controls_suite);
+extern SUITE(conv_suite);
+extern SUITE(crossover_suite);
+extern SUITE(envelope_suite);
+extern SUITE(eventlog_suite);
+extern SUITE(fft_suite);
+extern SUITE(keyclick_suite);
+extern SUITE(leslie_suite);
 extern SUITE(manual_suite);
+extern SUITE(monitor_suite);
+extern SUITE(organ_suite);
+extern SUITE(preamp_suite);
+extern SUITE(profile_suite);
+extern SUITE(resample_suite);
+extern SUITE(reverb_suite);
 extern SUITE(tonewheel_osc_suite);
+extern SUITE(vibrato_suite);
 
 GREATEST_MAIN_DEFS();
 
@@ -14,8 +29,23 @@ int main(int argc, char **argv) {
     GREATEST_MAIN_BEGIN();
 
     RUN_SUITE(amfm_suite);
+    RUN_SUITE(controls_suite);
+    RUN_SUITE(conv_suite);
+    RUN_SUITE(crossover_suite);
+    RUN_SUITE(envelope_suite);
+    RUN_SUITE(eventlog_suite);
+    RUN_SUITE(fft_suite);
+    RUN_SUITE(keyclick_suite);
+    RUN_SUITE(leslie_suite);
     RUN_SUITE(manual_suite);
+    RUN_SUITE(monitor_suite);
+    RUN_SUITE(organ_suite);
+    RUN_SUITE(preamp_suite);
+    RUN_SUITE(profile_suite);
+    RUN_SUITE(resample_suite);
+    RUN_SUITE(reverb_suite);
     RUN_SUITE(tonewheel_osc_suite);
+    RUN_SUITE(vibrato_suite);
 
     GREATEST_MAIN_END();
 }
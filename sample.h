@@ -0,0 +1,79 @@
+/* Copyright (c) 2018 Peter Teichman */
+
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <stdint.h>
+
+// sat16 clamps x to int16, with one instruction on a Cortex-M4.
+static inline int16_t sat16(int32_t x) {
+#if defined(__ARM_ARCH_7EM__)
+    int32_t out;
+    asm("ssat %0, #16, %1" : "=r"(out) : "r"(x));
+    return out;
+#else
+    return x > 32767 ? 32767 : (x < -32768 ? -32768 : x);
+#endif
+}
+
+// sample_traits holds the arithmetic the kernels do on samples, so
+// one loop can be built for the Teensy's int16 blocks and for float
+// blocks on a host. Full scale is 32768 for int16 and 1.0 for float.
+//
+// The int16 versions are exactly the shifts the kernels always used;
+// acc is the type intermediate sums are kept in.
+#if defined(__cplusplus)
+extern "C++" {
+
+template <typename S>
+struct sample_traits;
+
+template <>
+struct sample_traits<int16_t> {
+    typedef int32_t acc;
+
+    // wheel scales a Q12 sine by a Q19 tonewheel volume.
+    static inline acc wheel(int32_t sine, uint32_t volume) {
+        return (sine * (int32_t)volume) >> 15;
+    }
+
+    // lerp moves from a toward b by scale/65536.
+    static inline acc lerp(acc a, acc b, uint16_t scale) {
+        return ((0xFFFF - scale) * a + scale * b) >> 16;
+    }
+
+    // gain scales x by a Q15 gain.
+    static inline acc gain(acc x, int32_t q15) {
+        return (x * q15) >> 15;
+    }
+
+    static inline acc mix(acc a, acc b) {
+        return (a + b) >> 1;
+    }
+};
+
+template <>
+struct sample_traits<float> {
+    typedef float acc;
+
+    static inline acc wheel(int32_t sine, uint32_t volume) {
+        // Q12 * Q19 >> 15 is int16 full scale; another 15 bits is 1.0.
+        return (float)(sine * (int32_t)volume) * (1.0f / (1 << 30));
+    }
+
+    static inline acc lerp(acc a, acc b, uint16_t scale) {
+        return a + (b - a) * ((float)scale * (1.0f / 65536));
+    }
+
+    static inline acc gain(acc x, int32_t q15) {
+        return x * ((float)q15 * (1.0f / 32768));
+    }
+
+    static inline acc mix(acc a, acc b) {
+        return (a + b) * 0.5f;
+    }
+};
+}
+#endif
+
+#endif
@@ -7,6 +7,11 @@ extern "C" {
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "sample.h"
 #include "tonewheel_osc.h"
 
 uint32_t freq_incr15(float freq);
@@ -116,6 +121,10 @@ tonewheel_osc *tonewheel_osc_new() {
         ret->phase_incrs[i] = freq_incr15(freqs[i]);
     }
 
+    ret->next_back = 0;
+    ret->next_mid = 1;
+    ret->next_front = 2;
+
     return ret;
 };
 
@@ -127,34 +136,474 @@ uint32_t freq_incr15(float freq) {
 }
 
 void tonewheel_osc_set_volume(tonewheel_osc *osc, uint8_t tonewheel, uint16_t volume) {
-    if (tonewheel > 0 && tonewheel < 92) {
+    if (tonewheel > 0 && tonewheel < 92 && osc->volumes[tonewheel] != volume) {
         osc->volumes[tonewheel] = volume;
+        osc->dirty = 1;
     }
 }
 
-void tonewheel_osc_fill(tonewheel_osc *osc, int16_t *block, size_t block_len) {
-    memset(block, 0, sizeof(int16_t) * block_len);
+int tonewheel_osc_set_volumes(tonewheel_osc *osc, const uint16_t volumes[92]) {
+    uint16_t *next = osc->next_volumes[osc->next_back];
+    uint32_t *changed = osc->next_changed[osc->next_back];
+    uint32_t *pending = osc->next_pending;
+    uint32_t fresh[3] = {0};
+
+    int n = 0;
+    for (int i = 1; i < 92; i++) {
+        uint16_t v = volumes[i];
+        next[i] = v;
+        if (v != osc->published[i]) {
+            osc->published[i] = v;
+            fresh[i >> 5] |= 1 << (i & 31);
+            n++;
+        }
+    }
+
+    if (n == 0) {
+        return 0;
+    }
+
+    // This vector may replace one fill hasn't taken, so it carries
+    // that one's changes too.
+    for (int w = 0; w < 3; w++) {
+        changed[w] = pending[w] | fresh[w];
+    }
+
+    uint8_t old = __atomic_exchange_n(&osc->next_mid, osc->next_back | TONEWHEEL_OSC_FRESH, __ATOMIC_ACQ_REL);
+    osc->next_back = old & ~TONEWHEEL_OSC_FRESH;
+
+    // If fill took the last vector, only this one's changes are
+    // still pending.
+    for (int w = 0; w < 3; w++) {
+        pending[w] = (old & TONEWHEEL_OSC_FRESH) ? pending[w] | fresh[w] : fresh[w];
+    }
+    return n;
+}
+
+// take_volumes copies the changed wheels of the last vector published
+// by tonewheel_osc_set_volumes into volumes.
+static void take_volumes(tonewheel_osc *osc) {
+    if (!(osc->next_mid & TONEWHEEL_OSC_FRESH)) {
+        return;
+    }
 
-    uint32_t phase;
-    uint32_t phase_incr;
-    uint32_t volume;
+    uint8_t old = __atomic_exchange_n(&osc->next_mid, osc->next_front, __ATOMIC_ACQ_REL);
+    osc->next_front = old & ~TONEWHEEL_OSC_FRESH;
+
+    const uint16_t *next = osc->next_volumes[osc->next_front];
+    const uint32_t *changed = osc->next_changed[osc->next_front];
+    for (int w = 0; w < 3; w++) {
+        for (uint32_t bits = changed[w]; bits != 0; bits &= bits - 1) {
+            int i = (w << 5) + __builtin_ctz(bits);
+            osc->volumes[i] = next[i];
+        }
+    }
+    osc->dirty = 1;
+}
+
+int tonewheel_osc_set_leak(tonewheel_osc *osc, uint8_t tonewheel, uint8_t neighbor, uint16_t gain) {
+    if (tonewheel < 1 || tonewheel > 91 || neighbor < 1 || neighbor > 91) {
+        return 0;
+    }
+
+    uint8_t n = osc->leak_lens[tonewheel];
+    if (n >= TONEWHEEL_OSC_LEAK_MAX) {
+        return 0;
+    }
+
+    osc->leak_wheels[tonewheel][n] = neighbor;
+    osc->leak_gains[tonewheel][n] = gain;
+    osc->leak_lens[tonewheel] = n + 1;
+    osc->dirty = 1;
+    return 1;
+}
+
+void tonewheel_osc_clear_leaks(tonewheel_osc *osc) {
+    memset(osc->leak_lens, 0, sizeof(osc->leak_lens));
+    osc->dirty = 1;
+}
+
+// The B3 generator houses its tonewheels in pairs, with wheel n
+// sharing a compartment (and a magnetic field) with wheel n+48. That
+// pair leaks the most; octave neighbors share the same filter
+// transformer wiring and leak about half as much.
+void tonewheel_osc_leak_b3(tonewheel_osc *osc, int density, uint16_t gain) {
+    tonewheel_osc_clear_leaks(osc);
+
+    for (int i = 1; i < 92; i++) {
+        int partner = i > 48 ? i - 48 : i + 48;
+        int neighbors[TONEWHEEL_OSC_LEAK_MAX] = {partner, i + 12, i - 12, i + 24};
+        uint16_t gains[TONEWHEEL_OSC_LEAK_MAX] = {gain, (uint16_t)(gain >> 1), (uint16_t)(gain >> 1), (uint16_t)(gain >> 2)};
+
+        for (int n = 0; n < density && n < TONEWHEEL_OSC_LEAK_MAX; n++) {
+            if (neighbors[n] < 1 || neighbors[n] > 91) {
+                continue;
+            }
+            tonewheel_osc_set_leak(osc, i, neighbors[n], gains[n]);
+        }
+    }
+}
 
-    for (int i = 13; i < 92; i++) {
-        phase = osc->phases[i];
-        phase_incr = osc->phase_incrs[i];
-        volume = (uint32_t)osc->volumes[i];
+// update_rendered recalculates the volumes to render, adding leakage
+// from each sounding tonewheel. This only walks the neighbors of
+// wheels that are sounding, so its cost follows the number of
+// sounding wheels rather than the size of the matrix. The leakage
+// itself costs nothing extra in tonewheel_osc_fill: a neighbor's
+// sine is computed once no matter how many wheels leak into it.
+static void update_rendered(tonewheel_osc *osc) {
+    memcpy(osc->rendered, osc->volumes, sizeof(osc->rendered));
+    memset(osc->active, 0, sizeof(osc->active));
 
+    for (int i = 1; i < 92; i++) {
+        uint32_t volume = osc->volumes[i];
         if (volume == 0) {
             continue;
         }
+        osc->active[i >> 5] |= 1 << (i & 31);
+
+        for (int n = 0; n < osc->leak_lens[i]; n++) {
+            uint8_t t = osc->leak_wheels[i][n];
+            uint32_t v = osc->rendered[t] + ((volume * osc->leak_gains[i][n]) >> 15);
+            osc->rendered[t] = v > 0xFFFF ? 0xFFFF : (uint16_t)v;
+            if (osc->rendered[t] != 0) {
+                osc->active[t >> 5] |= 1 << (t & 31);
+            }
+        }
+    }
+
+    osc->dirty = 0;
+}
+
+static int schedule_event(tonewheel_osc *osc, uint32_t time, uint8_t tonewheel, uint16_t volume, uint8_t ramp) {
+    uint32_t head = osc->events_head;
+    if (tonewheel < 1 || tonewheel > 91 || head - osc->events_tail >= TONEWHEEL_OSC_EVENTS) {
+        return 0;
+    }
+
+    tonewheel_osc_event *e = &osc->events[head & (TONEWHEEL_OSC_EVENTS - 1)];
+    e->time = time;
+    e->tonewheel = tonewheel;
+    e->ramp = ramp;
+    e->volume = volume;
+
+    __sync_synchronize();
+    osc->events_head = head + 1;
+    return 1;
+}
+
+int tonewheel_osc_schedule(tonewheel_osc *osc, uint32_t time, uint8_t tonewheel, uint16_t volume) {
+    return schedule_event(osc, time, tonewheel, volume, 0);
+}
+
+int tonewheel_osc_schedule_ramp(tonewheel_osc *osc, uint32_t time, uint8_t tonewheel, uint16_t volume) {
+    return schedule_event(osc, time, tonewheel, volume, 1);
+}
+
+int tonewheel_osc_schedule_ramps(tonewheel_osc *osc, uint32_t time, const uint16_t volumes[92], const uint32_t wheels[3]) {
+    // Tonewheels 1..91.
+    static const uint32_t valid[3] = {0xFFFFFFFE, 0xFFFFFFFF, 0x0FFFFFFF};
+
+    uint32_t n = 0;
+    for (int w = 0; w < 3; w++) {
+        n += __builtin_popcount(wheels[w] & valid[w]);
+    }
+
+    uint32_t head = osc->events_head;
+    if (n > TONEWHEEL_OSC_EVENTS - (head - osc->events_tail)) {
+        return 0;
+    }
 
-        for (size_t j = 0; j < block_len; j++) {
-            phase += phase_incr;
-            // isin_S4 is Q12; volume is Q19
-            block[j] += (isin_S4(phase) * volume) >> 15;
+    for (int w = 0; w < 3; w++) {
+        for (uint32_t bits = wheels[w] & valid[w]; bits != 0; bits &= bits - 1) {
+            int t = (w << 5) + __builtin_ctz(bits);
+            tonewheel_osc_event *e = &osc->events[head++ & (TONEWHEEL_OSC_EVENTS - 1)];
+            e->time = time;
+            e->tonewheel = (uint8_t)t;
+            e->ramp = 1;
+            e->volume = volumes[t];
         }
-        osc->phases[i] = phase;
     }
+
+    __sync_synchronize();
+    osc->events_head = head;
+    return 1;
+}
+
+uint32_t tonewheel_osc_schedule_room(tonewheel_osc *osc) {
+    return TONEWHEEL_OSC_EVENTS - (osc->events_head - osc->events_tail);
+}
+
+// The fill path is templated on the sample type; see sample.h.
+extern "C++" {
+
+// fill_wheel adds one tonewheel at _volume_ to block[from..to).
+template <typename S>
+static inline void fill_wheel(typename sample_traits<S>::acc *block, size_t from, size_t to, uint32_t *phase_out, uint32_t phase_incr, uint32_t volume) {
+    uint32_t phase = *phase_out;
+
+    if (volume == 0) {
+        *phase_out = phase + phase_incr * (to - from);
+        return;
+    }
+
+    for (size_t j = from; j < to; j++) {
+        phase += phase_incr;
+        block[j] += sample_traits<S>::wheel(isin_S4(phase), volume);
+    }
+    *phase_out = phase;
+}
+
+// fill_ramp is fill_wheel with the volume moving linearly from
+// _from_volume_ to _to_volume_ across block[from..to).
+template <typename S>
+static inline void fill_ramp(typename sample_traits<S>::acc *block, size_t from, size_t to, uint32_t *phase_out, uint32_t phase_incr, int32_t from_volume, int32_t to_volume) {
+    if (to <= from) {
+        return;
+    }
+
+    uint32_t phase = *phase_out;
+    int32_t volume = from_volume << 15;
+    int32_t volume_incr = ((to_volume - from_volume) << 15) / (int32_t)(to - from);
+
+    for (size_t j = from; j < to; j++) {
+        phase += phase_incr;
+        volume += volume_incr;
+        block[j] += sample_traits<S>::wheel(isin_S4(phase), (uint32_t)(volume >> 15));
+    }
+    *phase_out = phase;
+}
+
+// take_due moves the events due before the end of this block from the
+// schedule into osc->due, replacing each event's time with its offset
+// into the block. It marks the tonewheels with events in changing.
+//
+// The schedule is scanned to its end, so an event for now isn't held
+// up behind others queued for later blocks, like keyclick contacts.
+// An event that comes due drops its wheel's earlier events that
+// haven't: they were scheduled with volumes it has replaced.
+static size_t take_due(tonewheel_osc *osc, size_t block_len, uint32_t changing[3]) {
+    const uint32_t mask = TONEWHEEL_OSC_EVENTS - 1;
+    uint32_t start = osc->clock;
+    uint32_t end = start + block_len;
+    uint32_t tail = osc->events_tail;
+    uint32_t head = osc->events_head;
+    uint32_t held[3] = {0};
+    size_t num_due = 0;
+
+    __sync_synchronize();
+    for (uint32_t n = tail; n != head; n++) {
+        tonewheel_osc_event *e = &osc->events[n & mask];
+        uint32_t bit = 1 << (e->tonewheel & 31);
+        if ((int32_t)(e->time - end) >= 0) {
+            held[e->tonewheel >> 5] |= bit;
+            continue;
+        }
+
+        if (held[e->tonewheel >> 5] & bit) {
+            for (uint32_t m = tail; m != n; m++) {
+                if (osc->events[m & mask].tonewheel == e->tonewheel) {
+                    osc->events[m & mask].tonewheel = 0;
+                }
+            }
+            held[e->tonewheel >> 5] &= ~bit;
+        }
+
+        tonewheel_osc_event d = *e;
+        int32_t offset = (int32_t)(d.time - start);
+        d.time = offset < 0 ? 0 : offset;
+        osc->due[num_due++] = d;
+        changing[d.tonewheel >> 5] |= bit;
+
+        // Mark it taken; the producer never writes between tail and
+        // head.
+        e->tonewheel = 0;
+    }
+
+    // Slide the held events up against head, in order, and release
+    // the slots below them.
+    if (num_due > 0) {
+        uint32_t w = head;
+        for (uint32_t n = head; n != tail; n--) {
+            tonewheel_osc_event *e = &osc->events[(n - 1) & mask];
+            if (e->tonewheel != 0) {
+                osc->events[--w & mask] = *e;
+            }
+        }
+        tail = w;
+    }
+
+    __sync_synchronize();
+    osc->events_tail = tail;
+    return num_due;
+}
+
+// fill_changing renders a tonewheel with scheduled volume changes,
+// one segment per event. A ramped event's segment moves to its volume
+// gradually, reaching it at the wheel's next event or the end of the
+// block. _block_ is at 1/(1 << shift) of the sample rate.
+template <typename S>
+static void fill_changing(tonewheel_osc *osc, int i, typename sample_traits<S>::acc *block, size_t block_len, int shift, size_t num_due) {
+    uint32_t phase = osc->phases[i];
+    uint32_t phase_incr = osc->phase_incrs[i] << shift;
+    int32_t start = osc->rendered[i];
+    int32_t volume = start;
+    size_t from = 0;
+
+    for (size_t n = 0; n < num_due; n++) {
+        tonewheel_osc_event *e = &osc->due[n];
+        if (e->tonewheel != i) {
+            continue;
+        }
+
+        size_t to = e->time >> shift;
+        to = to > from ? to : from;
+        if (start != volume) {
+            fill_ramp<S>(block, from, to, &phase, phase_incr, start, volume);
+        } else {
+            fill_wheel<S>(block, from, to, &phase, phase_incr, (uint32_t)volume);
+        }
+        from = to;
+
+        // Leakage into this wheel is carried over; leakage out of it
+        // is updated at the next block.
+        start = volume;
+        volume += (int32_t)e->volume - (int32_t)osc->volumes[i];
+        volume = volume < 0 ? 0 : (volume > 0xFFFF ? 0xFFFF : volume);
+        osc->volumes[i] = e->volume;
+        if (!e->ramp) {
+            start = volume;
+        }
+    }
+    if (start != volume) {
+        fill_ramp<S>(block, from, block_len, &phase, phase_incr, start, volume);
+    } else {
+        fill_wheel<S>(block, from, block_len, &phase, phase_incr, (uint32_t)volume);
+    }
+
+    osc->phases[i] = phase;
+    osc->rendered[i] = (uint16_t)volume;
+    osc->dirty = 1;
+}
+
+// fill_wheels renders the active and changing tonewheels in
+// first..last into _block_, at 1/(1 << shift) of the sample rate.
+template <typename S>
+static void fill_wheels(tonewheel_osc *osc, int first, int last, typename sample_traits<S>::acc *block, size_t block_len, int shift, const uint32_t changing[3], size_t num_due) {
+    for (int w = first >> 5; w <= last >> 5; w++) {
+        for (uint32_t bits = osc->active[w] | changing[w]; bits != 0; bits &= bits - 1) {
+            int i = (w << 5) + __builtin_ctz(bits);
+            if (i < first || i > last) {
+                continue;
+            }
+
+            if (changing[w] & (1 << (i & 31))) {
+                fill_changing<S>(osc, i, block, block_len, shift, num_due);
+                continue;
+            }
+            fill_wheel<S>(block, 0, block_len, &osc->phases[i], osc->phase_incrs[i] << shift, osc->rendered[i]);
+        }
+    }
+}
+
+}
+
+void tonewheel_osc_set_multirate(tonewheel_osc *osc, int shift) {
+    if (shift < 0 || shift > 2 || shift == osc->low_shift) {
+        return;
+    }
+
+    osc->low_shift = shift;
+    halfband_init(&osc->low_up[0]);
+    halfband_init(&osc->low_up[1]);
+}
+
+// saturate writes acc[i] + block[i] (if _add_) to block, saturated to
+// int16.
+static inline void saturate(const int32_t *acc, int16_t *block, size_t len, const int add) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    // packs saturates eight at a time.
+    for (; i + 8 <= len; i += 8) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)&acc[i]);
+        __m128i hi = _mm_loadu_si128((const __m128i *)&acc[i + 4]);
+        if (add) {
+            __m128i b = _mm_loadu_si128((const __m128i *)&block[i]);
+            lo = _mm_add_epi32(lo, _mm_srai_epi32(_mm_unpacklo_epi16(b, b), 16));
+            hi = _mm_add_epi32(hi, _mm_srai_epi32(_mm_unpackhi_epi16(b, b), 16));
+        }
+        _mm_storeu_si128((__m128i *)&block[i], _mm_packs_epi32(lo, hi));
+    }
+#endif
+    for (; i < len; i++) {
+        block[i] = sat16(acc[i] + (add ? block[i] : 0));
+    }
+}
+
+void tonewheel_osc_fill(tonewheel_osc *osc, int16_t *block, size_t block_len) {
+    take_volumes(osc);
+    if (osc->dirty) {
+        update_rendered(osc);
+    }
+
+    uint32_t changing[3] = {0};
+    size_t num_due = take_due(osc, block_len, changing);
+    osc->quiet = num_due == 0 && (osc->active[0] | osc->active[1] | osc->active[2]) == 0;
+
+    // Wheels are summed in 32 bits and saturated once at the end, so
+    // any number of them can sound at once without wrapping.
+    int32_t *acc = osc->acc;
+
+    int shift = osc->low_shift;
+    int first = 1;
+    if (shift > 0) {
+        // Render the low wheels at the reduced rate, then upsample
+        // their sum straight into block, one octave per stage.
+        int16_t *low = osc->low_scratch[0];
+        size_t low_len = block_len >> shift;
+        memset(acc, 0, sizeof(int32_t) * low_len);
+        fill_wheels<int16_t>(osc, 1, TONEWHEEL_OSC_LOW_WHEELS, acc, low_len, shift, changing, num_due);
+        saturate(acc, low, low_len, 0);
+
+        if (shift == 2) {
+            halfband_interpolate(&osc->low_up[1], low, low_len, osc->low_scratch[1]);
+            low = osc->low_scratch[1];
+            low_len *= 2;
+        }
+        halfband_interpolate(&osc->low_up[0], low, low_len, block);
+        first = TONEWHEEL_OSC_LOW_WHEELS + 1;
+    }
+
+    memset(acc, 0, sizeof(int32_t) * block_len);
+    fill_wheels<int16_t>(osc, first, 91, acc, block_len, 0, changing, num_due);
+    saturate(acc, block, block_len, shift > 0);
+
+    osc->clock += block_len;
+}
+
+int tonewheel_osc_silent(const tonewheel_osc *osc) {
+    return osc->quiet && !osc->dirty && !(osc->next_mid & TONEWHEEL_OSC_FRESH) && osc->events_tail == osc->events_head;
+}
+
+void tonewheel_osc_skip(tonewheel_osc *osc, size_t block_len) {
+    osc->clock += block_len;
+}
+
+void tonewheel_osc_fill_f32(tonewheel_osc *osc, float *block, size_t block_len) {
+    take_volumes(osc);
+    if (osc->dirty) {
+        update_rendered(osc);
+    }
+
+    uint32_t changing[3] = {0};
+    size_t num_due = take_due(osc, block_len, changing);
+    osc->quiet = num_due == 0 && (osc->active[0] | osc->active[1] | osc->active[2]) == 0;
+
+    // Every wheel is rendered at the full rate: the upsamplers are
+    // int16 only, and hosts have the cycles to spare.
+    memset(block, 0, sizeof(float) * block_len);
+    fill_wheels<float>(osc, 1, 91, block, block_len, 0, changing, num_due);
+
+    osc->clock += block_len;
 }
 
 /// A sine approximation via a third-order approx.
@@ -184,7 +633,7 @@ int32_t isin_S3(int32_t x) {
 /// @param x    Angle (with 2^15 units/circle)
 /// @return     Sine value (Q12)
 int32_t isin_S4(int32_t x) {
-    int c, x2, y;
+    int c, y;
     static const int qN = 13, qA = 12, B = 19900, C = 3516;
 
     c = x << (30 - qN); // Semi-circle info into carry.
@@ -10,18 +10,181 @@ extern "C" {
 #include <stddef.h>
 #include <stdint.h>
 
+#include "resample.h"
+
+// Each tonewheel can leak into at most this many others.
+#define TONEWHEEL_OSC_LEAK_MAX (4)
+
+// The schedule holds this many volume changes. It must be a power of
+// two.
+#define TONEWHEEL_OSC_EVENTS (128)
+
+// Tonewheels 1..TONEWHEEL_OSC_LOW_WHEELS are all below 330Hz, and
+// can be rendered at a reduced rate; see tonewheel_osc_set_multirate.
+#define TONEWHEEL_OSC_LOW_WHEELS (40)
+
+// next_mid has this set while it holds a vector fill hasn't taken.
+#define TONEWHEEL_OSC_FRESH (0x80)
+
+// Blocks can be at most this long.
+#define TONEWHEEL_OSC_BLOCK_MAX (128)
+
+// tonewheel_osc_event is a volume change for one tonewheel at a
+// sample time.
+typedef struct _tonewheel_osc_event {
+    uint32_t time;
+    uint8_t tonewheel;
+    uint8_t ramp;
+    uint16_t volume;
+} tonewheel_osc_event;
+
 // tonewheel_osc simulates a set of Hammond B3 tonewheels.
 typedef struct _tonewheel_osc {
     uint32_t phase_incrs[92];
     uint32_t phases[92];
     uint16_t volumes[92];
+
+    // Crosstalk between tonewheels is a sparse matrix: when wheel i
+    // is sounding at volume v, wheel leak_wheels[i][n] also sounds at
+    // v * leak_gains[i][n] (Q15).
+    uint8_t leak_lens[92];
+    uint8_t leak_wheels[92][TONEWHEEL_OSC_LEAK_MAX];
+    uint16_t leak_gains[92][TONEWHEEL_OSC_LEAK_MAX];
+
+    // The volumes actually rendered: volumes plus leakage. These are
+    // recalculated when dirty is set.
+    uint16_t rendered[92];
+    uint8_t dirty;
+
+    // clock is the sample time at the start of the next block.
+    volatile uint32_t clock;
+
+    // events is a single producer, single consumer queue of scheduled
+    // volume changes. due holds the events for the current block.
+    volatile uint32_t events_head;
+    volatile uint32_t events_tail;
+    tonewheel_osc_event events[TONEWHEEL_OSC_EVENTS];
+    tonewheel_osc_event due[TONEWHEEL_OSC_EVENTS];
+
+    // The low wheels are rendered at 1/(1 << low_shift) of the sample
+    // rate into low_scratch, then upsampled by low_up.
+    uint8_t low_shift;
+    halfband low_up[2];
+    int16_t low_scratch[2][TONEWHEEL_OSC_BLOCK_MAX];
+
+    // tonewheel_osc_set_volumes publishes whole volume vectors
+    // through a triple buffer. The writer owns slot next_back and
+    // fill owns next_front; each swaps its slot with next_mid, which
+    // holds the newest vector with TONEWHEEL_OSC_FRESH set until fill
+    // takes it. Neither side ever touches a slot the other is using,
+    // even on different cores. Only the wheels set in next_changed
+    // are copied into volumes. set_volumes keeps its own copy of the
+    // last vector it published to diff against, and in next_pending
+    // the changes fill may not have taken yet.
+    uint16_t next_volumes[3][92];
+    uint32_t next_changed[3][3];
+    volatile uint8_t next_mid;
+    uint8_t next_back;
+    uint8_t next_front;
+    uint16_t published[92];
+    uint32_t next_pending[3];
+
+    // active marks the wheels with a nonzero rendered volume; fill
+    // skips the rest.
+    uint32_t active[3];
+
+    // quiet is set by a fill that had no active or changing wheels.
+    // Only the upsamplers' short history reached its output, so every
+    // block after it is zero.
+    uint8_t quiet;
+
+    // acc is the 32-bit sum of the wheels, saturated into the output
+    // block once per fill.
+    int32_t acc[TONEWHEEL_OSC_BLOCK_MAX];
 } tonewheel_osc;
 
 tonewheel_osc *tonewheel_osc_new();
 void tonewheel_osc_set_volume(tonewheel_osc *osc, uint8_t tonewheel, uint16_t volume);
 
+// tonewheel_osc_set_volumes sets the volumes of tonewheels 1..91 at
+// once. They take effect together at the start of the next block, so
+// no block renders a mix of old and new volumes. Like the schedule,
+// it may be called from outside the audio interrupt, by one writer at
+// a time, and fill may run on another core. It returns the number of
+// wheels that changed. Don't mix it with tonewheel_osc_set_volume on
+// the same osc.
+int tonewheel_osc_set_volumes(tonewheel_osc *osc, const uint16_t volumes[92]);
+
+// tonewheel_osc_schedule sets the volume of _tonewheel_ starting at
+// sample _time_ (compared with clock). Events for one tonewheel take
+// effect in the order they were scheduled; events for times already
+// passed take effect at the start of the next block. Volumes are
+// absolute, so an event that comes due replaces its tonewheel's
+// earlier events that are still in the future. Only tonewheels with
+// events in a block pay for them. It returns 0 if the schedule is
+// full.
+int tonewheel_osc_schedule(tonewheel_osc *osc, uint32_t time, uint8_t tonewheel, uint16_t volume);
+
+// tonewheel_osc_schedule_ramp is tonewheel_osc_schedule with a short
+// crossfade instead of a step: the volume moves linearly from _time_
+// until the tonewheel's next event or the end of that block,
+// whichever is first. Schedule at the start of a block for the
+// smoothest change.
+int tonewheel_osc_schedule_ramp(tonewheel_osc *osc, uint32_t time, uint8_t tonewheel, uint16_t volume);
+
+// tonewheel_osc_schedule_ramps schedules a ramp at _time_ to
+// volumes[t] for every tonewheel t set in _wheels_ (bit t & 31 of
+// wheels[t >> 5]). It's all or nothing: if there isn't room for every
+// ramp it schedules none and returns 0. The ramps are published
+// together, so they all start in the same block.
+int tonewheel_osc_schedule_ramps(tonewheel_osc *osc, uint32_t time, const uint16_t volumes[92], const uint32_t wheels[3]);
+
+// tonewheel_osc_schedule_room returns the number of events that can
+// be scheduled right now.
+uint32_t tonewheel_osc_schedule_room(tonewheel_osc *osc);
+
+// tonewheel_osc_set_leak makes _tonewheel_ leak into _neighbor_ with
+// a Q15 _gain_. It returns 0 if _tonewheel_ has no room for another
+// neighbor.
+int tonewheel_osc_set_leak(tonewheel_osc *osc, uint8_t tonewheel, uint8_t neighbor, uint16_t gain);
+void tonewheel_osc_clear_leaks(tonewheel_osc *osc);
+
+// tonewheel_osc_leak_b3 sets up B3 style crosstalk with up to
+// _density_ neighbors per tonewheel, strongest first: the wheel
+// sharing its generator compartment, then its octave neighbors.
+void tonewheel_osc_leak_b3(tonewheel_osc *osc, int density, uint16_t gain);
+
+// tonewheel_osc_set_multirate renders the low tonewheels at 1/2
+// (_shift_ 1) or 1/4 (_shift_ 2) of the sample rate, summed and
+// upsampled once per block. They're delayed by a few samples relative
+// to the others, which is inaudible. _shift_ 0 renders everything at
+// full rate, the default.
+//
+// In multirate mode, block_len must be a multiple of 1 << shift.
+void tonewheel_osc_set_multirate(tonewheel_osc *osc, int shift);
+
+// tonewheel_osc_fill renders _block_len_ samples, at most
+// TONEWHEEL_OSC_BLOCK_MAX, into block. The output saturates rather
+// than wrapping when the wheels add up past full scale.
 void tonewheel_osc_fill(tonewheel_osc *osc, int16_t *block, size_t block_len);
 
+// tonewheel_osc_fill_f32 is tonewheel_osc_fill for float blocks, where
+// 1.0 is int16 full scale. It has headroom for any number of wheels
+// and always renders at the full rate. Use one or the other per osc.
+void tonewheel_osc_fill_f32(tonewheel_osc *osc, float *block, size_t block_len);
+
+// tonewheel_osc_silent returns nonzero if the next fill would render
+// nothing but zeros: the last fill was quiet and no volume change is
+// scheduled or published since. Skip the block with tonewheel_osc_skip
+// instead of rendering it. That fill may have ended the sound
+// abruptly, so whatever follows the osc should clear its history.
+int tonewheel_osc_silent(const tonewheel_osc *osc);
+
+// tonewheel_osc_skip stands in for filling a silent block: it only
+// advances the clock. Silent wheels' phases don't advance in fill
+// either.
+void tonewheel_osc_skip(tonewheel_osc *osc, size_t block_len);
+
 int32_t isin_S3(int32_t x);
 int32_t isin_S4(int32_t x);
 
@@ -6,18 +6,72 @@
 #include <Audio.h>
 #include "tonewheel_osc.h"
 
+// TonewheelOscCore holds a tonewheel_osc oscillator block and its
+// controls, without an AudioStream, so the Organ node can own one.
+class TonewheelOscCore {
+  public:
+    void init() {
+        osc = tonewheel_osc_new();
+
+        // Leak each tonewheel into its compartment partner at -40dB
+        // and its octave neighbors at -46dB.
+        tonewheel_osc_leak_b3(osc, 3, 328);
+
+        // Render the tonewheels below 330Hz at 11kHz.
+        tonewheel_osc_set_multirate(osc, 2);
+    }
+
+    // clock returns the sample time at the start of the next block.
+    uint32_t clock() {
+        return osc->clock;
+    }
+
+    // schedule sets one tonewheel's volume at a sample time. It
+    // returns false if the schedule is full.
+    bool schedule(uint32_t time, int tonewheel, uint16_t volume) {
+        return tonewheel_osc_schedule(osc, time, tonewheel, volume);
+    }
+
+    // scheduleRamp is schedule with a short crossfade to the new
+    // volume; see tonewheel_osc_schedule_ramp.
+    bool scheduleRamp(uint32_t time, int tonewheel, uint16_t volume) {
+        return tonewheel_osc_schedule_ramp(osc, time, tonewheel, volume);
+    }
+
+    // scheduleRamps schedules a ramp for every tonewheel set in
+    // _wheels_ at once, or none of them; see
+    // tonewheel_osc_schedule_ramps.
+    bool scheduleRamps(uint32_t time, const uint16_t volumes[92], const uint32_t wheels[3]) {
+        return tonewheel_osc_schedule_ramps(osc, time, volumes, wheels);
+    }
+
+    uint32_t scheduleRoom() {
+        return tonewheel_osc_schedule_room(osc);
+    }
+
+    // setVolumes sets every tonewheel's volume, starting together at
+    // the next block.
+    void setVolumes(uint16_t volumes[92]) {
+        tonewheel_osc_set_volumes(osc, volumes);
+    }
+
+    tonewheel_osc *osc;
+};
+
 // TonewheelOsc is a Teensy AudioStream wrapper around the
 // tonewheel_osc oscillator block.
-class TonewheelOsc : public AudioStream {
+class TonewheelOsc : public AudioStream, public TonewheelOscCore {
   public:
     TonewheelOsc() : AudioStream(0, NULL) {
     }
 
-    void init() {
-        osc = tonewheel_osc_new();
-    }
-
     void update() {
+        // Silence is sent as no block at all.
+        if (tonewheel_osc_silent(osc)) {
+            tonewheel_osc_skip(osc, AUDIO_BLOCK_SAMPLES);
+            return;
+        }
+
         audio_block_t *block;
         block = allocate();
         if (!block) {
@@ -27,15 +81,6 @@ class TonewheelOsc : public AudioStream {
         transmit(block, 0);
         release(block);
     }
-
-    void setVolumes(uint16_t volumes[92]) {
-        for (int i = 1; i < 92; i++) {
-            tonewheel_osc_set_volume(osc, i, volumes[i]);
-        }
-    }
-
-  private:
-    tonewheel_osc *osc;
 };
 
 #endif
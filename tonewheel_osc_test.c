@@ -2,6 +2,11 @@
 
 #ifdef ROTO_TEST
 
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "greatest.h"
 
 #include "tonewheel_osc.h"
@@ -43,9 +48,516 @@ TEST test_tonewheel_osc_fill1() {
     PASS();
 }
 
+// test_tonewheel_osc_pedal_wheels ensures the lowest tonewheels,
+// used only by the pedals, are rendered.
+TEST test_tonewheel_osc_pedal_wheels() {
+    tonewheel_osc *osc = tonewheel_osc_new();
+
+    int16_t block[64];
+    for (int t = 1; t < 13; t++) {
+        tonewheel_osc_set_volume(osc, t, 1000);
+        tonewheel_osc_fill(osc, block, 64);
+
+        int nonzero = 0;
+        for (int i = 0; i < 64; i++) {
+            nonzero |= block[i] != 0;
+        }
+        ASSERT(nonzero);
+        tonewheel_osc_set_volume(osc, t, 0);
+    }
+
+    free(osc);
+    PASS();
+}
+
+// test_tonewheel_osc_leak ensures leakage sounds exactly like
+// setting the neighbor's volume directly.
+TEST test_tonewheel_osc_leak() {
+    tonewheel_osc *leaky = tonewheel_osc_new();
+    tonewheel_osc_set_leak(leaky, 46, 58, 1 << 14);
+    tonewheel_osc_set_volume(leaky, 46, 1000);
+
+    tonewheel_osc *direct = tonewheel_osc_new();
+    tonewheel_osc_set_volume(direct, 46, 1000);
+    tonewheel_osc_set_volume(direct, 58, 500);
+
+    int16_t got[64];
+    int16_t want[64];
+    tonewheel_osc_fill(leaky, got, 64);
+    tonewheel_osc_fill(direct, want, 64);
+    ASSERT_MEM_EQ(want, got, sizeof(want));
+
+    // A silent wheel leaks nothing.
+    tonewheel_osc_set_volume(leaky, 46, 0);
+    tonewheel_osc_fill(leaky, got, 64);
+    for (int i = 0; i < 64; i++) {
+        ASSERT_EQ_FMT(0, got[i], "%d");
+    }
+
+    free(leaky);
+    free(direct);
+    PASS();
+}
+
+TEST test_tonewheel_osc_leak_b3() {
+    tonewheel_osc *osc = tonewheel_osc_new();
+
+    tonewheel_osc_leak_b3(osc, 1, 100);
+    ASSERT_EQ_FMT(1, osc->leak_lens[30], "%d");
+    ASSERT_EQ_FMT(78, osc->leak_wheels[30][0], "%d");
+    ASSERT_EQ_FMT(30, osc->leak_wheels[78][0], "%d");
+
+    // Neighbors outside 1..91 are skipped.
+    tonewheel_osc_leak_b3(osc, TONEWHEEL_OSC_LEAK_MAX, 100);
+    ASSERT_EQ_FMT(4, osc->leak_lens[30], "%d");
+    ASSERT_EQ_FMT(3, osc->leak_lens[5], "%d");
+    ASSERT_EQ_FMT(2, osc->leak_lens[85], "%d");
+
+    // Each wheel has a limited number of neighbors.
+    ASSERT_EQ(0, tonewheel_osc_set_leak(osc, 30, 31, 100));
+
+    free(osc);
+    PASS();
+}
+
+// test_tonewheel_osc_schedule ensures a scheduled volume change
+// takes effect at its exact sample, and leaves the other wheels
+// sounding as if it never happened.
+TEST test_tonewheel_osc_schedule() {
+    tonewheel_osc *sched = tonewheel_osc_new();
+    tonewheel_osc_set_volume(sched, 20, 1000);
+
+    tonewheel_osc *direct = tonewheel_osc_new();
+    tonewheel_osc_set_volume(direct, 20, 1000);
+
+    int16_t got[64];
+    int16_t want[64];
+
+    // Wheel 46 turns on 10 samples into the second block.
+    tonewheel_osc_fill(sched, got, 64);
+    tonewheel_osc_fill(direct, want, 64);
+    ASSERT_EQ_FMT(64, sched->clock, "%d");
+
+    ASSERT(tonewheel_osc_schedule(sched, 74, 46, 1000));
+    ASSERT_EQ_FMT(TONEWHEEL_OSC_EVENTS - 1, tonewheel_osc_schedule_room(sched), "%d");
+    tonewheel_osc_fill(sched, got, 64);
+    tonewheel_osc_fill(direct, want, 64);
+    ASSERT_MEM_EQ(want, got, 10 * sizeof(int16_t));
+    ASSERT(memcmp(want + 10, got + 10, 54 * sizeof(int16_t)) != 0);
+    ASSERT_EQ_FMT(1000, sched->volumes[46], "%d");
+    ASSERT_EQ_FMT(TONEWHEEL_OSC_EVENTS, tonewheel_osc_schedule_room(sched), "%d");
+
+    // Events in the past take effect at the start of the next block.
+    ASSERT(tonewheel_osc_schedule(sched, 0, 46, 0));
+    tonewheel_osc_set_volume(direct, 46, 0);
+    tonewheel_osc_fill(sched, got, 64);
+    tonewheel_osc_fill(direct, want, 64);
+    ASSERT_MEM_EQ(want, got, sizeof(want));
+
+    // Events in the future wait.
+    ASSERT(tonewheel_osc_schedule(sched, 1000, 20, 0));
+    tonewheel_osc_fill(sched, got, 64);
+    tonewheel_osc_fill(direct, want, 64);
+    ASSERT_MEM_EQ(want, got, sizeof(want));
+    ASSERT_EQ_FMT(1000, sched->volumes[20], "%d");
+
+    free(sched);
+    free(direct);
+    PASS();
+}
+
+// test_tonewheel_osc_schedule_ramp ensures a ramped event fades in
+// across the block instead of stepping.
+TEST test_tonewheel_osc_schedule_ramp() {
+    tonewheel_osc *osc = tonewheel_osc_new();
+    tonewheel_osc *direct = tonewheel_osc_new();
+
+    ASSERT(tonewheel_osc_schedule_ramp(osc, 0, 46, 10000));
+    tonewheel_osc_set_volume(direct, 46, 10000);
+
+    int16_t want[128], got[128];
+    tonewheel_osc_fill(osc, got, 128);
+    tonewheel_osc_fill(direct, want, 128);
+
+    int early_want = 0, early_got = 0;
+    for (int i = 0; i < 32; i++) {
+        early_want += abs(want[i]);
+        early_got += abs(got[i]);
+    }
+    ASSERT(early_got * 4 < early_want);
+    for (int i = 120; i < 128; i++) {
+        ASSERT_IN_RANGE(want[i] * (i + 1) / 128, got[i], 3);
+    }
+    ASSERT_EQ_FMT(10000, osc->volumes[46], "%d");
+
+    // The ramp is done by the next block.
+    tonewheel_osc_fill(osc, got, 128);
+    tonewheel_osc_fill(direct, want, 128);
+    ASSERT_MEM_EQ(want, got, sizeof(want));
+
+    free(osc);
+    free(direct);
+    PASS();
+}
+
+TEST test_tonewheel_osc_schedule_full() {
+    tonewheel_osc *osc = tonewheel_osc_new();
+
+    for (int i = 0; i < TONEWHEEL_OSC_EVENTS; i++) {
+        ASSERT(tonewheel_osc_schedule(osc, i, 46, i));
+    }
+    ASSERT_EQ(0, tonewheel_osc_schedule(osc, 0, 46, 0));
+    ASSERT_EQ(0, tonewheel_osc_schedule_room(osc));
+
+    // Every event due in the block is taken, in order.
+    int16_t block[TONEWHEEL_OSC_EVENTS];
+    tonewheel_osc_fill(osc, block, TONEWHEEL_OSC_EVENTS);
+    ASSERT_EQ_FMT(TONEWHEEL_OSC_EVENTS - 1, osc->volumes[46], "%d");
+    ASSERT_EQ_FMT(TONEWHEEL_OSC_EVENTS, tonewheel_osc_schedule_room(osc), "%d");
+
+    free(osc);
+    PASS();
+}
+
+// test_tonewheel_osc_schedule_overtake ensures an event for now isn't
+// held up behind events queued for later, and replaces its wheel's
+// earlier events that are still to come.
+TEST test_tonewheel_osc_schedule_overtake() {
+    tonewheel_osc *osc = tonewheel_osc_new();
+    int16_t block[64];
+
+    ASSERT(tonewheel_osc_schedule(osc, 200, 10, 1000));
+    ASSERT(tonewheel_osc_schedule(osc, 300, 11, 1000));
+    ASSERT(tonewheel_osc_schedule_ramp(osc, 0, 20, 2000));
+    ASSERT(tonewheel_osc_schedule(osc, 0, 10, 3000));
+
+    tonewheel_osc_fill(osc, block, 64);
+    ASSERT_EQ_FMT(2000, osc->volumes[20], "%d");
+    ASSERT_EQ_FMT(3000, osc->volumes[10], "%d");
+    ASSERT_EQ_FMT(TONEWHEEL_OSC_EVENTS - 1, tonewheel_osc_schedule_room(osc), "%d");
+
+    // Wheel 10's stale event was dropped; wheel 11's still lands.
+    for (int i = 0; i < 3; i++) {
+        tonewheel_osc_fill(osc, block, 64);
+    }
+    ASSERT_EQ_FMT(3000, osc->volumes[10], "%d");
+    ASSERT_EQ_FMT(0, osc->volumes[11], "%d");
+
+    tonewheel_osc_fill(osc, block, 64);
+    ASSERT_EQ_FMT(1000, osc->volumes[11], "%d");
+    ASSERT_EQ_FMT(TONEWHEEL_OSC_EVENTS, tonewheel_osc_schedule_room(osc), "%d");
+
+    free(osc);
+    PASS();
+}
+
+// test_tonewheel_osc_schedule_ramps ensures a set of ramps is
+// scheduled whole or not at all.
+TEST test_tonewheel_osc_schedule_ramps() {
+    tonewheel_osc *osc = tonewheel_osc_new();
+    uint16_t volumes[92];
+    uint32_t wheels[3] = {0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF};
+    for (int t = 0; t < 92; t++) {
+        volumes[t] = (uint16_t)(t * 100);
+    }
+
+    // Keyclick contacts for the next two blocks leave too little room.
+    for (int i = 0; i < 40; i++) {
+        ASSERT(tonewheel_osc_schedule(osc, 64 + i, 5, 1000));
+    }
+    ASSERT_EQ(0, tonewheel_osc_schedule_ramps(osc, 0, volumes, wheels));
+    ASSERT_EQ_FMT(TONEWHEEL_OSC_EVENTS - 40, tonewheel_osc_schedule_room(osc), "%d");
+
+    int16_t block[64];
+    tonewheel_osc_fill(osc, block, 64);
+    tonewheel_osc_fill(osc, block, 64);
+    ASSERT(tonewheel_osc_schedule_ramps(osc, osc->clock, volumes, wheels));
+    ASSERT_EQ_FMT(TONEWHEEL_OSC_EVENTS - 91, tonewheel_osc_schedule_room(osc), "%d");
+
+    // Every wheel reaches its volume in the next block.
+    tonewheel_osc_fill(osc, block, 64);
+    ASSERT_MEM_EQ(&volumes[1], &osc->volumes[1], 91 * sizeof(uint16_t));
+
+    free(osc);
+    PASS();
+}
+
+// test_tonewheel_osc_multirate ensures the low wheels sound the same
+// at reduced rates, only delayed.
+TEST test_tonewheel_osc_multirate() {
+    static const int delays[3] = {0, 2, 6};
+    static int16_t want[4 * 128];
+    static int16_t got[4 * 128];
+
+    tonewheel_osc *full = tonewheel_osc_new();
+    tonewheel_osc_set_volume(full, 1, 10000);
+    tonewheel_osc_set_volume(full, 40, 10000);
+    for (int b = 0; b < 4; b++) {
+        tonewheel_osc_fill(full, want + 128 * b, 128);
+    }
+
+    for (int shift = 1; shift <= 2; shift++) {
+        tonewheel_osc *multi = tonewheel_osc_new();
+        tonewheel_osc_set_multirate(multi, shift);
+        tonewheel_osc_set_volume(multi, 1, 10000);
+        tonewheel_osc_set_volume(multi, 40, 10000);
+        for (int b = 0; b < 4; b++) {
+            tonewheel_osc_fill(multi, got + 128 * b, 128);
+        }
+
+        for (int i = 32; i < 4 * 128; i++) {
+            int err = got[i] - want[i - delays[shift]];
+            ASSERT_IN_RANGE(0, err, 4);
+        }
+        free(multi);
+    }
+
+    free(full);
+    PASS();
+}
+
+// test_tonewheel_osc_multirate_schedule ensures scheduled changes
+// reach the low wheels at their reduced rate.
+TEST test_tonewheel_osc_multirate_schedule() {
+    tonewheel_osc *osc = tonewheel_osc_new();
+    tonewheel_osc_set_multirate(osc, 2);
+
+    int16_t block[128];
+    ASSERT(tonewheel_osc_schedule(osc, 64, 1, 10000));
+    tonewheel_osc_fill(osc, block, 128);
+    ASSERT_EQ_FMT(10000, osc->volumes[1], "%d");
+
+    // Silent until the event. The upsampler's delay is a little more
+    // than its lookahead.
+    for (int i = 0; i < 64; i++) {
+        ASSERT_EQ_FMT(0, block[i], "%d");
+    }
+    ASSERT(block[127] != 0);
+
+    free(osc);
+    PASS();
+}
+
+// test_tonewheel_osc_fill_f32 ensures the float path renders the same
+// wheels as the int16 one, but with headroom where the int16 one
+// saturates.
+TEST test_tonewheel_osc_fill_f32() {
+    tonewheel_osc *osc = tonewheel_osc_new();
+    tonewheel_osc *osc_f = tonewheel_osc_new();
+
+    // Eight wheels at full volume overflow int16.
+    int wheels[8] = {25, 32, 37, 44, 49, 56, 61, 68};
+    for (int w = 0; w < 8; w++) {
+        tonewheel_osc_set_volume(osc, wheels[w], 0xFFFF);
+        tonewheel_osc_set_volume(osc_f, wheels[w], 0xFFFF);
+    }
+
+    int16_t block[128];
+    float block_f[128];
+    float peak = 0;
+    int clipped = 0;
+    for (int b = 0; b < 32; b++) {
+        tonewheel_osc_fill(osc, block, 128);
+        tonewheel_osc_fill_f32(osc_f, block_f, 128);
+
+        for (int i = 0; i < 128; i++) {
+            // Each wheel truncates once in the int16 path.
+            float want = floorf(block_f[i] * 32768.0f);
+            want = want > 32767 ? 32767 : (want < -32768 ? -32768 : want);
+            ASSERT_IN_RANGE(want, block[i], 8);
+
+            peak = fabsf(block_f[i]) > peak ? fabsf(block_f[i]) : peak;
+            clipped += (block[i] == 32767 || block[i] == -32768);
+        }
+    }
+    ASSERTm("float path didn't exceed full scale", peak > 1.0f);
+    ASSERTm("int16 path didn't saturate", clipped > 0);
+
+    free(osc);
+    free(osc_f);
+    PASS();
+}
+
+// test_tonewheel_osc_saturate ensures full polyphony saturates in
+// every multirate mode rather than wrapping around.
+TEST test_tonewheel_osc_saturate() {
+    for (int shift = 0; shift <= 2; shift++) {
+        tonewheel_osc *osc = tonewheel_osc_new();
+        tonewheel_osc_set_multirate(osc, shift);
+        for (int t = 1; t < 92; t++) {
+            tonewheel_osc_set_volume(osc, t, 0xFFFF);
+        }
+
+        // Every wheel starts at phase zero and rises together, so a
+        // wrapping sum would swing negative early on.
+        int16_t block[128];
+        tonewheel_osc_fill(osc, block, 128);
+        for (int i = 0; i < 8; i++) {
+            ASSERT(block[i] >= 0);
+        }
+
+        int clipped = 0;
+        for (int i = 0; i < 128; i++) {
+            clipped += (block[i] == 32767);
+        }
+        ASSERT(clipped > 0);
+
+        free(osc);
+    }
+
+    PASS();
+}
+
+// test_tonewheel_osc_set_volumes ensures a published vector renders
+// like the same volumes set one by one, starting at the next fill.
+TEST test_tonewheel_osc_set_volumes() {
+    tonewheel_osc *osc = tonewheel_osc_new();
+    tonewheel_osc *direct = tonewheel_osc_new();
+    tonewheel_osc_leak_b3(osc, 3, 328);
+    tonewheel_osc_leak_b3(direct, 3, 328);
+
+    uint16_t volumes[92] = {0};
+    volumes[13] = 1000;
+    volumes[25] = 2000;
+    volumes[85] = 3000;
+    ASSERT_EQ_FMT(3, tonewheel_osc_set_volumes(osc, volumes), "%d");
+    ASSERT_EQ_FMT(0, osc->volumes[25], "%d");
+    for (int t = 1; t < 92; t++) {
+        tonewheel_osc_set_volume(direct, t, volumes[t]);
+    }
+
+    int16_t want[64], got[64];
+    tonewheel_osc_fill(osc, got, 64);
+    tonewheel_osc_fill(direct, want, 64);
+    ASSERT_MEM_EQ(want, got, sizeof(want));
+
+    // Only changes are published.
+    ASSERT_EQ_FMT(0, tonewheel_osc_set_volumes(osc, volumes), "%d");
+    volumes[25] = 0;
+    ASSERT_EQ_FMT(1, tonewheel_osc_set_volumes(osc, volumes), "%d");
+    tonewheel_osc_set_volume(direct, 25, 0);
+
+    tonewheel_osc_fill(osc, got, 64);
+    tonewheel_osc_fill(direct, want, 64);
+    ASSERT_MEM_EQ(want, got, sizeof(want));
+
+    free(osc);
+    free(direct);
+    PASS();
+}
+
+// test_tonewheel_osc_set_volumes_carry ensures a vector published
+// before fill took the last one keeps the last one's changes.
+TEST test_tonewheel_osc_set_volumes_carry() {
+    tonewheel_osc *osc = tonewheel_osc_new();
+
+    uint16_t volumes[92] = {0};
+    volumes[10] = 1000;
+    ASSERT_EQ_FMT(1, tonewheel_osc_set_volumes(osc, volumes), "%d");
+    volumes[20] = 2000;
+    ASSERT_EQ_FMT(1, tonewheel_osc_set_volumes(osc, volumes), "%d");
+    volumes[30] = 3000;
+    ASSERT_EQ_FMT(1, tonewheel_osc_set_volumes(osc, volumes), "%d");
+
+    int16_t block[64];
+    tonewheel_osc_fill(osc, block, 64);
+    ASSERT_MEM_EQ(volumes, osc->volumes, sizeof(volumes));
+    ASSERT_FALSE(osc->next_mid & TONEWHEEL_OSC_FRESH);
+
+    free(osc);
+    PASS();
+}
+
+// test_tonewheel_osc_silent ensures an osc reports silence once it has
+// nothing left to render, and that any change to its volumes wakes it.
+TEST test_tonewheel_osc_silent() {
+    tonewheel_osc *osc = tonewheel_osc_new();
+    int16_t block[128];
+
+    tonewheel_osc_set_volume(osc, 49, 20000);
+    ASSERT_FALSE(tonewheel_osc_silent(osc));
+    tonewheel_osc_fill(osc, block, 128);
+    ASSERT_FALSE(tonewheel_osc_silent(osc));
+
+    // The block that turns the wheel off may still carry the low
+    // wheels' upsampler history; every block after it is zero.
+    tonewheel_osc_set_multirate(osc, 2);
+    tonewheel_osc_set_volume(osc, 13, 20000);
+    tonewheel_osc_fill(osc, block, 128);
+    tonewheel_osc_set_volume(osc, 13, 0);
+    tonewheel_osc_set_volume(osc, 49, 0);
+    tonewheel_osc_fill(osc, block, 128);
+    ASSERT(tonewheel_osc_silent(osc));
+    tonewheel_osc_fill(osc, block, 128);
+    for (int i = 0; i < 128; i++) {
+        ASSERT_EQ_FMT(0, block[i], "%d");
+    }
+    ASSERT(tonewheel_osc_silent(osc));
+
+    uint32_t clock = osc->clock;
+    tonewheel_osc_skip(osc, 128);
+    ASSERT_EQ_FMT(clock + 128, osc->clock, "%u");
+
+    tonewheel_osc_schedule(osc, osc->clock + 1000, 49, 20000);
+    ASSERT_FALSE(tonewheel_osc_silent(osc));
+
+    free(osc);
+    PASS();
+}
+
+static void *tonewheel_osc_test_publisher(void *arg) {
+    tonewheel_osc *osc = (tonewheel_osc *)arg;
+    static uint16_t volumes[92];
+    for (int k = 1; k <= 20000; k++) {
+        for (int t = 1; t < 92; t++) {
+            volumes[t] = (uint16_t)k;
+        }
+        tonewheel_osc_set_volumes(osc, volumes);
+    }
+    return NULL;
+}
+
+// test_tonewheel_osc_set_volumes_threads publishes vectors from another
+// thread while filling, and ensures fill never sees part of one.
+TEST test_tonewheel_osc_set_volumes_threads() {
+    tonewheel_osc *osc = tonewheel_osc_new();
+    int16_t block[16];
+
+    pthread_t writer;
+    ASSERT_EQ(0, pthread_create(&writer, NULL, tonewheel_osc_test_publisher, osc));
+    int torn = 0;
+    while (osc->volumes[1] != 20000) {
+        tonewheel_osc_fill(osc, block, 16);
+        for (int t = 2; t < 92; t++) {
+            torn += osc->volumes[t] != osc->volumes[1];
+        }
+    }
+    pthread_join(writer, NULL);
+    ASSERT_EQ_FMT(0, torn, "%d");
+
+    free(osc);
+    PASS();
+}
+
 GREATEST_SUITE(tonewheel_osc_suite) {
     RUN_TEST(test_tonewheel_osc_new);
     RUN_TEST(test_tonewheel_osc_fill1);
+    RUN_TEST(test_tonewheel_osc_pedal_wheels);
+    RUN_TEST(test_tonewheel_osc_leak);
+    RUN_TEST(test_tonewheel_osc_leak_b3);
+    RUN_TEST(test_tonewheel_osc_schedule);
+    RUN_TEST(test_tonewheel_osc_schedule_full);
+    RUN_TEST(test_tonewheel_osc_schedule_ramp);
+    RUN_TEST(test_tonewheel_osc_schedule_overtake);
+    RUN_TEST(test_tonewheel_osc_schedule_ramps);
+    RUN_TEST(test_tonewheel_osc_multirate);
+    RUN_TEST(test_tonewheel_osc_multirate_schedule);
+    RUN_TEST(test_tonewheel_osc_fill_f32);
+    RUN_TEST(test_tonewheel_osc_saturate);
+    RUN_TEST(test_tonewheel_osc_set_volumes);
+    RUN_TEST(test_tonewheel_osc_set_volumes_carry);
+    RUN_TEST(test_tonewheel_osc_set_volumes_threads);
+    RUN_TEST(test_tonewheel_osc_silent);
 }
 
 #endif
@@ -4,8 +4,192 @@
 extern "C" {
 #endif
 
-/* This is empty while I figure out what to pull out of
-   vibrato_audio.cpp for the test suite. */
+#include <string.h>
+
+#include "sample.h"
+#include "vibrato.h"
+
+// The scanner's rotor turns once every 2^32 / 679632 samples: 6.9Hz
+// at 44.1kHz.
+#define VIBRATO_SCAN_INCR (679632)
+
+// The rotor sweeps 16 stator plates, wired to the 9 taps of the delay
+// line there and back: 0, 1, ..., 8, 7, ..., 1. Each revolution
+// sweeps the delay up the line and back down.
+static const uint8_t vibrato_plate_taps[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 7, 6, 5, 4, 3, 2, 1};
+
+// The rotor couples to the stator plates it overlaps, falling off as
+// a raised cosine 1.5 plates wide, so at most three plates are live
+// at once. vibrato_weights holds their normalized weights (Q15) at 64
+// positions between two plates: for the first half, the plates before,
+// at and after the rotor's; for the second half, the rotor's plate
+// and the two after it.
+#define VIBRATO_WEIGHT_BITS (6)
+static const int16_t vibrato_weights[1 << VIBRATO_WEIGHT_BITS][3] = {
+    {5307, 21843, 5617}, {5004, 21831, 5932},
+    {4706, 21809, 6252}, {4416, 21773, 6578},
+    {4132, 21727, 6908}, {3856, 21668, 7243},
+    {3587, 21599, 7581}, {3326, 21518, 7923},
+    {3074, 21425, 8268}, {2829, 21321, 8617},
+    {2594, 21206, 8967}, {2367, 21080, 9320},
+    {2149, 20944, 9674}, {1941, 20796, 10030},
+    {1743, 20638, 10386}, {1554, 20469, 10744},
+    {1375, 20291, 11101}, {1207, 20102, 11458},
+    {1049, 19903, 11815}, {901, 19695, 12171},
+    {764, 19478, 12525}, {638, 19251, 12878},
+    {524, 19015, 13228}, {420, 18771, 13576},
+    {327, 18519, 13921}, {246, 18257, 14264},
+    {176, 17989, 14602}, {118, 17713, 14936},
+    {72, 17428, 15267}, {37, 17138, 15592},
+    {13, 16841, 15913}, {1, 16538, 16228},
+    {16228, 16538, 1}, {15913, 16841, 13},
+    {15592, 17138, 37}, {15267, 17428, 72},
+    {14936, 17713, 118}, {14602, 17989, 176},
+    {14264, 18257, 246}, {13921, 18519, 327},
+    {13576, 18771, 420}, {13228, 19015, 524},
+    {12878, 19251, 638}, {12525, 19478, 764},
+    {12171, 19695, 901}, {11815, 19903, 1049},
+    {11458, 20102, 1207}, {11101, 20291, 1375},
+    {10744, 20469, 1554}, {10386, 20638, 1743},
+    {10030, 20796, 1941}, {9674, 20944, 2149},
+    {9320, 21080, 2367}, {8967, 21206, 2594},
+    {8617, 21321, 2829}, {8268, 21425, 3074},
+    {7923, 21518, 3326}, {7581, 21599, 3587},
+    {7243, 21668, 3856}, {6908, 21727, 4132},
+    {6578, 21773, 4416}, {6252, 21809, 4706},
+    {5932, 21831, 5004}, {5617, 21843, 5307},
+};
+
+void vibrato_init(vibrato_scanner *v, int depth, int mix) {
+    // The ring buffer write pointer is initialized to give a
+    // delay of 1ms.
+    // 44117.64706Hz * 0.001s / 128 samples = 34 samples
+    v->wp = 34;
+    v->scan_phase = 0;
+    v->depth = depth;
+    v->mix = mix;
+}
+
+extern "C++" {
+// vibrato_kernel runs the scanner for either sample type. It's inlined
+// into a function per mode, so _depth_ and _mix_ are constants there:
+// the tap delays fold into the loop and chorus costs nothing when it's
+// off.
+template <typename S>
+static inline void vibrato_kernel(vibrato_scanner *v, S *ring, const S *src, S *dst, size_t len, const int depth, const int mix) {
+    typedef sample_traits<S> T;
+
+    uint8_t loc_wp = v->wp;
+    uint32_t loc_phase = v->scan_phase;
+
+    // The taps are evenly spaced down the line: 8 samples apart at
+    // depth 1 (V3/C3), halving with each step of depth.
+    const int spacing = 16 >> depth;
+    uint8_t delays[16];
+    for (int p = 0; p < 16; p++) {
+        delays[p] = vibrato_plate_taps[p] * spacing;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        // Write the input audio to our delay line.
+        ring[loc_wp] = src[i];
+
+        // The rotor's plate and its position toward the next one.
+        uint32_t plate = loc_phase >> 28;
+        uint32_t pos = (loc_phase >> (28 - VIBRATO_WEIGHT_BITS)) & ((1 << VIBRATO_WEIGHT_BITS) - 1);
+        const int16_t *w = vibrato_weights[pos];
+
+        // The first live plate is the one before the rotor's, until
+        // it's halfway to the next.
+        uint32_t p0 = (plate + 15 + (pos >> (VIBRATO_WEIGHT_BITS - 1))) & 15;
+        uint32_t p1 = (p0 + 1) & 15;
+        uint32_t p2 = (p0 + 2) & 15;
+
+        typename T::acc val = T::gain(ring[(loc_wp - delays[p0]) & 0x7f], w[0]);
+        val += T::gain(ring[(loc_wp - delays[p1]) & 0x7f], w[1]);
+        val += T::gain(ring[(loc_wp - delays[p2]) & 0x7f], w[2]);
+
+        if (mix) {
+            val = T::mix(val, ring[loc_wp]);
+        }
+
+        dst[i] = val;
+
+        loc_phase += VIBRATO_SCAN_INCR;
+
+        // Increment and wrap loc_wp.
+        loc_wp++;
+        loc_wp &= 0x7f;
+    }
+
+    v->wp = loc_wp;
+    v->scan_phase = loc_phase;
+}
+
+template <typename S, int depth, int mix>
+static void vibrato_mode(vibrato_scanner *v, S *ring, const S *src, S *dst, size_t len) {
+    vibrato_kernel(v, ring, src, dst, len, depth, mix);
+}
+
+// vibrato_write copies _src_ into the ring at the write pointer, in at
+// most two runs, and moves the scanner on by _len_.
+template <typename S>
+static void vibrato_write(vibrato_scanner *v, S *ring, const S *src, size_t len) {
+    size_t wp = v->wp;
+    size_t n = len < VIBRATO_RING_LEN - wp ? len : VIBRATO_RING_LEN - wp;
+    memcpy(&ring[wp], src, n * sizeof(S));
+    memcpy(ring, src + n, (len - n) * sizeof(S));
+    vibrato_skip(v, len);
+}
+}
+
+// The kernels for each depth with chorus off and on. Depth 0 and
+// anything past VIBRATO_DEPTH_MAX bypass the scanner.
+static const vibrato_fn vibrato_kernels[2][VIBRATO_DEPTH_MAX + 1] = {
+    {NULL, vibrato_mode<int16_t, 1, 0>, vibrato_mode<int16_t, 2, 0>, vibrato_mode<int16_t, 3, 0>, vibrato_mode<int16_t, 4, 0>},
+    {NULL, vibrato_mode<int16_t, 1, 1>, vibrato_mode<int16_t, 2, 1>, vibrato_mode<int16_t, 3, 1>, vibrato_mode<int16_t, 4, 1>},
+};
+
+typedef void (*vibrato_fn_f32)(vibrato_scanner *v, float *ring, const float *src, float *dst, size_t len);
+static const vibrato_fn_f32 vibrato_kernels_f32[2][VIBRATO_DEPTH_MAX + 1] = {
+    {NULL, vibrato_mode<float, 1, 0>, vibrato_mode<float, 2, 0>, vibrato_mode<float, 3, 0>, vibrato_mode<float, 4, 0>},
+    {NULL, vibrato_mode<float, 1, 1>, vibrato_mode<float, 2, 1>, vibrato_mode<float, 3, 1>, vibrato_mode<float, 4, 1>},
+};
+
+vibrato_fn vibrato_select(const vibrato_scanner *v) {
+    if (v->depth < 1 || v->depth > VIBRATO_DEPTH_MAX) {
+        return NULL;
+    }
+    return vibrato_kernels[v->mix ? 1 : 0][v->depth];
+}
+
+void vibrato_bypass(vibrato_scanner *v, int16_t *ring, const int16_t *src, size_t len) {
+    vibrato_write(v, ring, src, len);
+}
+
+void vibrato_update(vibrato_scanner *v, int16_t *ring, const int16_t *src, int16_t *dst, size_t len) {
+    vibrato_fn fn = vibrato_select(v);
+    if (fn == NULL) {
+        vibrato_bypass(v, ring, src, len);
+        memmove(dst, src, len * sizeof(int16_t));
+        return;
+    }
+    fn(v, ring, src, dst, len);
+}
+
+void vibrato_skip(vibrato_scanner *v, size_t len) {
+    v->wp = (v->wp + len) & 0x7f;
+    v->scan_phase += VIBRATO_SCAN_INCR * (uint32_t)len;
+}
+
+void vibrato_update_f32(vibrato_scanner *v, float *ring, const float *src, float *dst, size_t len) {
+    if (v->depth < 1 || v->depth > VIBRATO_DEPTH_MAX) {
+        vibrato_write(v, ring, src, len);
+        memmove(dst, src, len * sizeof(float));
+        return;
+    }
+    vibrato_kernels_f32[v->mix ? 1 : 0][v->depth](v, ring, src, dst, len);
+}
 
 #if defined(__cplusplus)
 }
@@ -3,7 +3,72 @@
 #ifndef VIBRATO_H
 #define VIBRATO_H
 
-/* This is empty while I figure out what to pull out of
-   vibrato_audio.cpp for the test suite. */
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The scanner's delay line is one Teensy block long. It's kept
+// outside the vibrato struct so the int16 and float kernels can share
+// the rest of the state.
+#define VIBRATO_RING_LEN (128)
+
+// vibrato_scanner is the state of the Vibrato/Chorus scanner: a 9 tap
+// delay line crossfaded by a 7Hz rotor. See vibrato.cpp.
+typedef struct _vibrato_scanner {
+    // The ring's write pointer; the taps are read at fixed delays
+    // behind it.
+    uint32_t wp;
+
+    // Rotor position; one revolution per 2^32.
+    uint32_t scan_phase;
+
+    // Depth of the scanner; 1..8, higher is *less* vibrato. It sets
+    // the spacing of the taps.
+    int depth;
+
+    // Mix the dry signal in for chorus.
+    int mix;
+} vibrato_scanner;
+
+// The scanner runs at depths 1..VIBRATO_DEPTH_MAX. Deeper than that,
+// every tap of the line is the dry signal, so the scanner is bypassed.
+#define VIBRATO_DEPTH_MAX (4)
+
+// vibrato_init sets up a scanner at _depth_ with the write pointer
+// 1ms ahead. The caller zeroes the ring.
+void vibrato_init(vibrato_scanner *v, int depth, int mix);
+
+// vibrato_update writes _len_ samples of src through the scanner into
+// dst. _ring_ holds VIBRATO_RING_LEN samples.
+void vibrato_update(vibrato_scanner *v, int16_t *ring, const int16_t *src, int16_t *dst, size_t len);
+
+// vibrato_fn is vibrato_update for a single depth and mix.
+typedef void (*vibrato_fn)(vibrato_scanner *v, int16_t *ring, const int16_t *src, int16_t *dst, size_t len);
+
+// vibrato_select returns the kernel specialized for _v_'s current
+// depth and mix, or NULL if the scanner is bypassed and its output is
+// its input. Call it once per block.
+vibrato_fn vibrato_select(const vibrato_scanner *v);
+
+// vibrato_bypass writes _len_ samples of _src_ to the ring and moves
+// the scanner on, for blocks where vibrato_select returned NULL. It's
+// a copy, and it keeps the taps fresh for when the scanner is turned
+// back on.
+void vibrato_bypass(vibrato_scanner *v, int16_t *ring, const int16_t *src, size_t len);
+
+// vibrato_skip moves the scanner and the write pointer on by _len_
+// samples without reading or writing the ring, for blocks of silence.
+// The ring must already hold silence.
+void vibrato_skip(vibrato_scanner *v, size_t len);
+
+// vibrato_update_f32 is vibrato_update on float samples.
+void vibrato_update_f32(vibrato_scanner *v, float *ring, const float *src, float *dst, size_t len);
+
+#if defined(__cplusplus)
+}
+#endif
 
 #endif
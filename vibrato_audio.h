@@ -14,8 +14,8 @@
 
 // A Teensy audio block is 128 samples at 44.1kHz, so roughly 2.9ms.
 // We'll keep one block around to maintain a 1ms ring buffer. Each
-// update() cycle reads the input block, writes it to the ring buffer,
-// and writes phase modulated output.
+// update() cycle writes the input block to the ring buffer and
+// replaces it with phase modulated output.
 
 enum VibratoMode {
     Off = 0,
@@ -27,131 +27,93 @@ enum VibratoMode {
     C3,
 };
 
-// Vibrato implements the Vibrato/Chorus scanner of a Hammond B-3.
-class Vibrato : public AudioStream {
+// VibratoCore holds the Vibrato/Chorus scanner of a Hammond B-3 and
+// its controls, without an AudioStream, so the Organ node can own one.
+class VibratoCore {
   public:
-    Vibrato() : AudioStream(1, inputQueueArray) {
-    }
-
     void init() {
-        // The ring buffer write pointer is initialized to give a
-        // delay of 1ms.
-        wp = 34; // 44117.64706Hz * 0.001s / 128 samples = 34 samples
-        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+        for (int i = 0; i < VIBRATO_RING_LEN; i++) {
             buf[i] = 0;
         }
 
-        scan_phase = 0;
+        vibrato_init(&vib, 8, 0);
         setMode(Off);
     }
 
     void setMode(VibratoMode mode) {
         if (mode == V1) {
-            depth = 3;
-            mix = 0;
+            vib.depth = 3;
+            vib.mix = 0;
         } else if (mode == V2) {
-            depth = 2;
-            mix = 0;
+            vib.depth = 2;
+            vib.mix = 0;
         } else if (mode == V3) {
-            depth = 1;
-            mix = 0;
+            vib.depth = 1;
+            vib.mix = 0;
         } else if (mode == C1) {
-            depth = 3;
-            mix = 1;
+            vib.depth = 3;
+            vib.mix = 1;
         } else if (mode == C2) {
-            depth = 2;
-            mix = 1;
+            vib.depth = 2;
+            vib.mix = 1;
         } else if (mode == C3) {
-            depth = 1;
-            mix = 1;
+            vib.depth = 1;
+            vib.mix = 1;
         } else {
-            depth = 8;
+            vib.depth = 8;
         }
     }
 
-    void update(void) {
-        audio_block_t *in = receiveReadOnly(0);
-        if (in == NULL) {
-            return;
-        }
+    vibrato_scanner vib;
+    int16_t buf[VIBRATO_RING_LEN];
+};
 
-        audio_block_t *out = allocate();
-        if (out == NULL) {
-            release(in);
+// Vibrato implements the Vibrato/Chorus scanner of a Hammond B-3.
+class Vibrato : public AudioStream, public VibratoCore {
+  public:
+    Vibrato() : AudioStream(1, inputQueueArray), idle(false) {
+    }
+
+    void update(void) {
+        // Off forwards the input block itself, still copying it to the
+        // ring so the taps are fresh when the scanner comes back on.
+        vibrato_fn fn = vibrato_select(&vib);
+        if (fn == NULL) {
+            audio_block_t *in = receiveReadOnly(0);
+            if (in != NULL) {
+                vibrato_bypass(&vib, buf, in->data, AUDIO_BLOCK_SAMPLES);
+                transmit(in, 0);
+                release(in);
+            }
             return;
         }
 
-        uint8_t loc_wp = wp;
-        uint32_t loc_phase = scan_phase;
-
-        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
-            // Write the input audio to our delay line.
-            buf[loc_wp] = in->data[i];
-
-            // Read the delay line into the output buffer.
-
-            // 7 bits of loc_wp to 1..8; subtract triangle. This gives 5
-            // bits of sway on a 7 bit counter.
-            int32_t loc_rp = (loc_wp << 24) - (int32_t)(triangle(loc_phase) >> depth);
-
-            int16_t pos = loc_rp >> 24;
-            int16_t a = buf[pos & 0x7f];
-            int16_t b = buf[++pos & 0x7f];
-
-            int16_t val = lerp(a, b, (loc_rp >> 8) & 0xFFFF);
-            if (mix) {
-                val = ((int32_t)val + buf[loc_wp]) >> 1;
+        // No block is silence: the scanner keeps moving, and the ring
+        // is cleared once so the next note doesn't start with the end
+        // of the last.
+        //
+        // Otherwise the block is processed in place; it's only copied
+        // if another input shares it.
+        audio_block_t *block = receiveWritable(0);
+        if (block == NULL) {
+            if (!idle) {
+                memset(buf, 0, sizeof(buf));
+                idle = true;
             }
-
-            out->data[i] = val;
-
-            loc_phase += 679632;
-
-            // Increment and wrap loc_wp.
-            loc_wp++;
-            loc_wp &= 0x7f;
+            vibrato_skip(&vib, AUDIO_BLOCK_SAMPLES);
+            return;
         }
+        idle = false;
 
-        wp = loc_wp;
-        scan_phase = loc_phase;
+        fn(&vib, buf, block->data, block->data, AUDIO_BLOCK_SAMPLES);
 
-        transmit(out, 0);
-        release(out);
-        release(in);
+        transmit(block, 0);
+        release(block);
     }
 
   private:
-    uint32_t triangle(uint32_t phase) {
-        // Convert 32-bit phase into signed 31-bit triangle.
-        if (phase & 0x80000000) {
-            return 0x80000000 + (0x80000000 - phase);
-        } else {
-            return phase;
-        }
-    }
-
-    int32_t lerp(int32_t a, int32_t b, uint16_t scale) {
-        return ((0xFFFF - scale) * a + scale * b) >> 16;
-    }
-
     audio_block_t *inputQueueArray[1];
-
-    // Ring buffer. The write pointer is stored here; the read pointer
-    // is calculated at read time from wp.
-    int wp;
-    int16_t buf[AUDIO_BLOCK_SAMPLES];
-
-    // Scanner position and scan direction. This modulates the read
-    // pointer into buf as a 7Hz triangle wave. We'll use 15 bits for
-    // position and the 16th to detect overflow.
-    //
-    // The write pointer is 34 samples ahead, so use 6 bits (5 + sign)
-    // as the position modifier so reads never outrun writes.
-    uint32_t scan_phase;
-
-    // Depth of triangle scanner; 1..7, higher is *less* vibrato.
-    int depth;
-    int mix;
+    bool idle;
 };
 
 #endif
@@ -2,11 +2,205 @@
 
 #ifdef ROTO_TEST
 
+#include <string.h>
+
 #include "greatest.h"
 
+#include "tonewheel_osc.h"
 #include "vibrato.h"
 
+// test_vibrato_dc ensures a constant input comes through every mode
+// at (nearly) the same level.
+TEST test_vibrato_dc() {
+    static int16_t ring[VIBRATO_RING_LEN];
+    static int16_t src[128], dst[128];
+
+    for (int i = 0; i < 128; i++) {
+        src[i] = 10000;
+    }
+
+    for (int mix = 0; mix <= 1; mix++) {
+        for (int depth = 1; depth <= 3; depth++) {
+            vibrato_scanner v;
+            memset(ring, 0, sizeof(ring));
+            vibrato_init(&v, depth, mix);
+
+            for (int b = 0; b < 4; b++) {
+                vibrato_update(&v, ring, src, dst, 128);
+            }
+            for (int i = 0; i < 128; i++) {
+                ASSERT_IN_RANGE(10000, dst[i], 2);
+            }
+        }
+    }
+
+    PASS();
+}
+
+// test_vibrato_taps ensures an impulse only comes out at the delay
+// line's taps, and that a revolution of the rotor reaches the far end
+// of the line.
+TEST test_vibrato_taps() {
+    static int16_t ring[VIBRATO_RING_LEN], src[128], dst[128];
+
+    vibrato_scanner v;
+    memset(ring, 0, sizeof(ring));
+    vibrato_init(&v, 1, 0);
+
+    memset(src, 0, sizeof(src));
+    src[0] = 30000;
+
+    int seen[VIBRATO_RING_LEN] = {0};
+    for (int b = 0; b < 60; b++) {
+        vibrato_update(&v, ring, src, dst, 128);
+
+        int live = 0;
+        for (int i = 0; i < 128; i++) {
+            if (dst[i] != 0) {
+                ASSERT_EQ_FMT(0, i % 8, "%d");
+                seen[i] = 1;
+                live++;
+            }
+        }
+        ASSERTm("too many live taps", live <= 3);
+    }
+
+    for (int tap = 0; tap <= 64; tap += 8) {
+        ASSERT_EQ_FMT(1, seen[tap], "%d");
+    }
+    ASSERT_EQ_FMT(0, seen[72], "%d");
+
+    PASS();
+}
+
+// test_vibrato_select ensures each mode gets its own kernel and Off
+// is a bypass.
+TEST test_vibrato_select() {
+    vibrato_scanner v;
+    vibrato_init(&v, 8, 0);
+    ASSERT_EQ(NULL, vibrato_select(&v));
+
+    vibrato_fn seen[6];
+    int n = 0;
+    for (int mix = 0; mix <= 1; mix++) {
+        for (int depth = 1; depth <= 3; depth++) {
+            vibrato_init(&v, depth, mix);
+            vibrato_fn fn = vibrato_select(&v);
+            ASSERT(fn != NULL);
+            for (int i = 0; i < n; i++) {
+                ASSERT(fn != seen[i]);
+            }
+            seen[n++] = fn;
+        }
+    }
+
+    // A bypassed update passes its input through.
+    int16_t src[4] = {1, -2, 3, -4}, dst[4] = {0};
+    int16_t ring[VIBRATO_RING_LEN];
+    vibrato_init(&v, 8, 1);
+    vibrato_update(&v, ring, src, dst, 4);
+    ASSERT_MEM_EQ(src, dst, sizeof(src));
+
+    PASS();
+}
+
+// test_vibrato_in_place ensures a block can be scanned in place, as
+// Vibrato::update does.
+TEST test_vibrato_in_place() {
+    static int16_t ring[VIBRATO_RING_LEN], ring_in[VIBRATO_RING_LEN];
+    static int16_t src[128], want[128], block[128];
+
+    vibrato_scanner v, v_in;
+    memset(ring, 0, sizeof(ring));
+    memset(ring_in, 0, sizeof(ring_in));
+    vibrato_init(&v, 1, 1);
+    vibrato_init(&v_in, 1, 1);
+
+    uint32_t phase = 0;
+    for (int b = 0; b < 8; b++) {
+        for (int i = 0; i < 128; i++) {
+            src[i] = isin_S4(phase) * 6;
+            phase += 1000;
+        }
+        memcpy(block, src, sizeof(block));
+
+        vibrato_update(&v, ring, src, want, 128);
+        vibrato_update(&v_in, ring_in, block, block, 128);
+        ASSERT_MEM_EQ(want, block, sizeof(want));
+    }
+
+    PASS();
+}
+
+// test_vibrato_bypass ensures a scanner switched on after being Off
+// sounds as if it had been on all along: its taps are fresh.
+TEST test_vibrato_bypass() {
+    static int16_t ring_on[VIBRATO_RING_LEN], ring_sw[VIBRATO_RING_LEN];
+    static int16_t src[128], want[128], got[128];
+
+    vibrato_scanner on, sw;
+    memset(ring_on, 0, sizeof(ring_on));
+    memset(ring_sw, 0, sizeof(ring_sw));
+    vibrato_init(&on, 1, 0);
+    vibrato_init(&sw, 8, 0);
+
+    uint32_t phase = 0;
+    for (int b = 0; b < 8; b++) {
+        if (b == 4) {
+            sw.depth = 1;
+        }
+        for (int i = 0; i < 128; i++) {
+            src[i] = isin_S4(phase) * 6;
+            phase += 1000;
+        }
+
+        vibrato_update(&on, ring_on, src, want, 128);
+        vibrato_update(&sw, ring_sw, src, got, 128);
+        if (b >= 4) {
+            ASSERT_MEM_EQ(want, got, sizeof(want));
+        }
+    }
+
+    PASS();
+}
+
+// test_vibrato_f32 ensures the float kernel tracks the int16 one.
+TEST test_vibrato_f32() {
+    static int16_t ring[VIBRATO_RING_LEN], src[128], dst[128];
+    static float ring_f[VIBRATO_RING_LEN], src_f[128], dst_f[128];
+
+    vibrato_scanner v, v_f;
+    memset(ring, 0, sizeof(ring));
+    memset(ring_f, 0, sizeof(ring_f));
+    vibrato_init(&v, 1, 1);
+    vibrato_init(&v_f, 1, 1);
+
+    uint32_t phase = 0;
+    for (int b = 0; b < 40; b++) {
+        for (int i = 0; i < 128; i++) {
+            src[i] = isin_S4(phase) * 6;
+            src_f[i] = src[i] / 32768.0f;
+            phase += 1000;
+        }
+
+        vibrato_update(&v, ring, src, dst, 128);
+        vibrato_update_f32(&v_f, ring_f, src_f, dst_f, 128);
+        for (int i = 0; i < 128; i++) {
+            ASSERT_IN_RANGE(dst[i], dst_f[i] * 32768.0f, 2.5f);
+        }
+    }
+    ASSERT_EQ_FMT(v.scan_phase, v_f.scan_phase, "%u");
+
+    PASS();
+}
+
 GREATEST_SUITE(vibrato_suite) {
+    RUN_TEST(test_vibrato_dc);
+    RUN_TEST(test_vibrato_taps);
+    RUN_TEST(test_vibrato_select);
+    RUN_TEST(test_vibrato_in_place);
+    RUN_TEST(test_vibrato_bypass);
+    RUN_TEST(test_vibrato_f32);
 }
 
 #endif